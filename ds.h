@@ -14,6 +14,7 @@
 #ifndef DS_H_
 #define DS_H_
 #include <stdint.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -21,6 +22,13 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <assert.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #ifdef _WIN32
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
@@ -82,6 +90,37 @@ void ds_set_log_level(int level);
 #define DS_DA_INIT_CAPACITY 32
 #endif // DS_DA_INIT_CAPACITY
 
+#ifdef DS_DA_LARGE_THRESHOLD
+/**
+ * Large-array mode, off unless DS_DA_LARGE_THRESHOLD is defined to a size in
+ * bytes, e.g. `(64 << 20)`, the same in every translation unit.
+ * Dynamic array blocks of at least that many bytes are anonymous memory
+ * mappings instead of heap blocks: pages are only backed once written,
+ * growth moves the pages with `mremap` on Linux instead of copying them
+ * (elsewhere it maps, copies and unmaps), and `ds_da_shrink` unmaps the
+ * unused tail in place. Arrays must then only be grown and freed through
+ * the `ds_da_*` macros. Not available on Windows, or where <sys/mman.h>
+ * hides anonymous mappings (strict ISO C modes): blocks then stay on the
+ * heap.
+ */
+#ifndef DS_DA_LARGE_HUGEPAGES
+/**
+ * Ask for transparent huge pages on large-array mappings (2 MB aligned,
+ * `MADV_HUGEPAGE`): fewer TLB misses over a big array, at the cost of
+ * backing memory 2 MB at a time. Define to 0 to leave the pages small.
+ */
+#define DS_DA_LARGE_HUGEPAGES 1
+#endif // DS_DA_LARGE_HUGEPAGES
+
+void *ds__da_realloc(void *data, size_t used, size_t old_size, size_t size);
+void ds__da_free(void *data, size_t size);
+#define DS__DA_REALLOC(data, used, old_size, size) ds__da_realloc((data), (used), (old_size), (size))
+#define DS__DA_FREE(data, size) ds__da_free((data), (size))
+#else
+#define DS__DA_REALLOC(data, used, old_size, size) ((void)(used), (void)(old_size), DS_REALLOC((data), (size)))
+#define DS__DA_FREE(data, size) DS_FREE(data)
+#endif // DS_DA_LARGE_THRESHOLD
+
 /**
  * Dynamic array declaration
  * It will create a dynamic array of the specified type.
@@ -104,26 +143,101 @@ typedef struct {
         size_t capacity;          \
     } name
 
+/**
+ * Small-buffer dynamic array declaration.
+ * Like `ds_da_declare`, with room for `n` items inside the struct: an array
+ * set up with `ds_sda_init` keeps its first `n` items there and moves to the
+ * heap only when it outgrows them. All the `ds_da_*` macros work on it.
+ * The inline items belong to the struct: do not copy or return it by value
+ * while `ds_sda_on_heap` is false.
+ * Example:
+ ```c
+ ds_sda_declare(Tags, const char *, 4);
+ ...
+    Tags t = ds_sda_init(t);
+    ds_da_append(&t, "a"); // no allocation up to 4 items
+    ds_da_free(&t);
+ ```
+ */
+#define ds_sda_declare(name, type, n) \
+    typedef struct {                  \
+        type *data;                   \
+        size_t length;                \
+        size_t capacity;              \
+        type storage[n];              \
+    } name
+
+/**
+ * Initializer for a `ds_sda_declare` variable, pointing it at its inline
+ * storage. A `{0}` array also works but starts on the heap.
+ * Example:
+ *   `Tags t = ds_sda_init(t);`
+ */
+#define ds_sda_init(sda) {.data = (sda).storage, .length = 0, .capacity = DS_ARRAY_LEN((sda).storage)}
+
+/**
+ * Free the heap items of a small-buffer array, if any, and point it back at
+ * its inline storage. Use it to set up a zeroed array, e.g. a struct member.
+ */
+#define ds_sda_reset(sda)                               \
+    do {                                                \
+        ds_da_free((sda));                              \
+        (sda)->data = (sda)->storage;                   \
+        (sda)->capacity = DS_ARRAY_LEN((sda)->storage); \
+    } while (0)
+
+/**
+ * True when a small-buffer array has moved its items to the heap.
+ */
+#define ds_sda_on_heap(sda) ((sda)->data != NULL && (sda)->data != (sda)->storage)
+
+/* a `ds_sda_declare` array keeps its inline items right after `capacity` */
+#define ds__da_inline(da)                                                                        \
+    (_Alignof(__typeof__(*(da)->data)) <= _Alignof(size_t)                                       \
+         ? (void *)(&(da)->capacity + 1)                                                         \
+         : (void *)(((uintptr_t)(&(da)->capacity + 1) + _Alignof(__typeof__(*(da)->data)) - 1) & \
+                    ~(uintptr_t)(_Alignof(__typeof__(*(da)->data)) - 1)))
+/* only a struct with room after `capacity`, like a `ds_sda_declare` array,
+   can hold inline items: the check compiles away for plain arrays, and for
+   the others `data` can only point inside the struct at its own storage */
+#define ds__da_has_inline(da) (sizeof(*(da)) > sizeof(void *) + 2 * sizeof(size_t))
+#define ds__da_is_inline(da) (ds__da_has_inline(da) && (void *)(da)->data == ds__da_inline(da))
+/* move `used` bytes of inline items to a new heap block of `size` bytes;
+   out of line, so the compiler does not check the copy against the inline
+   array's bounds on paths where `data` is already on the heap */
+#ifdef __GNUC__
+__attribute__((noinline, cold))
+#endif
+void *ds__da_spill(const void *items, size_t used, size_t size);
+
 /**
  * Reserve space in a dynamic array.
  */
-#define ds_da_reserve_with_init_capacity(da, expected_capacity, min_capacity)          \
-    do {                                                                               \
-        if ((size_t)(expected_capacity) > (da)->capacity) {                            \
-            if ((da)->capacity == 0) {                                                 \
-                if ((size_t)(expected_capacity) > (min_capacity))                      \
-                    (da)->capacity = (size_t)(expected_capacity);                      \
-                else                                                                   \
-                    (da)->capacity = (min_capacity);                                   \
-            } else {                                                                   \
-                if ((size_t)(expected_capacity) > (da)->capacity * 2)                  \
-                    (da)->capacity = (size_t)(expected_capacity);                      \
-                else                                                                   \
-                    (da)->capacity *= 2;                                               \
-            }                                                                          \
-            (da)->data = DS_REALLOC((da)->data, (da)->capacity * sizeof(*(da)->data)); \
-            assert((da)->data != NULL);                                                \
-        }                                                                              \
+#define ds_da_reserve_with_init_capacity(da, expected_capacity, min_capacity)               \
+    do {                                                                                    \
+        if ((size_t)(expected_capacity) > (da)->capacity) {                                 \
+            size_t _old_capacity = (da)->capacity;                                          \
+            if ((da)->capacity == 0) {                                                      \
+                if ((size_t)(expected_capacity) > (min_capacity))                           \
+                    (da)->capacity = (size_t)(expected_capacity);                           \
+                else                                                                        \
+                    (da)->capacity = (min_capacity);                                        \
+            } else {                                                                        \
+                if ((size_t)(expected_capacity) > (da)->capacity * 2)                       \
+                    (da)->capacity = (size_t)(expected_capacity);                           \
+                else                                                                        \
+                    (da)->capacity *= 2;                                                    \
+            }                                                                               \
+            if ((da)->data && ds__da_is_inline(da)) {                                       \
+                (da)->data = ds__da_spill((da)->data, (da)->length * sizeof(*(da)->data),   \
+                                          (da)->capacity * sizeof(*(da)->data));            \
+            } else {                                                                        \
+                (da)->data = DS__DA_REALLOC((da)->data, (da)->length * sizeof(*(da)->data), \
+                                            _old_capacity * sizeof(*(da)->data),            \
+                                            (da)->capacity * sizeof(*(da)->data));          \
+            }                                                                               \
+            assert((da)->data != NULL);                                                     \
+        }                                                                                   \
     } while (0)
 
 #define ds_da_reserve_min(da, expected_capacity) ds_da_reserve_with_init_capacity((da), (expected_capacity), 1)
@@ -248,27 +362,33 @@ typedef struct {
     } while (0)
 
 /**
- * Free a dynamic array.
+ * Free a dynamic array. A small-buffer array is left zeroed too, see
+ * `ds_sda_reset` to use its inline storage again.
  */
-#define ds_da_free(da)                       \
-    do {                                     \
-        if ((da)->data) DS_FREE((da)->data); \
-        ds_da_zero(da);                      \
+#define ds_da_free(da)                                                     \
+    do {                                                                   \
+        if ((da)->data && !ds__da_is_inline(da))                           \
+            DS__DA_FREE((da)->data, (da)->capacity * sizeof(*(da)->data)); \
+        ds_da_zero(da);                                                    \
     } while (0)
 
 /**
  * Shrink a dynamic array's allocated memory to fit its current length.
- * If the array is empty it is fully freed.
- */
-#define ds_da_shrink(da)                                                             \
-    do {                                                                             \
-        if ((da)->length == 0) {                                                     \
-            ds_da_free((da));                                                        \
-        } else if ((da)->capacity > (da)->length) {                                  \
-            (da)->data = DS_REALLOC((da)->data, (da)->length * sizeof(*(da)->data)); \
-            assert((da)->data != NULL);                                              \
-            (da)->capacity = (da)->length;                                           \
-        }                                                                            \
+ * If the array is empty it is fully freed. Inline items stay where they are.
+ * In large-array mode (DS_DA_LARGE_THRESHOLD) the pages past the new end are
+ * given back without moving the items.
+ */
+#define ds_da_shrink(da)                                                                \
+    do {                                                                                \
+        if ((da)->length == 0) {                                                        \
+            ds_da_free((da));                                                           \
+        } else if ((da)->capacity > (da)->length && !ds__da_is_inline(da)) {            \
+            (da)->data = DS__DA_REALLOC((da)->data, (da)->length * sizeof(*(da)->data), \
+                                        (da)->capacity * sizeof(*(da)->data),           \
+                                        (da)->length * sizeof(*(da)->data));            \
+            assert((da)->data != NULL);                                                 \
+            (da)->capacity = (da)->length;                                              \
+        }                                                                               \
     } while (0)
 
 /**
@@ -318,6 +438,592 @@ typedef struct {
         _r;                                               \
     })
 
+/* `a` and `b` point at C string keys */
+static inline bool ds__str_less(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b) < 0;
+}
+
+/* `<` for numbers and pointers, strcmp for C strings */
+#define ds__less(a, b)                          \
+    _Generic((a),                               \
+        char *: ds__str_less(&(a), &(b)),       \
+        const char *: ds__str_less(&(a), &(b)), \
+        default: (a) < (b))
+
+#ifndef DS_SORT_INSERTION
+/**
+ * Ranges up to this many items are finished with insertion sort by the
+ * `ds_sort_declare` sorts.
+ */
+#define DS_SORT_INSERTION 24
+#endif // DS_SORT_INSERTION
+
+/* items per block of the sort partitions; offsets into a block fit a byte */
+#define DS__SORT_BLOCK 64
+
+/**
+ * Declare sorting and binary search for arrays of `type`, ordered by `<`
+ * (C strings by content); for other types use `ds_sort_declare_ex`.
+ * The comparison is inlined into every generated function, unlike a `qsort`
+ * comparator call.
+ * Generated:
+ *   `name_sort(a, n)` pattern-defeating quicksort: O(n log n) worst case,
+ *   linear on sorted, reversed or all-equal input, not stable
+ *   `name_stable_sort(a, n)` merge sort, equal items keep their order;
+ *   allocates a buffer of `n` items
+ *   `name_is_sorted(a, n)`
+ *   `name_lower_bound(a, n, key)` index of the first item not less than key
+ *   `name_upper_bound(a, n, key)` index of the first item greater than key
+ *   `name_bsearch(a, n, key)` pointer to an item equal to key, or NULL
+ *   `name_merge(out, a, na, b, nb)` merge two sorted arrays into `out`
+ *   (room for `na + nb` items, no overlap); on ties items of `a` come first
+ * The `ds_da_sort` family applies them to a dynamic array.
+ * Example:
+ ```c
+ ds_da_declare(Ints, int);
+ ds_sort_declare(IntSort, int);
+ ...
+    Ints a = {0};
+    ds_da_append_many(&a, ((int[]){3, 1, 2}), 3);
+    ds_da_sort(&a, IntSort);                      // 1 2 3
+    int *two = ds_da_bsearch(&a, IntSort, 2);
+ ```
+ */
+#define ds_sort_declare(name, type) ds_sort_declare_ex(name, type, ds__less)
+
+/**
+ * Declare sorting and binary search like `ds_sort_declare` with a custom
+ * order: `less(a, b)` is true when `a` sorts before `b`, a function or a
+ * macro taking two `type` lvalues.
+ * Example:
+ ```c
+ typedef struct { const char *name; int age; } Person;
+ #define person_less(a, b) ((a).age < (b).age)
+ ds_sort_declare_ex(PersonSort, Person, person_less);
+ ```
+ */
+#define ds_sort_declare_ex(name, type, less)                                                             \
+    static inline void name##__swap(type *x, type *y) {                                                  \
+        type t = *x;                                                                                     \
+        *x = *y;                                                                                         \
+        *y = t;                                                                                          \
+    }                                                                                                    \
+    static inline void name##__sort2(type *x, type *y) {                                                 \
+        if (less(*y, *x)) name##__swap(x, y);                                                            \
+    }                                                                                                    \
+    static inline void name##__sort3(type *x, type *y, type *z) {                                        \
+        name##__sort2(x, y);                                                                             \
+        name##__sort2(y, z);                                                                             \
+        name##__sort2(x, y);                                                                             \
+    }                                                                                                    \
+    static inline void name##__insertion(type *a, size_t n) {                                            \
+        for (size_t i = 1; i < n; i++) {                                                                 \
+            if (!less(a[i], a[i - 1])) continue;                                                         \
+            type x = a[i];                                                                               \
+            size_t j = i;                                                                                \
+            do {                                                                                         \
+                a[j] = a[j - 1];                                                                         \
+                j--;                                                                                     \
+            } while (j > 0 && less(x, a[j - 1]));                                                        \
+            a[j] = x;                                                                                    \
+        }                                                                                                \
+    }                                                                                                    \
+    /* insertion sort that gives up after a few moves: false if `a` is unsorted */                       \
+    static inline bool name##__try_insertion(type *a, size_t n) {                                        \
+        size_t moved = 0;                                                                                \
+        for (size_t i = 1; i < n; i++) {                                                                 \
+            if (!less(a[i], a[i - 1])) continue;                                                         \
+            type x = a[i];                                                                               \
+            size_t j = i;                                                                                \
+            do {                                                                                         \
+                a[j] = a[j - 1];                                                                         \
+                j--;                                                                                     \
+            } while (j > 0 && less(x, a[j - 1]));                                                        \
+            a[j] = x;                                                                                    \
+            moved += i - j;                                                                              \
+            if (moved > 8) return false;                                                                 \
+        }                                                                                                \
+        return true;                                                                                     \
+    }                                                                                                    \
+    static inline void name##__sift(type *a, size_t i, size_t n) {                                       \
+        type x = a[i];                                                                                   \
+        for (size_t c; (c = 2 * i + 1) < n; i = c) {                                                     \
+            if (c + 1 < n && less(a[c], a[c + 1])) c++;                                                  \
+            if (!less(x, a[c])) break;                                                                   \
+            a[i] = a[c];                                                                                 \
+        }                                                                                                \
+        a[i] = x;                                                                                        \
+    }                                                                                                    \
+    static inline void name##__heapsort(type *a, size_t n) {                                             \
+        for (size_t i = n / 2; i-- > 0;) name##__sift(a, i, n);                                          \
+        for (size_t i = n; i-- > 1;) {                                                                   \
+            name##__swap(&a[0], &a[i]);                                                                  \
+            name##__sift(a, 0, i);                                                                       \
+        }                                                                                                \
+    }                                                                                                    \
+    /* partition around the pivot a[0], items equal to it go right; a[n - 1]                             \
+       must not be less than the pivot. Returns the pivot's new index and                                \
+       sets `*sorted` when no item had to move. Items are compared a block                               \
+       at a time, recording the offsets of misplaced ones without branching,                             \
+       then swapped in pairs (BlockQuicksort), so the comparisons never                                  \
+       mispredict on random input */                                                                     \
+    static inline size_t name##__partition_right(type *a, size_t n, bool *sorted) {                      \
+        type p = a[0];                                                                                   \
+        size_t i = 0, j = n;                                                                             \
+        while (less(a[++i], p));                                                                         \
+        if (i == 1)                                                                                      \
+            while (i < j && !less(a[--j], p));                                                           \
+        else                                                                                             \
+            while (!less(a[--j], p));                                                                    \
+        *sorted = i >= j;                                                                                \
+        if (!*sorted) name##__swap(&a[i++], &a[j]);                                                      \
+        unsigned char off_l[DS__SORT_BLOCK], off_r[DS__SORT_BLOCK];                                      \
+        size_t base_l = i, base_r = j, num_l = 0, num_r = 0, start_l = 0, start_r = 0;                   \
+        while (i < j) {                                                                                  \
+            size_t unknown = j - i;                                                                      \
+            size_t split_l = num_l == 0 ? (num_r == 0 ? unknown / 2 : unknown) : 0;                      \
+            size_t split_r = num_r == 0 ? unknown - split_l : 0;                                         \
+            if (split_l > DS__SORT_BLOCK) split_l = DS__SORT_BLOCK;                                      \
+            if (split_r > DS__SORT_BLOCK) split_r = DS__SORT_BLOCK;                                      \
+            for (size_t k = 0; k < split_l; k++) {                                                       \
+                off_l[num_l] = (unsigned char)k;                                                         \
+                num_l += !less(a[i], p);                                                                 \
+                i++;                                                                                     \
+            }                                                                                            \
+            for (size_t k = 0; k < split_r;) {                                                           \
+                off_r[num_r] = (unsigned char)++k;                                                       \
+                num_r += less(a[--j], p);                                                                \
+            }                                                                                            \
+            size_t num = num_l < num_r ? num_l : num_r;                                                  \
+            if (num_l == num_r) {                                                                        \
+                for (size_t k = 0; k < num; k++) {                                                       \
+                    name##__swap(&a[base_l + off_l[start_l + k]], &a[base_r - off_r[start_r + k]]);      \
+                }                                                                                        \
+            } else if (num > 0) {                                                                        \
+                /* one rotation through the pairs instead of `num` swaps */                              \
+                type *l = &a[base_l + off_l[start_l]];                                                   \
+                type *r = &a[base_r - off_r[start_r]];                                                   \
+                type t = *l;                                                                             \
+                *l = *r;                                                                                 \
+                for (size_t k = 1; k < num; k++) {                                                       \
+                    l = &a[base_l + off_l[start_l + k]];                                                 \
+                    *r = *l;                                                                             \
+                    r = &a[base_r - off_r[start_r + k]];                                                 \
+                    *l = *r;                                                                             \
+                }                                                                                        \
+                *r = t;                                                                                  \
+            }                                                                                            \
+            num_l -= num;                                                                                \
+            num_r -= num;                                                                                \
+            start_l += num;                                                                              \
+            start_r += num;                                                                              \
+            if (num_l == 0) {                                                                            \
+                start_l = 0;                                                                             \
+                base_l = i;                                                                              \
+            }                                                                                            \
+            if (num_r == 0) {                                                                            \
+                start_r = 0;                                                                             \
+                base_r = j;                                                                              \
+            }                                                                                            \
+        }                                                                                                \
+        /* one side has misplaced items left: move them next to the middle */                            \
+        if (num_l) {                                                                                     \
+            while (num_l--) name##__swap(&a[base_l + off_l[start_l + num_l]], &a[--j]);                  \
+            i = j;                                                                                       \
+        }                                                                                                \
+        if (num_r) {                                                                                     \
+            while (num_r--) name##__swap(&a[base_r - off_r[start_r + num_r]], &a[i++]);                  \
+        }                                                                                                \
+        a[0] = a[i - 1];                                                                                 \
+        a[i - 1] = p;                                                                                    \
+        return i - 1;                                                                                    \
+    }                                                                                                    \
+    /* partition around a[0] when nothing in `a` is less than it: items                                  \
+       equal to the pivot go left, which then needs no more sorting */                                   \
+    static inline size_t name##__partition_left(type *a, size_t n) {                                     \
+        type p = a[0];                                                                                   \
+        size_t i = 0, j = n;                                                                             \
+        while (less(p, a[--j]));                                                                         \
+        if (j + 1 == n)                                                                                  \
+            while (i < j && !less(p, a[++i]));                                                           \
+        else                                                                                             \
+            while (!less(p, a[++i]));                                                                    \
+        while (i < j) {                                                                                  \
+            name##__swap(&a[i], &a[j]);                                                                  \
+            while (less(p, a[--j]));                                                                     \
+            while (!less(p, a[++i]));                                                                    \
+        }                                                                                                \
+        a[0] = a[j];                                                                                     \
+        a[j] = p;                                                                                        \
+        return j;                                                                                        \
+    }                                                                                                    \
+    /* break up a pattern that gave an unbalanced partition */                                           \
+    static inline void name##__shuffle(type *a, size_t n) {                                              \
+        size_t q = n / 4;                                                                                \
+        name##__swap(&a[0], &a[q]);                                                                      \
+        name##__swap(&a[n - 1], &a[n - q]);                                                              \
+        if (n > 128) {                                                                                   \
+            name##__swap(&a[1], &a[q + 1]);                                                              \
+            name##__swap(&a[2], &a[q + 2]);                                                              \
+            name##__swap(&a[n - 2], &a[n - q - 1]);                                                      \
+            name##__swap(&a[n - 3], &a[n - q - 2]);                                                      \
+        }                                                                                                \
+    }                                                                                                    \
+    /* `leftmost`: a[-1] does not exist, otherwise no item is less than it */                            \
+    static void name##__pdq(type *a, size_t n, int bad, bool leftmost) {                                 \
+        while (n > DS_SORT_INSERTION) {                                                                  \
+            size_t h = n / 2;                                                                            \
+            if (n > 128) {                                                                               \
+                name##__sort3(&a[0], &a[h], &a[n - 1]);                                                  \
+                name##__sort3(&a[1], &a[h - 1], &a[n - 2]);                                              \
+                name##__sort3(&a[2], &a[h + 1], &a[n - 3]);                                              \
+                name##__sort3(&a[h - 1], &a[h], &a[h + 1]);                                              \
+                name##__swap(&a[0], &a[h]);                                                              \
+            } else {                                                                                     \
+                name##__sort3(&a[h], &a[0], &a[n - 1]);                                                  \
+            }                                                                                            \
+            if (!leftmost && !less(a[-1], a[0])) {                                                       \
+                size_t p = name##__partition_left(a, n) + 1;                                             \
+                a += p;                                                                                  \
+                n -= p;                                                                                  \
+                continue;                                                                                \
+            }                                                                                            \
+            bool sorted;                                                                                 \
+            size_t p = name##__partition_right(a, n, &sorted);                                           \
+            size_t ln = p, rn = n - p - 1;                                                               \
+            if (ln < n / 8 || rn < n / 8) {                                                              \
+                if (--bad == 0) {                                                                        \
+                    name##__heapsort(a, n);                                                              \
+                    return;                                                                              \
+                }                                                                                        \
+                if (ln > DS_SORT_INSERTION) name##__shuffle(a, ln);                                      \
+                if (rn > DS_SORT_INSERTION) name##__shuffle(a + p + 1, rn);                              \
+            } else if (sorted && name##__try_insertion(a, ln) && name##__try_insertion(a + p + 1, rn)) { \
+                return;                                                                                  \
+            }                                                                                            \
+            /* recurse into the smaller side, loop on the larger */                                      \
+            if (ln < rn) {                                                                               \
+                name##__pdq(a, ln, bad, leftmost);                                                       \
+                a += p + 1;                                                                              \
+                n = rn;                                                                                  \
+                leftmost = false;                                                                        \
+            } else {                                                                                     \
+                name##__pdq(a + p + 1, rn, bad, false);                                                  \
+                n = ln;                                                                                  \
+            }                                                                                            \
+        }                                                                                                \
+        name##__insertion(a, n);                                                                         \
+    }                                                                                                    \
+    static inline void name##_sort(type *a, size_t n) {                                                  \
+        int bad = 1;                                                                                     \
+        while (n >> bad) bad++;                                                                          \
+        name##__pdq(a, n, bad, true);                                                                    \
+    }                                                                                                    \
+    static inline bool name##_is_sorted(const type *a, size_t n) {                                       \
+        for (size_t i = 1; i < n; i++) {                                                                 \
+            if (less(a[i], a[i - 1])) return false;                                                      \
+        }                                                                                                \
+        return true;                                                                                     \
+    }                                                                                                    \
+    static inline void name##_merge(type *out, const type *a, size_t na, const type *b, size_t nb) {     \
+        size_t i = 0, j = 0;                                                                             \
+        while (i < na && j < nb) *out++ = less(b[j], a[i]) ? b[j++] : a[i++];                            \
+        if (i < na) memcpy(out, a + i, (na - i) * sizeof(type));                                         \
+        if (j < nb) memcpy(out, b + j, (nb - j) * sizeof(type));                                         \
+    }                                                                                                    \
+    static inline void name##_stable_sort(type *a, size_t n) {                                           \
+        const size_t run = DS_SORT_INSERTION;                                                            \
+        if (n <= run) {                                                                                  \
+            name##__insertion(a, n);                                                                     \
+            return;                                                                                      \
+        }                                                                                                \
+        for (size_t i = 0; i < n; i += run) name##__insertion(a + i, n - i < run ? n - i : run);         \
+        type *buf = DS_ALLOC(n * sizeof(type));                                                          \
+        assert(buf && "out of memory");                                                                  \
+        type *src = a;                                                                                   \
+        type *dst = buf;                                                                                 \
+        for (size_t w = run; w < n; w *= 2) {                                                            \
+            for (size_t i = 0; i < n; i += 2 * w) {                                                      \
+                size_t m = n - i < w ? n : i + w, e = n - i < 2 * w ? n : i + 2 * w;                     \
+                if (m == e || !less(src[m], src[m - 1]))                                                 \
+                    memcpy(dst + i, src + i, (e - i) * sizeof(type));                                    \
+                else                                                                                     \
+                    name##_merge(dst + i, src + i, m - i, src + m, e - m);                               \
+            }                                                                                            \
+            type *t = src;                                                                               \
+            src = dst;                                                                                   \
+            dst = t;                                                                                     \
+        }                                                                                                \
+        if (src != a) memcpy(a, src, n * sizeof(type));                                                  \
+        DS_FREE(buf);                                                                                    \
+    }                                                                                                    \
+    static inline size_t name##_lower_bound(const type *a, size_t n, type key) {                         \
+        if (n == 0) return 0;                                                                            \
+        const type *base = a;                                                                            \
+        while (n > 1) {                                                                                  \
+            size_t half = n / 2;                                                                         \
+            base += less(base[half - 1], key) ? half : 0;                                                \
+            n -= half;                                                                                   \
+        }                                                                                                \
+        return (size_t)(base - a) + (less(*base, key) ? 1 : 0);                                          \
+    }                                                                                                    \
+    static inline size_t name##_upper_bound(const type *a, size_t n, type key) {                         \
+        if (n == 0) return 0;                                                                            \
+        const type *base = a;                                                                            \
+        while (n > 1) {                                                                                  \
+            size_t half = n / 2;                                                                         \
+            base += less(key, base[half - 1]) ? 0 : half;                                                \
+            n -= half;                                                                                   \
+        }                                                                                                \
+        return (size_t)(base - a) + (less(key, *base) ? 0 : 1);                                          \
+    }                                                                                                    \
+    static inline type *name##_bsearch(const type *a, size_t n, type key) {                              \
+        size_t i = name##_lower_bound(a, n, key);                                                        \
+        return i < n && !less(key, a[i]) ? (type *)&a[i] : NULL;                                         \
+    }
+
+/**
+ * Sort a dynamic array with the functions of `ds_sort_declare(name, ...)`.
+ * Example:
+ *   `ds_da_sort(&a, IntSort);`
+ */
+#define ds_da_sort(da, name) name##_sort((da)->data, (da)->length)
+
+/**
+ * Stable sort of a dynamic array, see `ds_sort_declare`.
+ */
+#define ds_da_stable_sort(da, name) name##_stable_sort((da)->data, (da)->length)
+
+/**
+ * Binary search in a sorted dynamic array: a pointer to an item equal to
+ * `key`, or NULL.
+ * Example:
+ *   `int *x = ds_da_bsearch(&a, IntSort, 42);`
+ */
+#define ds_da_bsearch(da, name, key) name##_bsearch((da)->data, (da)->length, (key))
+
+/**
+ * Index of the first item not less than `key` in a sorted dynamic array,
+ * `length` if there is none.
+ */
+#define ds_da_lower_bound(da, name, key) name##_lower_bound((da)->data, (da)->length, (key))
+
+/**
+ * Index of the first item greater than `key` in a sorted dynamic array,
+ * `length` if there is none.
+ */
+#define ds_da_upper_bound(da, name, key) name##_upper_bound((da)->data, (da)->length, (key))
+
+/**
+ * Merge the sorted dynamic arrays `a` and `b` into `out`, replacing its
+ * items; `out` must be neither of them.
+ * Example:
+ *   `ds_da_merge(&out, &a, &b, IntSort);`
+ */
+#define ds_da_merge(out, a, b, name)                                               \
+    do {                                                                           \
+        ds_da_reserve_min((out), (a)->length + (b)->length);                       \
+        name##_merge((out)->data, (a)->data, (a)->length, (b)->data, (b)->length); \
+        (out)->length = (a)->length + (b)->length;                                 \
+    } while (0)
+
+void ds__radix_sort(void *data, size_t n, size_t size, size_t key_offset, size_t key_size, int kind);
+
+/* how ds__radix_sort maps a key to an unsigned integer: 0 as is, 1 signed,
+ * 2 float, -1 for the types it cannot sort (pointers, long double, structs) */
+#define ds__radix_kind(x)      \
+    _Generic((x),              \
+        _Bool: 0,              \
+        char: (char)-1 < 0,    \
+        signed char: 1,        \
+        unsigned char: 0,      \
+        short: 1,              \
+        unsigned short: 0,     \
+        int: 1,                \
+        unsigned int: 0,       \
+        long: 1,               \
+        unsigned long: 0,      \
+        long long: 1,          \
+        unsigned long long: 0, \
+        float: 2,              \
+        double: 2,             \
+        default: -1)
+
+#define ds__radix_sort_kind(x)                                                              \
+    ({                                                                                      \
+        _Static_assert(ds__radix_kind(x) >= 0, "radix sort needs an integer or float key"); \
+        ds__radix_kind(x);                                                                  \
+    })
+
+/**
+ * Sort a dynamic array of integers or floats with an LSD radix sort: one
+ * pass per key byte, bytes shared by all keys are skipped. Stable, O(n) and
+ * allocates a buffer of `length` items. Negative zero sorts before zero,
+ * NaNs go to the ends by sign. Other key types, such as pointers or
+ * `long double`, fail to compile.
+ * Example:
+ *   `ds_da_radix_sort(&a);`
+ */
+#define ds_da_radix_sort(da)                                                              \
+    ds__radix_sort((da)->data, (da)->length, sizeof(*(da)->data), 0, sizeof(*(da)->data), \
+                   ds__radix_sort_kind(*(da)->data))
+
+/**
+ * Radix sort a dynamic array of structs by their integer or float `field`,
+ * like `ds_da_radix_sort`. Stable, so sorting by a secondary field first
+ * orders the ties.
+ * Example:
+ ```c
+ typedef struct { const char *name; int age; } Person;
+ ds_da_declare(People, Person);
+ ...
+    ds_da_radix_sort_by(&people, age);
+ ```
+ */
+#define ds_da_radix_sort_by(da, field)                                                                      \
+    ds__radix_sort((da)->data, (da)->length, sizeof(*(da)->data), offsetof(__typeof__(*(da)->data), field), \
+                   sizeof((da)->data->field), ds__radix_sort_kind((da)->data->field))
+
+#ifndef DS_SEG_CHUNK
+/**
+ * Items in the first chunk of a `ds_seg_declare` array, a power of two.
+ * Chunk `k` holds `DS_SEG_CHUNK << k` items.
+ */
+#define DS_SEG_CHUNK 64
+#endif // DS_SEG_CHUNK
+
+/* chunk directory size: room for DS_SEG_CHUNK * (2^48 - 1) items */
+#define DS__SEG_CHUNKS 48
+
+/**
+ * Segmented array declaration.
+ * Items live in chunks that double in size, found through a fixed directory
+ * of chunk pointers: growing allocates one new chunk and never moves items,
+ * so pointers to them stay valid until they are popped or the array is
+ * freed. Indexing is O(1) (a bit scan and two loads) and at most half of the
+ * capacity is unused.
+ * Example:
+ ```c
+ ds_seg_declare(Nodes, Node);
+ ...
+    Nodes nodes = {0};
+    ds_seg_append(&nodes, ((Node){.id = 1}));
+    Node *first = ds_seg_at(&nodes, 0); // stays valid while nodes grows
+    ds_seg_foreach(&nodes, n) printf("%d\n", n->id);
+    ds_seg_free(&nodes);
+ ```
+ */
+#define ds_seg_declare(name, type)    \
+    typedef struct {                  \
+        type *chunks[DS__SEG_CHUNKS]; \
+        size_t length;                \
+        size_t capacity;              \
+    } name
+
+#define ds__seg_chunk_len(k) ((size_t)DS_SEG_CHUNK << (k))
+
+/* chunk of item `i`, and its offset in the chunk in `*off` */
+static inline size_t ds__seg_locate(size_t i, size_t *off) {
+    size_t shift = (size_t)__builtin_ctzll(DS_SEG_CHUNK);
+    size_t k = 63 - (size_t)__builtin_clzll((unsigned long long)(i >> shift) + 1);
+    *off = i - ((((size_t)1 << k) - 1) << shift);
+    return k;
+}
+
+/**
+ * Pointer to item `i` of a segmented array, `i` < length.
+ */
+#define ds_seg_at(seg, i)                       \
+    ({                                          \
+        size_t _off;                            \
+        size_t _k = ds__seg_locate((i), &_off); \
+        &(seg)->chunks[_k][_off];               \
+    })
+
+/**
+ * Make room for `n` items in a segmented array, allocating chunks.
+ */
+#define ds_seg_reserve(seg, n)                                                                          \
+    do {                                                                                                \
+        for (size_t _k = 0, _cap = 0; (seg)->capacity < (size_t)(n); _cap += ds__seg_chunk_len(_k++)) { \
+            if (_cap < (seg)->capacity) continue;                                                       \
+            assert(_k < DS__SEG_CHUNKS);                                                                \
+            (seg)->chunks[_k] = DS_ALLOC(ds__seg_chunk_len(_k) * sizeof(*(seg)->chunks[0]));            \
+            assert((seg)->chunks[_k] != NULL);                                                          \
+            (seg)->capacity += ds__seg_chunk_len(_k);                                                   \
+        }                                                                                               \
+    } while (0)
+
+/**
+ * Append an item to a segmented array.
+ */
+#define ds_seg_append(seg, item)                   \
+    do {                                           \
+        ds_seg_reserve((seg), (seg)->length + 1);  \
+        *ds_seg_at((seg), (seg)->length) = (item); \
+        (seg)->length++;                           \
+    } while (0)
+
+/**
+ * Append `n` items from a plain array to a segmented array, one `memcpy`
+ * per chunk.
+ * Example:
+ *   `ds_seg_append_many(&s, (int[]){1, 2, 3}, 3);`
+ */
+#define ds_seg_append_many(seg, items, n)                                                         \
+    do {                                                                                          \
+        size_t _n = (n), _done = 0;                                                               \
+        ds_seg_reserve((seg), (seg)->length + _n);                                                \
+        while (_done < _n) {                                                                      \
+            size_t _off;                                                                          \
+            size_t _k = ds__seg_locate((seg)->length, &_off);                                     \
+            size_t _room = ds__seg_chunk_len(_k) - _off;                                          \
+            size_t _step = _n - _done < _room ? _n - _done : _room;                               \
+            memcpy(&(seg)->chunks[_k][_off], (items) + _done, _step * sizeof(*(seg)->chunks[0])); \
+            (seg)->length += _step;                                                               \
+            _done += _step;                                                                       \
+        }                                                                                         \
+    } while (0)
+
+/**
+ * Pointer to the last item of a segmented array, or NULL if it is empty.
+ */
+#define ds_seg_last(seg) ((seg)->length > 0 ? ds_seg_at((seg), (seg)->length - 1) : NULL)
+
+/**
+ * Remove and return the last item of a segmented array. Chunks are kept.
+ */
+#define ds_seg_pop(seg)                   \
+    ({                                    \
+        assert((seg)->length > 0);        \
+        (seg)->length--;                  \
+        *ds_seg_at((seg), (seg)->length); \
+    })
+
+/**
+ * Free all the chunks of a segmented array.
+ */
+#define ds_seg_free(seg)                                                                       \
+    do {                                                                                       \
+        for (size_t _k = 0, _cap = 0; _cap < (seg)->capacity; _cap += ds__seg_chunk_len(_k++)) \
+            DS_FREE((seg)->chunks[_k]);                                                        \
+        memset((seg), 0, sizeof(*(seg)));                                                      \
+    } while (0)
+
+/**
+ * Iterate over a segmented array in order, chunk by chunk, with `var`
+ * pointing at the current item; `break` leaves the whole loop.
+ * Example:
+ *   `ds_seg_foreach(&s, x) sum += *x;`
+ */
+#define ds_seg_foreach(seg, var)                                                                                \
+    for (size_t _k = 0, _base = 0, _more = 1; _more && _base < (seg)->length; _base += ds__seg_chunk_len(_k++)) \
+        for (__typeof__((seg)->chunks[0]) var = (_more = 0, (seg)->chunks[_k]),                                 \
+                                          _end = var + ((seg)->length - _base < ds__seg_chunk_len(_k)           \
+                                                            ? (seg)->length - _base                             \
+                                                            : ds__seg_chunk_len(_k));                           \
+             var < _end ? 1 : (_more = 1, 0); var++)
+
 /**
  * Dynamic string.
  */
@@ -392,11 +1098,204 @@ DsString *ds_str_rtrim(DsString *str);
 _Static_assert((DS_HM_INIT_CAPACITY & (DS_HM_INIT_CAPACITY - 1)) == 0,
                "DS_HM_INIT_CAPACITY must be a power of 2");
 
+#ifndef DS_HM_INCREMENTAL_MIN_CAPACITY
+/**
+ * Tables smaller than this are always resized in one go, even with
+ * incremental resizing enabled.
+ */
+#define DS_HM_INCREMENTAL_MIN_CAPACITY 1024
+#endif
+
+#ifndef DS_HM_MIGRATE_STEP
+/**
+ * Number of old table slots migrated by each operation while an
+ * incremental resize is in progress.
+ */
+#define DS_HM_MIGRATE_STEP 16
+#endif
+
+#ifndef DS_HM_BATCH
+/**
+ * Number of keys the bulk operations (`ds_hm_get_many`, ...) hash and
+ * prefetch before resolving them. Enough to cover a memory round trip.
+ */
+#define DS_HM_BATCH 32
+#endif
+
+#ifndef DS_HM_FREEZE_BUCKET
+/**
+ * Average number of keys per displacement bucket of a frozen map: more
+ * keys per bucket make the table smaller but freezing slower.
+ */
+#define DS_HM_FREEZE_BUCKET 4
+#endif
+
+#ifndef DS_HM_MAX_PROBE
+/**
+ * Longest probe distance a Robin Hood table accepts before it is grown and
+ * reseeded on the next insert, see `ds_hm_robin_hood`.
+ */
+#define DS_HM_MAX_PROBE 64
+#endif
+
+#ifndef DS_HM_PREFETCH_MIN_CAPACITY
+/**
+ * Tables with fewer slots are assumed to be in cache and the bulk
+ * operations skip prefetching for them.
+ */
+#define DS_HM_PREFETCH_MIN_CAPACITY (1u << 17)
+#endif
+
+#ifndef DS_HS_PARALLEL_MIN
+/**
+ * Set operations (`ds_hs_intersect`, `ds_hs_intersect_count`, `ds_hs_sub`)
+ * split their lookups over DS_HS_THREADS threads once the set they walk
+ * has this many values.
+ */
+#define DS_HS_PARALLEL_MIN (1u << 20)
+#endif
+
+#ifndef DS_HS_THREADS
+/**
+ * Threads used by the large set operations, see DS_HS_PARALLEL_MIN. 1
+ * keeps them on the calling thread.
+ */
+#define DS_HS_THREADS 4
+#endif
+
+#ifndef DS_HM_STATS_HIST
+/**
+ * Buckets of the probe length histogram filled by `ds_hm_stats`.
+ */
+#define DS_HM_STATS_HIST 8
+#endif
+
+/**
+ * Define DS_HM_STORE_HASH to make every hash map and set keep the full hash
+ * of each entry (see `ds_hm_store_hash`), DS_HM_INCREMENTAL_RESIZE to
+ * resize all of them incrementally (see `ds_hm_incremental_resize`) and
+ * DS_HM_ROBIN_HOOD to give all of them Robin Hood probing (see
+ * `ds_hm_robin_hood`).
+ */
+#ifdef DS_HM_STORE_HASH
+#define DS__HT_DEFAULT_STORE_HASH DS__HT_STORE_HASH
+#else
+#define DS__HT_DEFAULT_STORE_HASH 0
+#endif
+#ifdef DS_HM_INCREMENTAL_RESIZE
+#define DS__HT_DEFAULT_INCREMENTAL DS__HT_INCREMENTAL
+#else
+#define DS__HT_DEFAULT_INCREMENTAL 0
+#endif
+#ifdef DS_HM_ROBIN_HOOD
+#define DS__HT_DEFAULT_ROBIN_HOOD DS__HT_ROBIN_HOOD
+#else
+#define DS__HT_DEFAULT_ROBIN_HOOD 0
+#endif
+#define DS__HT_DEFAULT_FLAGS \
+    (DS__HT_DEFAULT_STORE_HASH | DS__HT_DEFAULT_INCREMENTAL | DS__HT_DEFAULT_ROBIN_HOOD)
+
+/* Index table: `data` maps a slot to an index into the dense entry array,
+ * followed in the same allocation by one control byte per slot
+ * (`ds__table_ctrl`), either DS__CTRL_EMPTY or the top 7 bits of the entry
+ * hash. Indices are stored `width` bytes wide (1, 2, 4 or 8), the smallest
+ * width that can address `capacity` entries. Probes scan the control bytes
+ * a whole group at a time and only dereference the entries whose control
+ * byte matches; DS__GROUP_WIDTH extra control bytes mirror the head so a
+ * group can be loaded at any slot without wrapping.
+ * A frozen table (DS__HT_FROZEN) has no control bytes: `data` holds one
+ * uint32_t displacement per bucket, `capacity` buckets, and every entry
+ * sits at the position its displacement gives, see `ds_hm_freeze`.
+ * With DS__HT_ROBIN_HOOD the entries of a cluster are kept ordered by home
+ * slot, so a lookup can stop as soon as it reaches an entry living closer
+ * to its home than the key would.
+ * A mapped table (DS__HT_MAPPED) points into a read-only file image, where
+ * `char *` keys hold the offset of their string from their own entry.
+ * `resizes` counts index rebuilds. The state only some maps need lives in
+ * `extra`, allocated by the first feature that uses it, so a plain map
+ * keeps a small header. */
 struct ds__ht_idxs {
-    size_t *data;
+    void *data;
+    struct ds__ht_extra *extra;
     size_t capacity;
+    uint32_t resizes;
+    uint16_t flags;
+    uint8_t width;
+};
+
+/* With DS__HT_STORE_HASH `hashes` keeps the full hash of every entry, indexed
+ * like the data array, so resizes and removals never call the hash function.
+ * During an incremental resize `old` holds the previous table; entries live
+ * in exactly one of the two tables until it is drained.
+ * `keys` is the arena copied string keys are allocated from (NULL: one
+ * DS_ALLOC per key); with DS__HT_OWN_KEYS it belongs to the map.
+ * `bloom`, if set, holds the hash of every inserted key, see `ds_hs_bloom`.
+ * `max_probe` is the longest distance of any Robin Hood entry from its home
+ * slot, and with DS_HM_STATS `counters` count the key searches, see
+ * `ds_hm_stats`. Tables built under DS_HM_STATS always have one, so the
+ * counters are never allocated by a lookup. */
+struct ds__ht_extra {
+    size_t *hashes;
+    struct ds__ht_migration *old;
+    struct DsArena *keys;
+    struct DsBloom *bloom;
+    size_t max_probe;
+#ifdef DS_HM_STATS
+    struct {
+        size_t lookups, misses, probes;
+    } counters;
+#endif
+};
+
+#define ds__table_ctrl(t) ((uint8_t *)(t)->data + (t)->capacity * (t)->width)
+
+#define ds__ht_hashes(t) ((t)->extra ? (t)->extra->hashes : NULL)
+#define ds__ht_old(t) ((t)->extra ? (t)->extra->old : NULL)
+#define ds__ht_keys(t) ((t)->extra ? (t)->extra->keys : NULL)
+#define ds__ht_bloom(t) ((t)->extra ? (t)->extra->bloom : NULL)
+#define ds__ht_max_probe(t) ((t)->extra ? (t)->extra->max_probe : 0)
+
+/* `extra` of the table, allocated on first use */
+struct ds__ht_extra *ds__table_extra(struct ds__ht_idxs *t);
+
+struct ds__ht_migration {
+    struct ds__ht_idxs table;
+    size_t pos; // next old slot to migrate
 };
 
+#define DS__CTRL_EMPTY ((uint8_t)0x80)
+#define DS__HT_STORE_HASH 0x1u
+#define DS__HT_INCREMENTAL 0x2u
+#define DS__HT_OWN_KEYS 0x4u
+#define DS__HT_FROZEN 0x8u
+#define DS__HT_ROBIN_HOOD 0x10u
+#define DS__HT_KEEP_SEED 0x20u /* hashes come from outside: never reseed */
+#define DS__HT_MAPPED 0x40u    /* read-only image mapped by ds_hm_map */
+#define DS__HT_BORROWED 0x80u  /* ds_hm_declare_ex keys: stored as given, never freed */
+
+/* Bump a DS_HM_STATS counter of a table. Relaxed load and store rather than
+ * an atomic add: concurrent readers may lose counts but never race. */
+#ifdef DS_HM_STATS
+#define DS__HT_COUNT(ht, field, n)                                                               \
+    do {                                                                                         \
+        struct ds__ht_extra *_x = ((struct ds__ht *)(ht))->table.extra;                          \
+        if (_x) {                                                                                \
+            size_t *_c = &_x->counters.field;                                                    \
+            __atomic_store_n(_c, __atomic_load_n(_c, __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED); \
+        }                                                                                        \
+    } while (0)
+#else
+#define DS__HT_COUNT(ht, field, n) ((void)0)
+#endif
+
+#if defined(__AVX2__)
+#define DS__GROUP_WIDTH 32
+#elif defined(__SSE2__) || defined(_M_X64)
+#define DS__GROUP_WIDTH 16
+#else
+#define DS__GROUP_WIDTH 8
+#endif
+
 /* Generic view over hashmap/hashset structs: ds_Hm and ds_Hs share this
  * common initial sequence, so a pointer to either can be cast to ds_ht *. */
 struct ds__ht {
@@ -407,6 +1306,68 @@ struct ds__ht {
     size_t seed;
 };
 
+/**
+ * Seeded wyhash-style hash of `len` bytes, reading 8 bytes per step.
+ */
+size_t ds_wyhash(const void *data, size_t len, size_t seed);
+/**
+ * 64-bit FNV-1a, kept as a simple byte-at-a-time alternative for DS_HASH_FN.
+ */
+size_t ds_fnv1a(const void *data, size_t len, size_t seed);
+
+static inline void ds__wymum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t ds__wymix(uint64_t a, uint64_t b) {
+    ds__wymum(&a, &b);
+    return a ^ b;
+}
+
+/**
+ * Seeded mix for fixed-size integer keys (two multiplies, full avalanche).
+ * Inline, so maps hashing integers or small structs never call out.
+ */
+static inline size_t ds_hash_u64(uint64_t x, size_t seed) {
+    uint64_t a = x ^ 0x2d358dccaa6c78a5ull, b = (uint64_t)seed ^ 0x8bb84b93962eacc9ull;
+    ds__wymum(&a, &b);
+    return (size_t)ds__wymix(a ^ 0x2d358dccaa6c78a5ull, b ^ 0x8bb84b93962eacc9ull);
+}
+
+#ifndef DS_HASH_FN
+/**
+ * Hash used by maps and sets for string and byte keys:
+ * `size_t fn(const void *data, size_t len, size_t seed)`.
+ * Define it before including ds.h to plug a different algorithm, e.g.
+ * `#define DS_HASH_FN ds_fnv1a`.
+ */
+#define DS_HASH_FN ds_wyhash
+#endif
+
+#ifndef DS_HASH_INT_FN
+/**
+ * Hash used by maps and sets for 4 and 8 byte keys: `size_t fn(uint64_t x, size_t seed)`.
+ */
+#define DS_HASH_INT_FN ds_hash_u64
+#endif
+
+/**
+ * Hash a buffer with the configured DS_HASH_FN.
+ */
+#define ds_hash(data, len, seed) DS_HASH_FN((data), (len), (seed))
+
 typedef size_t (*ds_entry_hash_fn)(const void *entry, size_t key_size, size_t seed);
 typedef int (*ds_entry_eq_fn)(const void *entry, const void *user_key, size_t key_size);
 
@@ -414,32 +1375,204 @@ size_t ds__hash_string(const void *entry, size_t key_size, size_t seed);
 size_t ds__hash_bytes(const void *entry, size_t key_size, size_t seed);
 int ds__eq_str(const void *entry, const void *user_key, size_t key_size);
 int ds__eq_bytes(const void *entry, const void *user_key, size_t key_size);
+/* `user_key` is a DsStringIterator, the entry a copied (length-prefixed) key */
+int ds__eq_sv(const void *entry, const void *user_key, size_t key_size);
+
+/* hash of a string view, equal to the hash of the same bytes as a `char *` key */
+#define ds__hash_sv(data, len, seed) ((data) ? DS_HASH_FN((data), (len), (seed)) : (size_t)(seed))
+
+/* Group matching over control bytes. A match mask has one bit set per
+ * matching lane, lane = ctz(mask) >> DS__GROUP_SHIFT. */
+#if defined(__AVX2__)
+#define DS__GROUP_SHIFT 0
+static inline uint64_t ds__group_match(const uint8_t *ctrl, uint8_t h2) {
+    __m256i g = _mm256_loadu_si256((const __m256i *)ctrl);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(g, _mm256_set1_epi8((char)h2)));
+}
+static inline uint64_t ds__group_match_empty(const uint8_t *ctrl) {
+    return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)ctrl));
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+#define DS__GROUP_SHIFT 0
+static inline uint64_t ds__group_match(const uint8_t *ctrl, uint8_t h2) {
+    __m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)h2)));
+}
+static inline uint64_t ds__group_match_empty(const uint8_t *ctrl) {
+    return (uint16_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+#elif defined(__ARM_NEON)
+#define DS__GROUP_SHIFT 3
+static inline uint64_t ds__group_match(const uint8_t *ctrl, uint8_t h2) {
+    uint8x8_t eq = vceq_u8(vld1_u8(ctrl), vdup_n_u8(h2));
+    return vget_lane_u64(vreinterpret_u64_u8(eq), 0) & 0x8080808080808080ull;
+}
+static inline uint64_t ds__group_match_empty(const uint8_t *ctrl) {
+    return vget_lane_u64(vreinterpret_u64_u8(vld1_u8(ctrl)), 0) & 0x8080808080808080ull;
+}
+#else
+#define DS__GROUP_SHIFT 3
+/* Portable SWAR fallback (little-endian lane order). Full control bytes are
+ * < 0x80, so the zero-byte trick may only report false positives for bytes
+ * that get compared against the key anyway; the empty mask is exact. */
+static inline uint64_t ds__group_load(const uint8_t *ctrl) {
+    uint64_t g;
+    memcpy(&g, ctrl, sizeof(g));
+    return g;
+}
+static inline uint64_t ds__group_match(const uint8_t *ctrl, uint8_t h2) {
+    uint64_t x = ds__group_load(ctrl) ^ (0x0101010101010101ull * h2);
+    return (x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull;
+}
+static inline uint64_t ds__group_match_empty(const uint8_t *ctrl) {
+    return ds__group_load(ctrl) & 0x8080808080808080ull;
+}
+#endif
+
+static inline size_t ds__group_lane(uint64_t mask) {
+    return (size_t)__builtin_ctzll(mask) >> DS__GROUP_SHIFT;
+}
+
+static inline size_t ds__table_idx(const struct ds__ht_idxs *table, size_t slot) {
+    switch (table->width) {
+    case 1: return ((const uint8_t *)table->data)[slot];
+    case 2: return ((const uint16_t *)table->data)[slot];
+    case 4: return ((const uint32_t *)table->data)[slot];
+    default: return (size_t)((const uint64_t *)table->data)[slot];
+    }
+}
+
+/* Top 7 bits of a multiplicative remix of the hash, so the control byte stays
+ * independent from the low bits used for slot selection. */
+static inline uint8_t ds__ht_h2(size_t hash) {
+    return (uint8_t)(((uint64_t)hash * 0x9E3779B97F4A7C15ull) >> 57);
+}
+
+/* Probe `t` (the index of `ht`, or the old one during an incremental
+ * resize) for `user_key`. On a miss `out_slot` is where it would go. Inline
+ * so callers passing a known `eq_fn` get it inlined into the loop. */
+static inline bool ds__table_probe(const struct ds__ht *ht, const struct ds__ht_idxs *t, size_t entry_size, size_t key_size, const void *user_key, size_t key_hash, ds_entry_eq_fn eq_fn, size_t *out_slot, size_t *out_idx) {
+    size_t mask = t->capacity - 1;
+    size_t pos = key_hash & mask;
+    uint8_t h2 = ds__ht_h2(key_hash);
+    for (;;) {
+        const uint8_t *group = ds__table_ctrl(t) + pos;
+        DS__HT_COUNT(ht, probes, 1);
+        uint64_t match = ds__group_match(group, h2);
+        uint64_t empty = ds__group_match_empty(group);
+        /* slots past the first empty one belong to other probe sequences */
+        if (empty) match &= (empty & (0 - empty)) - 1;
+        while (match) {
+            size_t slot = (pos + ds__group_lane(match)) & mask;
+            size_t idx = ds__table_idx(t, slot);
+            const void *entry = (const char *)ht->data + idx * entry_size;
+            if (eq_fn(entry, user_key, key_size)) {
+                *out_slot = slot;
+                *out_idx = idx;
+                return true;
+            }
+            match &= match - 1;
+        }
+        if (empty) {
+            *out_slot = (pos + ds__group_lane(empty)) & mask;
+            return false;
+        }
+        if (t->flags & DS__HT_ROBIN_HOOD) {
+            /* the key would sit no further than max_probe, and before the
+             * first entry closer to its own home than the key is to ours.
+             * Checking that costs a random load, the next group a
+             * sequential one: only do it once the probe gets long. */
+            size_t last = (pos + DS__GROUP_WIDTH - 1) & mask;
+            size_t dist = (last - key_hash) & mask;
+            if (dist >= ds__ht_max_probe(t) ||
+                (dist >= 2 * DS__GROUP_WIDTH &&
+                 ((last - ht->table.extra->hashes[ds__table_idx(t, last)]) & mask) < dist)) {
+                *out_slot = last;
+                return false;
+            }
+        }
+        pos = (pos + DS__GROUP_WIDTH) & mask;
+    }
+}
 
-bool ds__table_find(const struct ds__ht *ht, size_t entry_size, size_t key_size, const void *user_key, size_t key_hash, ds_entry_eq_fn eq_fn, size_t *out_slot, size_t *out_idx);
+bool ds__table_find(struct ds__ht *ht, size_t entry_size, size_t key_size, const void *user_key, size_t key_hash, ds_entry_eq_fn eq_fn, size_t *out_slot, size_t *out_idx);
+
+/* Returns the slot the entry went to: `slot` unless Robin Hood ordering
+ * puts it elsewhere */
+size_t ds__table_insert(struct ds__ht_idxs *table, size_t slot, size_t key_hash, size_t idx);
+
+size_t ds__ht_fit_capacity(size_t length);
 
 void ds__table_resize(struct ds__ht *ht, size_t entry_size, size_t key_size, ds_entry_hash_fn hash_fn, size_t new_capacity);
 
 void ds__table_remove_slot(struct ds__ht *ht, size_t entry_size, size_t key_size, ds_entry_hash_fn hash_fn, size_t slot, size_t idx);
 
-#define ds__ht_view(ht) ((struct ds__ht *)(void *)(ht))
+void ds__table_free(struct ds__ht_idxs *table);
 
-#define ds__ht_key_is_cstr(key) \
-    _Generic((key), char *: true, const char *: true, default: false)
+bool ds__hm_save(struct ds__ht *ht, size_t entry_size, size_t key_size, bool cstr_keys, ds_entry_hash_fn hash_fn, const char *path);
+bool ds__hm_map(struct ds__ht *ht, size_t entry_size, size_t key_size, bool cstr_keys, ds_entry_hash_fn hash_fn, const char *path);
+void ds__hm_unmap(struct ds__ht *ht);
+const char *ds__mapped_str(const void *entry);
 
-void ds__ht_copy_key(void *dst, const void *src, size_t key_size, bool is_cstr_key);
-void ds__ht_free_key(void *key, bool is_cstr_key);
+void ds__table_clear(struct ds__ht_idxs *table);
 
-void ds__ht_free_cstr_keys(void *ht, size_t entry_size);
+bool ds__table_freeze(struct ds__ht *ht, size_t entry_size, size_t key_size, ds_entry_hash_fn hash_fn);
 
-#define ds__ht_free_keys(ht)                                           \
-    do {                                                               \
-        if (ds__ht_key_is_cstr((ht)->data[0].key)) {                   \
-            ds__ht_free_cstr_keys(ds__ht_view(ht),                     \
-                                  sizeof(*(ht)->data));                \
-        }                                                              \
-    } while (0)
+void ds__table_bloom(struct ds__ht *ht, size_t entry_size, size_t key_size, ds_entry_hash_fn hash_fn, double fpp);
 
-#define ds__entry_hfn(key)             \
+/* Bulk set operations over sets of the same type; `set` is modified, the
+ * other is only read. `cstr` sets hold `char *` values. */
+void ds__hs_cat(struct ds__ht *set, struct ds__ht *other, size_t entry_size, ds_entry_hash_fn hash_fn, ds_entry_eq_fn eq_fn, bool cstr);
+void ds__hs_sub(struct ds__ht *set, struct ds__ht *other, size_t entry_size, ds_entry_hash_fn hash_fn, ds_entry_eq_fn eq_fn, bool cstr);
+void ds__hs_intersect(struct ds__ht *set, struct ds__ht *other, size_t entry_size, ds_entry_hash_fn hash_fn, ds_entry_eq_fn eq_fn, bool cstr);
+size_t ds__hs_intersect_count(struct ds__ht *set, struct ds__ht *other, size_t entry_size, ds_entry_hash_fn hash_fn, ds_entry_eq_fn eq_fn, bool cstr);
+
+/* Bulk lookup stages: prefetch the slot of a hash, then (once it has
+ * arrived) the entry its first matching control byte points to. The
+ * prefetches are issued by the caller: a function doing nothing but
+ * prefetching has no side effects and compilers drop calls to it. */
+#if defined(__GNUC__) || defined(__clang__)
+#define DS__PREFETCH(p) __builtin_prefetch((p))
+#else
+#define DS__PREFETCH(p) ((void)(p))
+#endif
+
+#define ds__table_prefetch(table, key_hash)                                   \
+    do {                                                                      \
+        if ((table)->capacity && !((table)->flags & DS__HT_FROZEN)) {         \
+            size_t _ps = (key_hash) & ((table)->capacity - 1);                \
+            DS__PREFETCH(ds__table_ctrl(table) + _ps);                        \
+            DS__PREFETCH((const char *)(table)->data + _ps * (table)->width); \
+        }                                                                     \
+    } while (0)
+
+const void *ds__table_entry_guess(const struct ds__ht *ht, size_t entry_size, size_t key_hash);
+
+#define ds__ht_view(ht) ((struct ds__ht *)(void *)(ht))
+
+#define ds__ht_key_is_cstr(key) \
+    _Generic((key), char *: true, const char *: true, default: false)
+
+/* Copied `char *` keys are stored with their length in a size_t right
+ * before the characters (DS__KEY_PREFIX), so view lookups compare lengths
+ * first and never walk for the terminator. */
+#define DS__KEY_PREFIX sizeof(size_t)
+void ds__ht_copy_key(struct ds__ht_idxs *table, void *dst, const void *src, size_t key_size, bool is_cstr_key);
+void ds__ht_copy_key_n(struct ds__ht_idxs *table, void *dst, const char *str, size_t len);
+void ds__ht_free_key(struct ds__ht_idxs *table, void *key, bool is_cstr_key);
+
+void ds__ht_free_cstr_keys(void *ht, size_t entry_size, bool reuse);
+
+/* `reuse` keeps an owned key arena's regions for the next inserts */
+#define ds__ht_free_keys(ht, reuse)                              \
+    do {                                                         \
+        if (ds__ht_key_is_cstr((ht)->data[0].key)) {             \
+            ds__ht_free_cstr_keys(ds__ht_view(ht),               \
+                                  sizeof(*(ht)->data), (reuse)); \
+        }                                                        \
+    } while (0)
+
+#define ds__entry_hfn(key)             \
     _Generic((key),                    \
         char *: ds__hash_string,       \
         const char *: ds__hash_string, \
@@ -455,8 +1588,11 @@ void ds__ht_free_cstr_keys(void *ht, size_t entry_size);
     _Generic((key), char *: (key), const char *: (key), default: &(key))
 
 /* shared helpers (hashmap and hashset have identical layout) */
-#define ds__ht_should_resize(ht) \
-    ((ht)->length >= (ht)->table.capacity * DS_HM_LOAD_FACTOR)
+/* also grow a table whose probes got too long, unless it is already sparse */
+#define ds__ht_should_resize(ht)                                 \
+    ((ht)->length >= (ht)->table.capacity * DS_HM_LOAD_FACTOR || \
+     (ds__ht_max_probe(&(ht)->table) > DS_HM_MAX_PROBE &&        \
+      (ht)->length * 4 >= (ht)->table.capacity * DS_HM_LOAD_FACTOR))
 
 #define ds__ht_resize(ht, _k)                                          \
     ds__table_resize(ds__ht_view(ht), sizeof(*(ht)->data), sizeof(_k), \
@@ -469,12 +1605,67 @@ void ds__ht_free_cstr_keys(void *ht, size_t entry_size);
                      ds__entry_hfn(key_expr),                                \
                      ds__ht_fit_capacity((ht)->length))
 
-#define ds__ht_find(ht, _k, slot_p, idx_p)                           \
+#define ds__ht_store_hash(ht, key_expr)                                 \
+    do {                                                                \
+        (ht)->table.flags |= DS__HT_STORE_HASH;                         \
+        if ((ht)->table.capacity && !ds__ht_hashes(&(ht)->table))       \
+            ds__table_resize(ds__ht_view(ht), sizeof(*(ht)->data),      \
+                             sizeof(key_expr), ds__entry_hfn(key_expr), \
+                             (ht)->table.capacity);                     \
+    } while (0)
+
+#define ds__ht_robin_hood(ht, key_expr)                                     \
+    do {                                                                    \
+        if (!((ht)->table.flags & DS__HT_ROBIN_HOOD)) {                     \
+            (ht)->table.flags |= DS__HT_ROBIN_HOOD | DS__HT_STORE_HASH;     \
+            if ((ht)->table.capacity) /* reorder the clusters */            \
+                ds__table_resize(ds__ht_view(ht), sizeof(*(ht)->data),      \
+                                 sizeof(key_expr), ds__entry_hfn(key_expr), \
+                                 (ht)->table.capacity);                     \
+        }                                                                   \
+    } while (0)
+
+#define ds__ht_hash(ht, _k) ds__entry_hfn(_k)(&(_k), sizeof(_k), (ht)->seed)
+
+#define ds__ht_find(ht, _k, _h, slot_p, idx_p)                       \
     ds__table_find(ds__ht_view(ht), sizeof(*(ht)->data), sizeof(_k), \
-                   ds__user_key_ptr(_k),                             \
-                   ds__entry_hfn(_k)(&(_k), sizeof(_k), (ht)->seed), \
+                   ds__user_key_ptr(_k), (_h),                       \
                    ds__entry_eqfn(_k), (slot_p), (idx_p))
 
+/* removals need a regular index: rebuild one if the table is frozen */
+#define ds__ht_thaw(ht, _k)                    \
+    do {                                       \
+        if ((ht)->table.flags & DS__HT_FROZEN) \
+            ds__ht_resize(ht, _k);             \
+    } while (0)
+
+/* grow the index table once so `n` entries fit without a resize */
+#define ds__ht_reserve(ht, n, key_expr)                                        \
+    do {                                                                       \
+        size_t _cap = (ht)->table.capacity ? (ht)->table.capacity              \
+                                           : DS_HM_INIT_CAPACITY;              \
+        while ((size_t)(n) >= _cap * DS_HM_LOAD_FACTOR)                        \
+            _cap <<= 1;                                                        \
+        if (_cap != (ht)->table.capacity)                                      \
+            ds__table_resize(ds__ht_view(ht), sizeof(*(ht)->data),             \
+                             sizeof(key_expr), ds__entry_hfn(key_expr), _cap); \
+        ds_da_reserve((ht), (n));                                              \
+    } while (0)
+
+/* hash keys[_b, _b + _m) into _hs and pull their slots and entries into cache */
+#define ds__ht_prefetch_batch(ht, keys, _b, _m, _hs)                             \
+    do {                                                                         \
+        bool _pf = (ht)->table.capacity >= DS_HM_PREFETCH_MIN_CAPACITY;          \
+        for (size_t _i = 0; _i < (_m); _i++) {                                   \
+            __typeof__((ht)->data[0].key) _pk = (keys)[(_b) + _i];               \
+            (_hs)[_i] = ds__ht_hash(ht, _pk);                                    \
+            if (_pf) ds__table_prefetch(&(ht)->table, (_hs)[_i]);                \
+        }                                                                        \
+        for (size_t _i = 0; _pf && _i < (_m); _i++)                              \
+            DS__PREFETCH(ds__table_entry_guess(ds__ht_view(ht),                  \
+                                               sizeof(*(ht)->data), (_hs)[_i])); \
+    } while (0)
+
 #define ds__ht_remove_slot(ht, _k, slot, idx)                               \
     ds__table_remove_slot(ds__ht_view(ht), sizeof(*(ht)->data), sizeof(_k), \
                           ds__entry_hfn(_k), (slot), (idx))
@@ -494,7 +1685,7 @@ void ds__ht_free_cstr_keys(void *ht, size_t entry_size);
     } *data;              // Dynamic array of key-value pairs
     size_t length;        // Number of elements
     size_t capacity;      // Capacity of data array
-    struct ds__ht_idxs table; // Hash table (stores indices+1 into data array)
+    struct ds__ht_idxs table; // Hash table (control bytes + indices into data array)
     size_t seed;          // Hash seed
  } my_map;
  ```
@@ -516,6 +1707,109 @@ void ds__ht_free_cstr_keys(void *ht, size_t entry_size);
 
 #define ds_hm_declare(name, key_t, val_t) typedef ds_Hm(key_t, val_t) name
 
+/**
+ * Declare a hash map with its own key hash and equality, and generate typed
+ * `static inline` operations for it. Keys are hashed and compared through
+ * the given functions, inlined at the call site instead of the generic
+ * byte-wise hash and memcmp, so struct keys with padding work and integer
+ * or small struct keys cost a few instructions per probe:
+ *   `size_t hash_fn(const key_t *key, size_t seed)`
+ *   `bool eq_fn(const key_t *a, const key_t *b)`
+ * Generated: `name_set(hm, key, value)`, `name_try(hm, key)` (pointer to
+ * the value or NULL), `name_has(hm, key)`, `name_remove(hm, key)` (like
+ * `ds_hm_remove`), `name_freeze(hm)` (like `ds_hm_freeze`) and
+ * `name_stats(hm, out)` (like `ds_hm_stats`). Keys are
+ * stored as they are: strings are not copied, and `ds_hm_clear`/`ds_hm_free`
+ * leave them to the caller.
+ * The other ds_hm_* macros that do not hash (foreach, length, clear, free)
+ * work as usual; set options like `ds_hm_store_hash` before the first insert.
+ * The string view lookups (`ds_hm_try_sv`, `ds_hm_set_sv`) hash like
+ * `ds_hm_set` and must not be used on these maps.
+ * Example:
+ ```c
+ typedef struct { int32_t x, y; } Point;
+ static inline size_t point_hash(const Point *p, size_t seed) {
+     return ds_hash_u64(((uint64_t)(uint32_t)p->x << 32) | (uint32_t)p->y, seed);
+ }
+ static inline bool point_eq(const Point *a, const Point *b) {
+     return a->x == b->x && a->y == b->y;
+ }
+ ds_hm_declare_ex(PointMap, Point, int, point_hash, point_eq);
+
+ PointMap pm = {0};
+ PointMap_set(&pm, (Point){1, 2}, 3);
+ int *v = PointMap_try(&pm, (Point){1, 2});
+ ```
+ */
+#define ds_hm_declare_ex(name, key_t, val_t, hash_fn, eq_fn)                                             \
+    typedef ds_Hm(key_t, val_t) name;                                                                    \
+    static inline size_t name##__entry_hash(const void *entry, size_t key_size, size_t seed) {           \
+        DS_UNUSED(key_size);                                                                             \
+        return hash_fn((const key_t *)entry, seed);                                                      \
+    }                                                                                                    \
+    static inline int name##__entry_eq(const void *entry, const void *key, size_t key_size) {            \
+        DS_UNUSED(key_size);                                                                             \
+        return eq_fn((const key_t *)entry, (const key_t *)key);                                          \
+    }                                                                                                    \
+    static inline bool name##__find(name *hm, const key_t *key, size_t h, size_t *slot, size_t *idx) {   \
+        struct ds__ht *ht = ds__ht_view(hm);                                                             \
+        if (!hm->table.capacity || ds__ht_old(&hm->table) || (hm->table.flags & DS__HT_FROZEN))          \
+            return ds__table_find(ht, sizeof(*hm->data), sizeof(key_t), key, h,                          \
+                                  name##__entry_eq, slot, idx);                                          \
+        bool found = ds__table_probe(ht, &hm->table, sizeof(*hm->data), sizeof(key_t), key, h,           \
+                                     name##__entry_eq, slot, idx);                                       \
+        DS__HT_COUNT(ht, lookups, 1);                                                                    \
+        DS__HT_COUNT(ht, misses, !found);                                                                \
+        return found;                                                                                    \
+    }                                                                                                    \
+    static inline void name##__resize(name *hm) {                                                        \
+        ds__table_resize(ds__ht_view(hm), sizeof(*hm->data), sizeof(key_t), name##__entry_hash,          \
+                         hm->table.capacity == 0 ? DS_HM_INIT_CAPACITY : hm->table.capacity * 2);        \
+    }                                                                                                    \
+    static inline void name##_set(name *hm, key_t key, val_t value) {                                    \
+        hm->table.flags |= DS__HT_BORROWED;                                                              \
+        size_t h = hash_fn(&key, hm->seed);                                                              \
+        if (ds__ht_should_resize(hm)) {                                                                  \
+            size_t seed = hm->seed;                                                                      \
+            name##__resize(hm);                                                                          \
+            if (hm->seed != seed) h = hash_fn(&key, hm->seed);                                           \
+        }                                                                                                \
+        size_t slot = 0, idx;                                                                            \
+        if (name##__find(hm, &key, h, &slot, &idx)) {                                                    \
+            hm->data[idx].value = value;                                                                 \
+            return;                                                                                      \
+        }                                                                                                \
+        __typeof__(*hm->data) entry = {.key = key, .value = value};                                      \
+        ds_da_append(hm, entry);                                                                         \
+        ds__table_insert(&hm->table, slot, h, hm->length - 1);                                           \
+    }                                                                                                    \
+    static inline val_t *name##_try(name *hm, key_t key) {                                               \
+        size_t slot, idx;                                                                                \
+        if (!name##__find(hm, &key, hash_fn(&key, hm->seed), &slot, &idx)) return NULL;                  \
+        return &hm->data[idx].value;                                                                     \
+    }                                                                                                    \
+    static inline bool name##_has(name *hm, key_t key) {                                                 \
+        return name##_try(hm, key) != NULL;                                                              \
+    }                                                                                                    \
+    static inline val_t *name##_remove(name *hm, key_t key) {                                            \
+        size_t slot, idx;                                                                                \
+        if (hm->table.flags & DS__HT_FROZEN) name##__resize(hm);                                         \
+        if (!name##__find(hm, &key, hash_fn(&key, hm->seed), &slot, &idx)) return NULL;                  \
+        __typeof__(*hm->data) tmp = hm->data[idx];                                                       \
+        ds_da_remove_unordered(hm, idx);                                                                 \
+        hm->data[hm->length] = tmp;                                                                      \
+        ds__table_remove_slot(ds__ht_view(hm), sizeof(*hm->data), sizeof(key_t),                         \
+                              name##__entry_hash, slot, idx);                                            \
+        return &hm->data[hm->length].value;                                                              \
+    }                                                                                                    \
+    static inline bool name##_freeze(name *hm) {                                                         \
+        return ds__table_freeze(ds__ht_view(hm), sizeof(*hm->data), sizeof(key_t),                       \
+                                name##__entry_hash);                                                     \
+    }                                                                                                    \
+    static inline void name##_stats(name *hm, DsHmStats *out) {                                          \
+        ds__ht_stats(ds__ht_view(hm), sizeof(*hm->data), sizeof(key_t), false, name##__entry_hash, out); \
+    }
+
 /**
  * Set a key-value pair in the hash map.
  * Example:
@@ -526,23 +1820,60 @@ ds_hm_declare(my_map, int, const char *);
     ds_hm_set(&hm, 42, "Hello");
 ```
  */
-#define ds_hm_set(hm, key_v, val_v)                                              \
-    do {                                                                         \
-        __typeof__((hm)->data[0].key) _k = (key_v);                              \
-        __typeof__((hm)->data[0].value) _v = (val_v);                            \
-        if (ds__ht_should_resize(hm)) ds__ht_resize(hm, _k);                     \
-        size_t _slot, _idx;                                                      \
-        if (ds__ht_find(hm, _k, &_slot, &_idx)) {                                \
-            (hm)->data[_idx].value = _v;                                         \
-        } else {                                                                 \
-            __typeof__(*(hm)->data) _entry = {.value = _v};                      \
-            ds__ht_copy_key(&_entry.key, &_k, sizeof(_k),              \
-                            ds__ht_key_is_cstr(_k));                   \
-            ds_da_append((hm), _entry);                                          \
-            (hm)->table.data[_slot] = (hm)->length;                              \
-        }                                                                        \
+#define ds_hm_set(hm, key_v, val_v)                             \
+    do {                                                        \
+        __typeof__((hm)->data[0].key) _k = (key_v);             \
+        __typeof__((hm)->data[0].value) _v = (val_v);           \
+        ds__hm_set_hashed((hm), _k, _v, ds__ht_hash((hm), _k)); \
+    } while (0)
+
+/* ds_hm_set/try/remove with the key hash computed by the caller */
+#define ds__hm_set_hashed(hm, _k, _v, hash)                              \
+    do {                                                                 \
+        size_t _h = (hash);                                              \
+        if (ds__ht_should_resize(hm)) {                                  \
+            size_t _seed = (hm)->seed;                                   \
+            ds__ht_resize(hm, _k);                                       \
+            if ((hm)->seed != _seed) _h = ds__ht_hash(hm, _k);           \
+        }                                                                \
+        size_t _slot = 0, _idx;                                          \
+        if (ds__ht_find(hm, _k, _h, &_slot, &_idx)) {                    \
+            (hm)->data[_idx].value = _v;                                 \
+        } else {                                                         \
+            __typeof__(*(hm)->data) _entry = {.value = _v};              \
+            ds__ht_copy_key(&(hm)->table, &_entry.key, &_k, sizeof(_k),  \
+                            ds__ht_key_is_cstr(_k));                     \
+            ds_da_append((hm), _entry);                                  \
+            ds__table_insert(&(hm)->table, _slot, _h, (hm)->length - 1); \
+        }                                                                \
     } while (0)
 
+#define ds__hm_try_hashed(hm, _k, hash)            \
+    ({                                             \
+        size_t _slot, _idx;                        \
+        ds__ht_find(hm, _k, (hash), &_slot, &_idx) \
+            ? &(hm)->data[_idx].value              \
+            : NULL;                                \
+    })
+
+#define ds__hm_remove_hashed(hm, _k, hash)                     \
+    ({                                                         \
+        __typeof__(&(hm)->data[0].value) _val = NULL;          \
+        size_t _slot, _idx;                                    \
+        ds__ht_thaw(hm, _k);                                   \
+        if (ds__ht_find(hm, _k, (hash), &_slot, &_idx)) {      \
+            __typeof__((hm)->data[0]) _tmp = (hm)->data[_idx]; \
+            ds__ht_free_key(&(hm)->table, &_tmp.key,           \
+                            ds__ht_key_is_cstr(_tmp.key));     \
+            memset(&_tmp.key, 0, sizeof(_tmp.key));            \
+            ds_da_remove_unordered((hm), _idx);                \
+            (hm)->data[(hm)->length] = _tmp;                   \
+            _val = &(hm)->data[(hm)->length].value;            \
+            ds__ht_remove_slot(hm, _k, _slot, _idx);           \
+        }                                                      \
+        _val;                                                  \
+    })
+
 /**
  * Try to get a value from the hash map.
  * Returns NULL if the key is not found else it returns a pointer to the value.
@@ -554,11 +1885,10 @@ ds_hm_declare(my_map, int, const char *);
     printf("%s\n", *value);
  ```
  */
-#define ds_hm_try(hm, key_v)                                                 \
-    ({                                                                       \
-        __typeof__((hm)->data[0].key) _k = (key_v);                          \
-        size_t _slot, _idx;                                                  \
-        ds__ht_find(hm, _k, &_slot, &_idx) ? &(hm)->data[_idx].value : NULL; \
+#define ds_hm_try(hm, key_v)                                \
+    ({                                                      \
+        __typeof__((hm)->data[0].key) _k = (key_v);         \
+        ds__hm_try_hashed((hm), _k, ds__ht_hash((hm), _k)); \
     })
 
 #define ds_hm_has(hm, key_v) (ds_hm_try((hm), (key_v)) != NULL)
@@ -578,6 +1908,72 @@ ds_hm_declare(my_map, int, const char *);
         _p ? *_p : (__typeof__((hm)->data[0].value)){0};                \
     })
 
+/**
+ * Look up a string-keyed map with a string view (`DsStringIterator`), e.g. a
+ * token from `ds_s_split` or a slice of a parsed buffer, without copying or
+ * NUL-terminating it. Returns a pointer to the value or NULL. The map must
+ * have `char *` keys; other key types fail to compile.
+ * Example:
+ ```c
+ DsStringIterator it = ds_cstr_iter("GET /index.html HTTP/1.1");
+ DsStringIterator method = ds_s_split(&it, ' ');
+ int *handler = ds_hm_try_sv(&routes, method);
+ ```
+ */
+#define ds_hm_try_sv(hm, sv_v)                                         \
+    ({                                                                 \
+        _Static_assert(ds__ht_key_is_cstr((hm)->data[0].key),          \
+                       "string views only look up char * keyed maps"); \
+        assert(!((hm)->table.flags & DS__HT_BORROWED)                  \
+               && "string views need ds_hm_declare keys");             \
+        DsStringIterator _sv = (sv_v);                                 \
+        size_t _slot, _idx;                                            \
+        ds__table_find(ds__ht_view(hm), sizeof(*(hm)->data),           \
+                       sizeof((hm)->data[0].key), &_sv,                \
+                       ds__hash_sv(_sv.data, _sv.length, (hm)->seed),  \
+                       ds__eq_sv, &_slot, &_idx)                       \
+            ? &(hm)->data[_idx].value                                  \
+            : NULL;                                                    \
+    })
+
+#define ds_hm_has_sv(hm, sv_v) (ds_hm_try_sv((hm), (sv_v)) != NULL)
+
+/**
+ * Set a value under a string view key of a string-keyed map. The view is
+ * only copied (and terminated) when the key is new.
+ * Example:
+ ```c
+ DsStringIterator it = ds_cstr_iter("a b a");
+ while (it.length) {
+     DsStringIterator word = ds_s_split(&it, ' ');
+     int *n = ds_hm_try_sv(&counts, word);
+     ds_hm_set_sv(&counts, word, n ? *n + 1 : 1);
+ }
+ ```
+ */
+#define ds_hm_set_sv(hm, sv_v, val_v)                                           \
+    do {                                                                        \
+        _Static_assert(ds__ht_key_is_cstr((hm)->data[0].key),                   \
+                       "string views only key char * keyed maps");              \
+        assert(!((hm)->table.flags & DS__HT_BORROWED)                           \
+               && "string views need ds_hm_declare keys");                      \
+        DsStringIterator _sv = (sv_v);                                          \
+        __typeof__((hm)->data[0].value) _v = (val_v);                           \
+        if (ds__ht_should_resize(hm)) ds__ht_resize(hm, (hm)->data[0].key);     \
+        size_t _h = ds__hash_sv(_sv.data, _sv.length, (hm)->seed);              \
+        size_t _slot = 0, _idx;                                                 \
+        if (ds__table_find(ds__ht_view(hm), sizeof(*(hm)->data),                \
+                           sizeof((hm)->data[0].key), &_sv, _h,                 \
+                           ds__eq_sv, &_slot, &_idx)) {                         \
+            (hm)->data[_idx].value = _v;                                        \
+        } else {                                                                \
+            __typeof__(*(hm)->data) _entry = {.value = _v};                     \
+            ds__ht_copy_key_n(&(hm)->table, &_entry.key, _sv.data, _sv.length); \
+            ds_da_append((hm), _entry);                                         \
+            ds__table_insert(&(hm)->table, _slot, _h, (hm)->length - 1);        \
+        }                                                                       \
+    } while (0)
+
 /**
  * Remove a value from the hash map and return a pointer to it, or NULL if not found.
  * Example:
@@ -588,21 +1984,118 @@ ds_hm_declare(my_map, int, const char *);
 #define ds_hm_remove(hm, key_v)                                \
     ({                                                         \
         __typeof__((hm)->data[0].key) _k = (key_v);            \
-        __typeof__(&(hm)->data[0].value) _val = NULL;          \
-        size_t _slot, _idx;                                    \
-        if (ds__ht_find(hm, _k, &_slot, &_idx)) {              \
-            __typeof__((hm)->data[0]) _tmp = (hm)->data[_idx]; \
-            ds__ht_free_key(&_tmp.key,                                \
-                            ds__ht_key_is_cstr(_tmp.key));             \
-            memset(&_tmp.key, 0, sizeof(_tmp.key));            \
-            ds_da_remove_unordered((hm), _idx);                \
-            (hm)->data[(hm)->length] = _tmp;                   \
-            _val = &(hm)->data[(hm)->length].value;            \
-            ds__ht_remove_slot(hm, _k, _slot, _idx);           \
-        }                                                      \
-        _val;                                                  \
+        ds__hm_remove_hashed((hm), _k, ds__ht_hash((hm), _k)); \
+    })
+
+/**
+ * Look up `n` keys at once, storing a pointer to each value (or NULL) in
+ * `out`. Keys are hashed and their slots prefetched DS_HM_BATCH at a time
+ * before any is resolved, so large tables pay one memory round trip per
+ * batch instead of one per key. Returns the number of keys found.
+ * Example:
+ ```c
+ int keys[] = {1, 2, 3};
+ const char **vals[3];
+ size_t found = ds_hm_try_many(&hm, keys, 3, vals);
+ ```
+ */
+#define ds_hm_try_many(hm, keys, n, out)                               \
+    ({                                                                 \
+        size_t _found = 0, _n = (n);                                   \
+        size_t _hs[DS_HM_BATCH];                                       \
+        for (size_t _b = 0; _b < _n; _b += DS_HM_BATCH) {              \
+            size_t _m = _n - _b < DS_HM_BATCH ? _n - _b : DS_HM_BATCH; \
+            ds__ht_prefetch_batch(hm, keys, _b, _m, _hs);              \
+            for (size_t _j = 0; _j < _m; _j++) {                       \
+                __typeof__((hm)->data[0].key) _k = (keys)[_b + _j];    \
+                (out)[_b + _j] = ds__hm_try_hashed(hm, _k, _hs[_j]);   \
+                _found += (out)[_b + _j] != NULL;                      \
+            }                                                          \
+        }                                                              \
+        _found;                                                        \
+    })
+
+/**
+ * Like `ds_hm_try_many` but copies the values into `out`, {0} for the keys
+ * that are not found. Returns the number of keys found.
+ */
+#define ds_hm_get_many(hm, keys, n, out)                                    \
+    ({                                                                      \
+        size_t _found = 0, _n = (n);                                        \
+        size_t _hs[DS_HM_BATCH];                                            \
+        for (size_t _b = 0; _b < _n; _b += DS_HM_BATCH) {                   \
+            size_t _m = _n - _b < DS_HM_BATCH ? _n - _b : DS_HM_BATCH;      \
+            ds__ht_prefetch_batch(hm, keys, _b, _m, _hs);                   \
+            for (size_t _j = 0; _j < _m; _j++) {                            \
+                __typeof__((hm)->data[0].key) _k = (keys)[_b + _j];         \
+                __typeof__(&(hm)->data[0].value) _p =                       \
+                    ds__hm_try_hashed(hm, _k, _hs[_j]);                     \
+                (out)[_b + _j] = _p ? *_p                                   \
+                                    : (__typeof__((hm)->data[0].value)){0}; \
+                _found += _p != NULL;                                       \
+            }                                                               \
+        }                                                                   \
+        _found;                                                             \
     })
 
+/**
+ * Set `n` key-value pairs at once, `keys[i]` to `vals[i]`. The table is
+ * grown once up front, then keys are hashed and prefetched in batches like
+ * `ds_hm_try_many`.
+ * Example:
+ ```c
+ int keys[] = {1, 2, 3};
+ const char *vals[] = {"a", "b", "c"};
+ ds_hm_set_many(&hm, keys, vals, 3);
+ ```
+ */
+#define ds_hm_set_many(hm, keys, vals, n)                                      \
+    do {                                                                       \
+        size_t _n = (n);                                                       \
+        size_t _hs[DS_HM_BATCH];                                               \
+        ds__ht_reserve(hm, (hm)->length + _n, (hm)->data[0].key);              \
+        for (size_t _b = 0; _b < _n; _b += DS_HM_BATCH) {                      \
+            size_t _m = _n - _b < DS_HM_BATCH ? _n - _b : DS_HM_BATCH;         \
+            ds__ht_prefetch_batch(hm, keys, _b, _m, _hs);                      \
+            size_t _seed = (hm)->seed;                                         \
+            for (size_t _j = 0; _j < _m; _j++) {                               \
+                __typeof__((hm)->data[0].key) _sk = (keys)[_b + _j];           \
+                __typeof__((hm)->data[0].value) _sv = (vals)[_b + _j];         \
+                /* a reseeding resize makes the batch hashes stale */          \
+                ds__hm_set_hashed(hm, _sk, _sv,                                \
+                                  (hm)->seed == _seed ? _hs[_j]                \
+                                                      : ds__ht_hash(hm, _sk)); \
+            }                                                                  \
+        }                                                                      \
+    } while (0)
+
+/**
+ * Reserve room for `n` entries in total, so that many inserts trigger no
+ * resize.
+ */
+#define ds_hm_reserve(hm, n) ds__ht_reserve((hm), (n), (hm)->data[0].key)
+
+/**
+ * Turn a map that will only be read from now on into a minimal perfect
+ * hash table: every lookup is one displacement load, one entry load and
+ * one key compare, and the index shrinks to about one byte per entry
+ * (4 bytes per DS_HM_FREEZE_BUCKET entries). The data array is reordered
+ * in place, so `ds_hm_foreach` keeps working.
+ * Any later set or remove thaws the map back to a regular index.
+ * Returns false, leaving the map as it was, if it is empty or two keys
+ * have the same full hash.
+ * Example:
+ ```c
+ ds_hm_set(&keywords, "if", TOK_IF);
+ ...
+ ds_hm_freeze(&keywords);
+ ```
+ */
+#define ds_hm_freeze(hm)                                   \
+    ds__table_freeze(ds__ht_view(hm), sizeof(*(hm)->data), \
+                     sizeof((hm)->data[0].key),            \
+                     ds__entry_hfn((hm)->data[0].key))
+
 /**
  * Loop over all key-value pairs in the hash map.
  * Example:
@@ -618,16 +2111,157 @@ ds_hm_foreach(&hm, kv) {
  * Free the hash map.
  * It will not free the keys or values themselves.
  * You should free the keys and values separately if needed.
+ * A map loaded with `ds_hm_map` is unmapped.
  */
-#define ds_hm_free(hm)             \
-    do {                           \
-        DS_FREE((hm)->table.data); \
-        ds__ht_free_keys((hm));    \
-        (hm)->table.data = NULL;   \
-        (hm)->table.capacity = 0;  \
-        ds_da_free((hm));          \
+#define ds_hm_free(hm)                           \
+    do {                                         \
+        if ((hm)->table.flags & DS__HT_MAPPED) { \
+            ds__hm_unmap(ds__ht_view(hm));       \
+        } else {                                 \
+            ds__ht_free_keys((hm), false);       \
+            ds__table_free(&(hm)->table);        \
+            ds_da_free((hm));                    \
+        }                                        \
+    } while (0)
+
+/**
+ * Write the map to `path` as an image that `ds_hm_map` can serve lookups
+ * from without parsing: the entries, the index table, the seed and the
+ * `char *` keys, laid out so it works at any address. Keys and values are
+ * written as they are, so they must not hold pointers (string keys
+ * excepted). The image is tied to the key and value types, the hash
+ * functions and `sizeof(size_t)`. It is written to `path`.tmp and renamed
+ * over `path`, so processes that mapped the previous image keep it.
+ * Returns false (and logs) on I/O errors.
+ * Example:
+ ```c
+ StrIntMap hm = {0};
+ ... // build it once
+ ds_hm_freeze(&hm); // optional: smaller index, one probe per lookup
+ ds_hm_save(&hm, "ids.dshm");
+ ```
+ */
+#define ds_hm_save(hm, path)                                                      \
+    ds__hm_save(ds__ht_view(hm), sizeof(*(hm)->data),                             \
+                sizeof((hm)->data[0].key), ds__ht_key_is_cstr((hm)->data[0].key), \
+                ds__entry_hfn((hm)->data[0].key), (path))
+
+/**
+ * Map an image written by `ds_hm_save` into an empty map, read-only.
+ * Nothing is parsed or copied: pages are loaded on first touch and shared
+ * between the processes mapping the same file. `ds_hm_try`, `ds_hm_get`,
+ * `ds_hm_has`, the `_sv` and `_many` lookups, `ds_hm_foreach` and
+ * `length` work; the map must not be modified, and values must not be
+ * written through the returned pointers. With `char *` keys use
+ * `ds_hm_str_key` to read the key of an entry. `ds_hm_free` unmaps it.
+ * Returns false (and logs) if the file is missing or was saved from a
+ * different map type or configuration.
+ * Example:
+ ```c
+ StrIntMap ids = {0};
+ if (ds_hm_map(&ids, "ids.dshm")) {
+     int *id = ds_hm_try(&ids, "alice");
+     ...
+     ds_hm_free(&ids);
+ }
+ ```
+ */
+#define ds_hm_map(hm, path)                                                      \
+    ds__hm_map(ds__ht_view(hm), sizeof(*(hm)->data),                             \
+               sizeof((hm)->data[0].key), ds__ht_key_is_cstr((hm)->data[0].key), \
+               ds__entry_hfn((hm)->data[0].key), (path))
+
+/**
+ * The `char *` key of entry `kv` of a string-keyed map, mapped or not.
+ */
+#define ds_hm_str_key(hm, kv)          \
+    ((hm)->table.flags & DS__HT_MAPPED \
+         ? ds__mapped_str(kv)          \
+         : (const char *)(kv)->key)
+
+/**
+ * Remove every entry but keep the allocated memory (entries, index table
+ * and key arena) for the next inserts. Use `ds_hm_free` to release it.
+ */
+#define ds_hm_clear(hm)                \
+    do {                               \
+        ds__table_clear(&(hm)->table); \
+        ds__ht_free_keys((hm), true);  \
+        (hm)->length = 0;              \
+    } while (0)
+
+/**
+ * Keep the full hash of every entry next to the index table, so resizes and
+ * removals never hash keys again (string keys are never re-walked).
+ * Costs one `size_t` per table slot. It can be enabled at any time, also for
+ * every map and set at once by defining DS_HM_STORE_HASH.
+ * Example:
+ ```c
+ StrIntMap hm = {0};
+ ds_hm_store_hash(&hm);
+ ```
+ */
+#define ds_hm_store_hash(hm) ds__ht_store_hash((hm), (hm)->data[0].key)
+
+/**
+ * Resize the map incrementally: when it grows, the old index table is kept
+ * next to the new one and every following set/get/remove migrates up to
+ * DS_HM_MIGRATE_STEP of its slots, so no single insert pays for a full
+ * rebuild. Lookups consult both tables until the old one is drained.
+ * Implies `ds_hm_store_hash`. Enable it for every map and set by defining
+ * DS_HM_INCREMENTAL_RESIZE.
+ */
+#define ds_hm_incremental_resize(hm)                \
+    do {                                            \
+        (hm)->table.flags |= DS__HT_INCREMENTAL;    \
+        ds__ht_store_hash((hm), (hm)->data[0].key); \
+    } while (0)
+
+/**
+ * Keep every probe cluster ordered by home slot (Robin Hood): inserts
+ * displace entries that are closer to their home, so probe lengths stay
+ * short and even, and lookups for missing keys stop after about one
+ * control group instead of scanning to the next empty slot. The longest
+ * probe is tracked; past DS_HM_MAX_PROBE the table grows and picks a new
+ * `seed` on the next insert. Inserts and removals do a bit more work.
+ * Implies `ds_hm_store_hash`. Enable it for every map and set by defining
+ * DS_HM_ROBIN_HOOD.
+ * Example:
+ ```c
+ IntSet seen = {0};
+ ds_hs_robin_hood(&seen);
+ ```
+ */
+#define ds_hm_robin_hood(hm) ds__ht_robin_hood((hm), (hm)->data[0].key)
+
+/**
+ * Bump-allocate copied `char *` keys from an arena instead of one DS_ALLOC
+ * per key. Removed keys are reclaimed only by `ds_hm_clear`/`ds_hm_free`.
+ * With `arena` NULL the map owns its arena: `ds_hm_free` releases it in one
+ * pass over its regions and `ds_hm_clear` rewinds it for reuse. A caller
+ * arena is left alone by both, `ds_hm_free` only detaches it; the keys stay
+ * valid until it is freed.
+ * Must be set while the map is empty.
+ * Example:
+ ```c
+ StrIntMap hm = {0};
+ ds_hm_key_arena(&hm, NULL);
+ ds_hm_set(&hm, "key", 1); // key copied into the map's arena
+ ```
+ */
+#define ds_hm_key_arena(hm, arena)                               \
+    do {                                                         \
+        assert((hm)->length == 0);                               \
+        DsArena *_arena = (arena);                               \
+        struct ds__ht_extra *_x = ds__table_extra(&(hm)->table); \
+        if ((hm)->table.flags & DS__HT_OWN_KEYS) {               \
+            if (_x->keys) ds_a_free(_x->keys);                   \
+            DS_FREE(_x->keys);                                   \
+        }                                                        \
+        _x->keys = _arena;                                       \
+        (hm)->table.flags &= ~DS__HT_OWN_KEYS;                   \
+        if (!_arena) (hm)->table.flags |= DS__HT_OWN_KEYS;       \
     } while (0)
-#define ds_hm_clear ds_hm_free
 
 /**
  * Shrink the hash map's allocated memory to fit the current length.
@@ -645,6 +2279,65 @@ ds_hm_foreach(&hm, kv) {
         }                                                                   \
     } while (0)
 
+/**
+ * Shape and cost of a hash map or set, filled by `ds_hm_stats`.
+ * An entry's displacement is how far it sits from its home slot (the slot
+ * its hash picks); a lookup scans displacement / DS__GROUP_WIDTH + 1 groups
+ * of control bytes to reach it. Long tails in `probe_hist` or a high
+ * `max_displacement` at a normal load factor point at a weak hash; a low
+ * load factor at a high `index_bytes` at an oversized table.
+ */
+typedef struct DsHmStats {
+    size_t length;
+    size_t slots;                        /* index slots, or buckets once frozen */
+    double load_factor;                  /* length / slots */
+    size_t probe_hist[DS_HM_STATS_HIST]; /* entries by groups scanned to reach them, the last bucket open */
+    size_t max_displacement;             /* in slots */
+    double mean_displacement;
+    size_t index_bytes;                  /* slot indices, control bytes, stored hashes, Bloom filter */
+    size_t entry_bytes;                  /* the entry array, at its capacity */
+    size_t key_bytes;                    /* copied `char *` keys, or their arena */
+    size_t resizes;                      /* index rebuilds since the map was created or freed */
+    size_t lookups;                      /* key searches (get, set, remove), DS_HM_STATS only */
+    size_t misses;                       /* searches that found nothing, DS_HM_STATS only */
+    size_t probes;                       /* control byte groups scanned, DS_HM_STATS only */
+    bool frozen;
+} DsHmStats;
+
+void ds__ht_stats(const struct ds__ht *ht, size_t entry_size, size_t key_size, bool cstr_keys, ds_entry_hash_fn hash_fn, DsHmStats *out);
+
+/**
+ * Fill `out` with the map's load factor, probe length histogram,
+ * displacements, memory use and resize count, see `DsHmStats`. It walks
+ * the whole index (hashing every key unless hashes are stored), so call it
+ * for diagnostics, not per operation.
+ * Define DS_HM_STATS (in every translation unit including ds.h) to also
+ * count each map's lookups, misses and scanned groups; without it those
+ * stay 0 and lookups pay nothing. `ds_hm_stats_json` writes the result as
+ * JSON.
+ * Example:
+ ```c
+ DsHmStats st;
+ ds_hm_stats(&hm, &st);
+ printf("load %.2f, max displacement %zu, %zu resizes\n", st.load_factor, st.max_displacement, st.resizes);
+ ```
+ */
+#define ds_hm_stats(hm, out)                                                      \
+    ds__ht_stats(ds__ht_view(hm), sizeof(*(hm)->data), sizeof((hm)->data[0].key), \
+                 ds__ht_key_is_cstr((hm)->data[0].key), ds__entry_hfn((hm)->data[0].key), (out))
+
+/**
+ * Append `st` to `out` as a compact JSON object, e.g. for a metrics endpoint.
+ * Example:
+ ```c
+ DsString json = {0};
+ ds_hm_stats_json(&json, &st);
+ printf("%.*s\n", (int)json.length, json.data);
+ ds_da_free(&json);
+ ```
+ */
+void ds_hm_stats_json(DsString *out, const DsHmStats *st);
+
 /**
  * Declare an hash set.
  * Example:
@@ -656,7 +2349,7 @@ ds_hm_foreach(&hm, kv) {
     val_t *data;              // Dynamic array of values
     size_t length;            // Number of elements
     size_t capacity;          // Capacity of data array
-    struct ds__ht_idxs table; // Hash table (stores indices+1 into data array)
+    struct ds__ht_idxs table; // Hash table (control bytes + indices into data array)
     size_t seed;              // Hash seed
  } my_set;
  ```
@@ -685,11 +2378,13 @@ ds_hm_foreach(&hm, kv) {
     printf("%s\n", has ? "found" : "not found");
  ```
  */
-#define ds_hs_has(set, val_v)                  \
-    ({                                         \
-        __typeof__(*(set)->data) _k = (val_v); \
-        size_t _slot, _idx;                    \
-        ds__ht_find(set, _k, &_slot, &_idx);   \
+#define ds_hs_has(set, val_v)                           \
+    ({                                                  \
+        __typeof__(*(set)->data) _k = (val_v);          \
+        size_t _slot, _idx, _h = ds__ht_hash(set, _k);  \
+        DsBloom *_bf = ds__ht_bloom(&(set)->table);     \
+        (!_bf || ds_bloom_has_hash(_bf, _h))            \
+            && ds__ht_find(set, _k, _h, &_slot, &_idx); \
     })
 
 /**
@@ -706,10 +2401,12 @@ ds_hs_declare(my_set, int);
     do {                                                       \
         __typeof__(*(set)->data) _k = (val_v);                 \
         if (ds__ht_should_resize(set)) ds__ht_resize(set, _k); \
-        size_t _slot, _idx;                                    \
-        if (!ds__ht_find(set, _k, &_slot, &_idx)) {            \
+        size_t _h = ds__ht_hash(set, _k);                      \
+        size_t _slot = 0, _idx;                                \
+        if (!ds__ht_find(set, _k, _h, &_slot, &_idx)) {        \
             ds_da_append((set), _k);                           \
-            (set)->table.data[_slot] = (set)->length;          \
+            ds__table_insert(&(set)->table, _slot, _h,         \
+                             (set)->length - 1);               \
         }                                                      \
     } while (0)
 
@@ -720,16 +2417,19 @@ ds_hs_declare(my_set, int);
  bool has = ds_hs_remove(&hm, 42);
  ```
  */
-#define ds_hs_remove(set, val_v)                           \
-    ({                                                     \
-        __typeof__(*(set)->data) _k = (val_v);             \
-        size_t _slot, _idx;                                \
-        bool _found = ds__ht_find(set, _k, &_slot, &_idx); \
-        if (_found) {                                      \
-            ds_da_remove_unordered((set), _idx);           \
-            ds__ht_remove_slot(set, _k, _slot, _idx);      \
-        }                                                  \
-        _found;                                            \
+#define ds_hs_remove(set, val_v)                        \
+    ({                                                  \
+        __typeof__(*(set)->data) _k = (val_v);          \
+        size_t _slot, _idx;                             \
+        ds__ht_thaw(set, _k);                           \
+        bool _found = ds__ht_find(set, _k,              \
+                                  ds__ht_hash(set, _k), \
+                                  &_slot, &_idx);       \
+        if (_found) {                                   \
+            ds_da_remove_unordered((set), _idx);        \
+            ds__ht_remove_slot(set, _k, _slot, _idx);   \
+        }                                               \
+        _found;                                         \
     })
 
 /**
@@ -743,14 +2443,25 @@ ds_hs_foreach(&set, value) {
  */
 #define ds_hs_foreach ds_da_foreach
 
+/* element size, hash, equality and string flag of a set, for the bulk
+ * operations; the pointer compare rejects sets of another type */
+#define ds__hs_args(set, hs2)                                         \
+    ((void)sizeof((set)->data == (hs2)->data), sizeof(*(set)->data)), \
+        ds__entry_hfn(*(set)->data), ds__entry_eqfn(*(set)->data),    \
+        ds__ht_key_is_cstr(*(set)->data)
+
 /**
- * Concatenate the second hash set into the first one.
+ * Concatenate the second hash set into the first one (union).
+ * The first set is grown once for both, and the values of the second are
+ * hashed and prefetched DS_HM_BATCH at a time before they are inserted.
  */
-#define ds_hs_cat(set, hs2)        \
-    do {                           \
-        ds_hs_foreach((hs2), _v) { \
-            ds_hs_add((set), *_v); \
-        }                          \
+#define ds_hs_cat(set, hs2)                                                        \
+    do {                                                                           \
+        if ((hs2)->length) {                                                       \
+            ds__ht_thaw((set), *(set)->data);                                      \
+            ds__ht_reserve((set), (set)->length + (hs2)->length, *(set)->data);    \
+            ds__hs_cat(ds__ht_view(set), ds__ht_view(hs2), ds__hs_args(set, hs2)); \
+        }                                                                          \
     } while (0)
 
 /**
@@ -764,14 +2475,35 @@ ds_hs_foreach(&set, value) {
     } while (0)
 
 /**
- * Remove the elements of the second hash set from the first one.
+ * Remove the elements of the second hash set from the first one
+ * (difference). A few removals are looked up in batches and removed one by
+ * one; many are found by walking the smaller of the two sets, then the
+ * first set is compacted and its index rebuilt in one pass. Walks of at
+ * least DS_HS_PARALLEL_MIN values run on DS_HS_THREADS threads.
  */
-#define ds_hs_sub(set, hs2)           \
-    do {                              \
-        ds_hs_foreach((hs2), _v) {    \
-            ds_hs_remove((set), *_v); \
-        }                             \
-    } while (0)
+#define ds_hs_sub(set, hs2) \
+    ds__hs_sub(ds__ht_view(set), ds__ht_view(hs2), ds__hs_args(set, hs2))
+
+/**
+ * Keep only the elements of the first hash set that are also in the
+ * second one (intersection). Walks the smaller set and looks its values up
+ * in the other in prefetched batches, on DS_HS_THREADS threads for at least
+ * DS_HS_PARALLEL_MIN values; the first set is then compacted in place,
+ * keeping the order of what is left.
+ * Example:
+ ```c
+ ds_hs_intersect(&visitors_today, &visitors_yesterday); // returning visitors
+ ```
+ */
+#define ds_hs_intersect(set, hs2) \
+    ds__hs_intersect(ds__ht_view(set), ds__ht_view(hs2), ds__hs_args(set, hs2))
+
+/**
+ * Number of elements two hash sets have in common, without modifying them.
+ * Same lookups as `ds_hs_intersect`.
+ */
+#define ds_hs_intersect_count(set, hs2) \
+    ds__hs_intersect_count(ds__ht_view(set), ds__ht_view(hs2), ds__hs_args(set, hs2))
 
 /**
  * Remove the elements of a dynamic array from a hash set.
@@ -799,14 +2531,53 @@ ds_hs_foreach(&set, value) {
  * It will not free the keys or values themselves.
  * You should free the keys and values separately if needed.
  */
-#define ds_hs_free(set)             \
-    do {                            \
-        DS_FREE((set)->table.data); \
-        (set)->table.data = NULL;   \
-        (set)->table.capacity = 0;  \
-        ds_da_free((set));          \
+#define ds_hs_free(set)                \
+    do {                               \
+        ds__table_free(&(set)->table); \
+        ds_da_free((set));             \
+    } while (0)
+
+/**
+ * Remove every value but keep the allocated memory, see `ds_hm_clear`.
+ */
+#define ds_hs_clear(set)                \
+    do {                                \
+        ds__table_clear(&(set)->table); \
+        (set)->length = 0;              \
+    } while (0)
+
+/**
+ * Keep the full hash of every value, see `ds_hm_store_hash`.
+ */
+#define ds_hs_store_hash(set) ds__ht_store_hash((set), *(set)->data)
+
+/**
+ * Freeze a set that will only be read from now on, see `ds_hm_freeze`.
+ */
+#define ds_hs_freeze(set)                                                          \
+    ds__table_freeze(ds__ht_view(set), sizeof(*(set)->data), sizeof(*(set)->data), \
+                     ds__entry_hfn(*(set)->data))
+
+/**
+ * Fill `out` with the set's index statistics, see `ds_hm_stats`.
+ */
+#define ds_hs_stats(set, out)                                                  \
+    ds__ht_stats(ds__ht_view(set), sizeof(*(set)->data), sizeof(*(set)->data), \
+                 ds__ht_key_is_cstr(*(set)->data), ds__entry_hfn(*(set)->data), (out))
+
+/**
+ * Robin Hood probing for the set, see `ds_hm_robin_hood`.
+ */
+#define ds_hs_robin_hood(set) ds__ht_robin_hood((set), *(set)->data)
+
+/**
+ * Resize the set incrementally, see `ds_hm_incremental_resize`.
+ */
+#define ds_hs_incremental_resize(set)             \
+    do {                                          \
+        (set)->table.flags |= DS__HT_INCREMENTAL; \
+        ds__ht_store_hash((set), *(set)->data);   \
     } while (0)
-#define ds_hs_clear ds_hs_free
 
 /**
  * Convert a dynamic array to a hash set.
@@ -836,37 +2607,1099 @@ ds_hs_foreach(&set, value) {
     } while (0)
 
 /**
- * Iterates array map and sets
+ * Put a Bloom filter (`DsBloom`) with false positive rate `fpp` in front of
+ * the set: `ds_hs_has` tests it first, so most lookups of absent values
+ * cost one cache line instead of a probe sequence and an entry compare.
+ * Worth it when most lookups miss and the set is larger than the cache;
+ * every add also sets the value's bits. The filter is sized with the index
+ * and rebuilt when it grows, so it stays near `fpp`; removed values keep
+ * their bits until then. Can be called at any time; `ds_hs_free` (and
+ * `ds_hs_shrink` of an empty set) releases it.
+ * Example:
+ ```c
+ StrSet seen = {0};
+ ds_hs_bloom(&seen, 0.01);
+ ...
+ if (!ds_hs_has(&seen, url)) ds_hs_add(&seen, url);
+ ```
  */
-#define ds_foreach ds_da_foreach
-#define ds_foreach_idx ds_da_foreach_idx
+#define ds_hs_bloom(set, fpp)                                                     \
+    ds__table_bloom(ds__ht_view(set), sizeof(*(set)->data), sizeof(*(set)->data), \
+                    ds__entry_hfn(*(set)->data), (fpp))
 
+#ifndef DS_CACHE_LINE
+#define DS_CACHE_LINE 64
+#endif
+
+#ifdef DS_CHM
 /**
- * Declare a linked list.
- * The linked list will store elements of the specified type.
+ * Concurrent hash map.
+ * Keys are spread over DS_CHM_SHARDS independent `ds_Hm` shards, each with
+ * its own reader-writer lock on its own cache line, so threads touching
+ * different keys rarely contend and readers of the same shard run in
+ * parallel. Values are returned by copy: a pointer into a shard would not
+ * survive the lock being released.
+ * The map must be initialized with `ds_chm_init` and freed with `ds_chm_free`.
+ * Opt-in: define DS_CHM before including ds.h. It is built on POSIX
+ * reader-writer locks (SRW locks on Windows), so compile with `-pthread` and
+ * a POSIX feature level (a gnu dialect, or `_POSIX_C_SOURCE` 200809L).
  * Example:
- * `ds_ll_declare(my_list, int);`
- *
- * This will create a linked list type called `my_list` that stores `int` values like this:
-```c
-typedef struct my_list_Node {
-    int val;
-    struct my_list_Node *next;
-} my_list_Node;
-
-typedef struct {
-    my_list_Node *head;
-    my_list_Node *tail;
-    size_t size;
-} my_list;
-```
+ ```c
+ ds_chm_declare(Sessions, int, const char *);
+ ...
+    Sessions s;
+    ds_chm_init(&s);
+    ds_chm_set(&s, 42, "Hello"); // from any thread
+    const char *v = ds_chm_get(&s, 42);
+    ds_chm_free(&s);
+ ```
  */
-#define ds_ll_declare(name, type) \
-    typedef struct name##_Node {  \
-        type val;                 \
-        struct name##_Node *next; \
-    } name##_Node;                \
-    typedef struct {              \
+#ifndef DS_CHM_SHARDS
+#define DS_CHM_SHARDS 64 // must be a power of 2
+#endif
+
+#ifdef _WIN32
+typedef SRWLOCK ds__rwlock;
+#define ds__rwlock_init(l) InitializeSRWLock(l)
+#define ds__rwlock_destroy(l) ((void)(l))
+#define ds__rwlock_rdlock(l) AcquireSRWLockShared(l)
+#define ds__rwlock_wrlock(l) AcquireSRWLockExclusive(l)
+#define ds__rwlock_rdunlock(l) ReleaseSRWLockShared(l)
+#define ds__rwlock_wrunlock(l) ReleaseSRWLockExclusive(l)
+#else
+#include <pthread.h>
+typedef pthread_rwlock_t ds__rwlock;
+#define ds__rwlock_init(l) pthread_rwlock_init((l), NULL)
+#define ds__rwlock_destroy(l) pthread_rwlock_destroy(l)
+#define ds__rwlock_rdlock(l) pthread_rwlock_rdlock(l)
+#define ds__rwlock_wrlock(l) pthread_rwlock_wrlock(l)
+#define ds__rwlock_rdunlock(l) pthread_rwlock_unlock(l)
+#define ds__rwlock_wrunlock(l) pthread_rwlock_unlock(l)
+#endif
+
+#define ds_Chm(key_t, val_t)                         \
+    struct {                                         \
+        struct {                                     \
+            _Alignas(DS_CACHE_LINE) ds__rwlock lock; \
+            ds_Hm(key_t, val_t) map;                 \
+        } shards[DS_CHM_SHARDS];                     \
+    }
+
+#define ds_chm_declare(name, key_t, val_t) typedef ds_Chm(key_t, val_t) name
+
+/* shard from the upper half of the hash: the low bits pick the slot */
+#define ds__chm_hash(chm, _k) ds__ht_hash(&(chm)->shards[0].map, _k)
+#define ds__chm_shard(chm, h) \
+    (&(chm)->shards[((h) >> (sizeof(size_t) * 4)) & (DS_CHM_SHARDS - 1)])
+
+/* Lookups mutate a shard that is draining an incremental resize, so they
+ * take the write lock until the old table is gone. */
+#define ds__chm_read_lock(s, _w)             \
+    do {                                     \
+        ds__rwlock_rdlock(&(s)->lock);       \
+        _w = false;                          \
+        if (ds__ht_old(&(s)->map.table)) {   \
+            ds__rwlock_rdunlock(&(s)->lock); \
+            ds__rwlock_wrlock(&(s)->lock);   \
+            _w = true;                       \
+        }                                    \
+    } while (0)
+
+#define ds__chm_read_unlock(s, _w)               \
+    do {                                         \
+        if (_w) ds__rwlock_wrunlock(&(s)->lock); \
+        else ds__rwlock_rdunlock(&(s)->lock);    \
+    } while (0)
+
+/**
+ * Initialize a concurrent map. Not thread safe.
+ */
+#define ds_chm_init(chm)                                          \
+    do {                                                          \
+        memset((chm), 0, sizeof(*(chm)));                         \
+        for (size_t _i = 0; _i < DS_CHM_SHARDS; _i++) {           \
+            ds__rwlock_init(&(chm)->shards[_i].lock);             \
+            (chm)->shards[_i].map.table.flags = DS__HT_KEEP_SEED; \
+        }                                                         \
+    } while (0)
+
+/**
+ * Set a key-value pair in the concurrent map.
+ */
+#define ds_chm_set(chm, key_v, val_v)                                 \
+    do {                                                              \
+        __typeof__((chm)->shards[0].map.data[0].key) _ck = (key_v);   \
+        __typeof__((chm)->shards[0].map.data[0].value) _cv = (val_v); \
+        size_t _ch = ds__chm_hash(chm, _ck);                          \
+        __typeof__(&(chm)->shards[0]) _s = ds__chm_shard(chm, _ch);   \
+        ds__rwlock_wrlock(&_s->lock);                                 \
+        ds__hm_set_hashed(&_s->map, _ck, _cv, _ch);                   \
+        ds__rwlock_wrunlock(&_s->lock);                               \
+    } while (0)
+
+/**
+ * Copy the value of a key into `*out_p` (when not NULL).
+ * Returns true if the key was found.
+ * Example:
+ ```c
+ const char *v;
+ if (ds_chm_try_get(&s, 42, &v)) printf("%s\n", v);
+ ```
+ */
+#define ds_chm_try_get(chm, key_v, out_p)                               \
+    ({                                                                  \
+        __typeof__((chm)->shards[0].map.data[0].key) _ck = (key_v);     \
+        __typeof__((chm)->shards[0].map.data[0].value) *_out = (out_p); \
+        size_t _ch = ds__chm_hash(chm, _ck);                            \
+        __typeof__(&(chm)->shards[0]) _s = ds__chm_shard(chm, _ch);     \
+        bool _w;                                                        \
+        ds__chm_read_lock(_s, _w);                                      \
+        __typeof__(_out) _p = ds__hm_try_hashed(&_s->map, _ck, _ch);    \
+        if (_p && _out) *_out = *_p;                                    \
+        ds__chm_read_unlock(_s, _w);                                    \
+        _p != NULL;                                                     \
+    })
+
+#define ds_chm_has(chm, key_v) ds_chm_try_get((chm), (key_v), NULL)
+
+/**
+ * Get a copy of the value of a key, or {0} if it is not found.
+ */
+#define ds_chm_get(chm, key_v)                                    \
+    ({                                                            \
+        __typeof__((chm)->shards[0].map.data[0].value) _gv = {0}; \
+        ds_chm_try_get((chm), (key_v), &_gv);                     \
+        _gv;                                                      \
+    })
+
+/**
+ * Remove a key from the concurrent map, copying its value into `*out_p`
+ * (when not NULL). Returns true if the key was found.
+ */
+#define ds_chm_remove(chm, key_v, out_p)                                \
+    ({                                                                  \
+        __typeof__((chm)->shards[0].map.data[0].key) _ck = (key_v);     \
+        __typeof__((chm)->shards[0].map.data[0].value) *_out = (out_p); \
+        size_t _ch = ds__chm_hash(chm, _ck);                            \
+        __typeof__(&(chm)->shards[0]) _s = ds__chm_shard(chm, _ch);     \
+        ds__rwlock_wrlock(&_s->lock);                                   \
+        __typeof__(_out) _p = ds__hm_remove_hashed(&_s->map, _ck, _ch); \
+        if (_p && _out) *_out = *_p;                                    \
+        ds__rwlock_wrunlock(&_s->lock);                                 \
+        _p != NULL;                                                     \
+    })
+
+/**
+ * Return the value of a key, inserting `init_fn(key, ctx)` first if the key
+ * is missing. `init_fn` runs at most once per key, under the shard lock, so
+ * it must not use the same map.
+ * Example:
+ ```c
+ Conn *open_conn(int port, void *ctx) { ... }
+ ...
+    Conn *c = ds_chm_compute_if_absent(&conns, 8080, open_conn, NULL);
+ ```
+ */
+#define ds_chm_compute_if_absent(chm, key_v, init_fn, ctx)           \
+    ({                                                               \
+        __typeof__((chm)->shards[0].map.data[0].key) _ck = (key_v);  \
+        __typeof__((chm)->shards[0].map.data[0].value) _cv;          \
+        size_t _ch = ds__chm_hash(chm, _ck);                         \
+        __typeof__(&(chm)->shards[0]) _s = ds__chm_shard(chm, _ch);  \
+        bool _w;                                                     \
+        ds__chm_read_lock(_s, _w);                                   \
+        __typeof__(&_cv) _p = ds__hm_try_hashed(&_s->map, _ck, _ch); \
+        if (_p) _cv = *_p;                                           \
+        ds__chm_read_unlock(_s, _w);                                 \
+        if (!_p) {                                                   \
+            ds__rwlock_wrlock(&_s->lock);                            \
+            _p = ds__hm_try_hashed(&_s->map, _ck, _ch);              \
+            if (_p) {                                                \
+                _cv = *_p;                                           \
+            } else {                                                 \
+                _cv = (init_fn)(_ck, (ctx));                         \
+                ds__hm_set_hashed(&_s->map, _ck, _cv, _ch);          \
+            }                                                        \
+            ds__rwlock_wrunlock(&_s->lock);                          \
+        }                                                            \
+        _cv;                                                         \
+    })
+
+/**
+ * Number of entries in the concurrent map. With concurrent writers it is a
+ * snapshot: shards are counted one at a time.
+ */
+#define ds_chm_length(chm)                                \
+    ({                                                    \
+        size_t _n = 0;                                    \
+        for (size_t _i = 0; _i < DS_CHM_SHARDS; _i++) {   \
+            ds__rwlock_rdlock(&(chm)->shards[_i].lock);   \
+            _n += (chm)->shards[_i].map.length;           \
+            ds__rwlock_rdunlock(&(chm)->shards[_i].lock); \
+        }                                                 \
+        _n;                                               \
+    })
+
+/**
+ * Free the concurrent map and its locks. Not thread safe.
+ * Like `ds_hm_free` it will not free the values.
+ */
+#define ds_chm_free(chm)                                 \
+    do {                                                 \
+        for (size_t _i = 0; _i < DS_CHM_SHARDS; _i++) {  \
+            ds_hm_free(&(chm)->shards[_i].map);          \
+            ds__rwlock_destroy(&(chm)->shards[_i].lock); \
+        }                                                \
+    } while (0)
+#endif // DS_CHM
+
+/**
+ * Declare a bounded cache of at most `cap` entries: a hash map that, once
+ * full, evicts with CLOCK (second chance). A hit sets the entry's reference
+ * bit; an insert into a full cache sweeps a hand over the entries, clearing
+ * set bits, and replaces the first entry whose bit was already clear. Entries
+ * stay in place in the map's dense array and the bits live in the cache, so
+ * after `name_init` nothing is allocated and get, put and evict are O(1)
+ * (amortized over the sweep).
+ * Generated:
+ *   `name_init(c, on_evict, ctx)` sizes the map for `cap` entries
+ *   `name_get(c, key)` pointer to the value or NULL, counted as a hit or miss
+ *   `name_put(c, key, value)` insert or update, pointer to the stored value
+ *   `name_remove(c, key)` true if the key was cached
+ *   `name_free(c)`
+ * `on_evict(key_t *key, val_t *value, void *ctx)`, which may be NULL, is
+ * called for every entry the cache drops (evicted, removed, or still cached
+ * at free), so it can release what the entry owns. Keys are stored as they
+ * are, strings are not copied.
+ * `hits`, `misses` and `evictions` count since init; iterate the entries
+ * with `ds_hm_foreach(&c.map, kv)`.
+ * Example:
+ ```c
+ static void drop_page(const char **url, Page *page, void *ctx) {
+     free((char *)*url);
+     page_free(page);
+ }
+ ds_cache_declare(PageCache, const char *, Page, 1024);
+
+ PageCache pc;
+ PageCache_init(&pc, drop_page, NULL);
+ Page *p = PageCache_get(&pc, url);
+ if (!p) p = PageCache_put(&pc, strdup(url), page_fetch(url));
+ ...
+ PageCache_free(&pc);
+ ```
+ */
+#define ds_cache_declare(name, key_t, val_t, cap)                                                     \
+    typedef struct {                                                                                  \
+        ds_Hm(key_t, val_t) map;                                                                      \
+        uint64_t ref[((cap) + 63) / 64];                                                              \
+        size_t hand;                                                                                  \
+        size_t hits;                                                                                  \
+        size_t misses;                                                                                \
+        size_t evictions;                                                                             \
+        void (*on_evict)(key_t *key, val_t *value, void *ctx);                                        \
+        void *ctx;                                                                                    \
+    } name;                                                                                           \
+    static inline void name##_init(name *c, void (*on_evict)(key_t *, val_t *, void *), void *ctx) {  \
+        memset(c, 0, sizeof(*c));                                                                     \
+        c->on_evict = on_evict;                                                                       \
+        c->ctx = ctx;                                                                                 \
+        ds_hm_reserve(&c->map, (cap));                                                                \
+    }                                                                                                 \
+    /* drop the entry under the hand and return its index, left in place */                           \
+    static inline size_t name##__evict(name *c) {                                                     \
+        while (c->ref[c->hand / 64] & ((uint64_t)1 << (c->hand % 64))) {                              \
+            c->ref[c->hand / 64] &= ~((uint64_t)1 << (c->hand % 64));                                 \
+            if (++c->hand == (cap)) c->hand = 0;                                                      \
+        }                                                                                             \
+        size_t victim = c->hand, slot, idx;                                                           \
+        if (++c->hand == (cap)) c->hand = 0;                                                          \
+        __typeof__(c->map.data) e = &c->map.data[victim];                                             \
+        const size_t *hs = ds__ht_hashes(&c->map.table);                                              \
+        size_t h = hs ? hs[victim] : ds__ht_hash(&c->map, e->key);                                    \
+        bool found = ds__ht_find(&c->map, e->key, h, &slot, &idx);                                    \
+        assert(found && idx == victim);                                                               \
+        DS_UNUSED(found);                                                                             \
+        /* an index past the end: no entry was moved, only the slot goes */                           \
+        ds__ht_remove_slot(&c->map, e->key, slot, c->map.length);                                     \
+        c->evictions++;                                                                               \
+        if (c->on_evict) c->on_evict(&e->key, &e->value, c->ctx);                                     \
+        return victim;                                                                                \
+    }                                                                                                 \
+    static inline val_t *name##_get(name *c, key_t key) {                                             \
+        size_t slot, idx;                                                                             \
+        if (!ds__ht_find(&c->map, key, ds__ht_hash(&c->map, key), &slot, &idx)) {                     \
+            c->misses++;                                                                              \
+            return NULL;                                                                              \
+        }                                                                                             \
+        c->hits++;                                                                                    \
+        c->ref[idx / 64] |= (uint64_t)1 << (idx % 64);                                                \
+        return &c->map.data[idx].value;                                                               \
+    }                                                                                                 \
+    static inline val_t *name##_put(name *c, key_t key, val_t value) {                                \
+        assert(c->map.table.capacity && "cache not initialized");                                     \
+        size_t h = ds__ht_hash(&c->map, key), slot, idx;                                              \
+        if (ds__ht_find(&c->map, key, h, &slot, &idx)) {                                              \
+            c->map.data[idx].value = value;                                                           \
+            c->ref[idx / 64] |= (uint64_t)1 << (idx % 64);                                            \
+            return &c->map.data[idx].value;                                                           \
+        }                                                                                             \
+        if (c->map.length < (cap)) {                                                                  \
+            idx = c->map.length++;                                                                    \
+        } else {                                                                                      \
+            idx = name##__evict(c);                                                                   \
+            size_t moved;                                                                             \
+            ds__ht_find(&c->map, key, h, &slot, &moved); /* the eviction may have shifted the slot */ \
+        }                                                                                             \
+        c->map.data[idx].key = key;                                                                   \
+        c->map.data[idx].value = value;                                                               \
+        ds__table_insert(&c->map.table, slot, h, idx);                                                \
+        return &c->map.data[idx].value;                                                               \
+    }                                                                                                 \
+    static inline bool name##_remove(name *c, key_t key) {                                            \
+        size_t slot, idx;                                                                             \
+        if (!ds__ht_find(&c->map, key, ds__ht_hash(&c->map, key), &slot, &idx)) return false;         \
+        __typeof__(*c->map.data) e = c->map.data[idx];                                                \
+        size_t last = c->map.length - 1;                                                              \
+        uint64_t bit = (c->ref[last / 64] >> (last % 64)) & 1; /* moves with the last entry */        \
+        c->ref[idx / 64] &= ~((uint64_t)1 << (idx % 64));                                             \
+        c->ref[last / 64] &= ~((uint64_t)1 << (last % 64));                                           \
+        if (idx != last) c->ref[idx / 64] |= bit << (idx % 64);                                       \
+        ds_da_remove_unordered(&c->map, idx);                                                         \
+        ds__ht_remove_slot(&c->map, key, slot, idx);                                                  \
+        if (c->on_evict) c->on_evict(&e.key, &e.value, c->ctx);                                       \
+        return true;                                                                                  \
+    }                                                                                                 \
+    static inline void name##_free(name *c) {                                                         \
+        if (c->on_evict) {                                                                            \
+            ds_hm_foreach(&c->map, kv) c->on_evict(&kv->key, &kv->value, c->ctx);                     \
+        }                                                                                             \
+        ds__table_free(&c->map.table);                                                                \
+        ds_da_free(&c->map);                                                                          \
+        memset(c, 0, sizeof(*c));                                                                     \
+    }
+
+/**
+ * Split block Bloom filter: each key sets one bit in each of the eight
+ * 32-bit words of a single 32-byte block, so a test reads one cache line
+ * and checks the eight bits at once (with AVX2, a multiply, a shift and a
+ * `vptest`; SSE2 and NEON take two vectors). False positives are possible,
+ * false negatives are not.
+ * Keys are hashed like hash map keys: strings by content, anything else by
+ * its bytes. `ds_bloom_add_hash` and `ds_bloom_has_hash` take a hash the
+ * caller already has, like a `ds_Hs` key hash.
+ * Example:
+ ```c
+ DsBloom bf;
+ ds_bloom_init(&bf, 1000000, 0.01); // 1M keys at 1% false positives
+ ds_bloom_add(&bf, "alice");
+ if (ds_bloom_has(&bf, name)) ... // maybe present
+ ds_bloom_free(&bf);
+ ```
+ */
+typedef struct DsBloom {
+    uint32_t *blocks;    /* block_count blocks of DS__BLOOM_WORDS words, 32-byte aligned */
+    void *mem;           /* allocation `blocks` points into */
+    size_t block_count;
+    size_t capacity;     /* keys the filter was sized for */
+    double fpp;          /* false positive rate it was sized for */
+} DsBloom;
+
+#define DS__BLOOM_WORDS 8
+
+/* Odd multipliers picking a bit in each word from the low half of the hash */
+#define DS__BLOOM_SALTS                                              \
+    0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du, 0x705495c7u, \
+        0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+
+/* The block comes from the high half of a remix of the hash, the bits from
+ * the low half: the low bits of the hash also pick the index slot. */
+static inline const uint32_t *ds__bloom_block(const DsBloom *bf, size_t hash, uint32_t *key) {
+    uint64_t x = (uint64_t)hash * 0x9E3779B97F4A7C15ull;
+    *key = (uint32_t)x;
+    return bf->blocks + (size_t)(((x >> 32) * bf->block_count) >> 32) * DS__BLOOM_WORDS;
+}
+
+#if !defined(__AVX2__) && (defined(__SSE2__) || defined(_M_X64))
+/* bits of the four words of `block` that `key` needs but are not set: a
+ * 32-bit multiply from two 32x32->64 ones, then 1 << bit by building the
+ * float 2^bit (2^31 converts to 0x80000000) */
+static inline __m128i ds__bloom_miss4(__m128i k, const uint32_t *salts, const uint32_t *block) {
+    __m128i salt = _mm_loadu_si128((const __m128i *)salts);
+    __m128i even = _mm_mul_epu32(k, salt);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(k, 4), _mm_srli_si128(salt, 4));
+    __m128i prod = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    __m128i exp = _mm_slli_epi32(_mm_add_epi32(_mm_srli_epi32(prod, 27), _mm_set1_epi32(127)), 23);
+    return _mm_andnot_si128(_mm_load_si128((const __m128i *)block), _mm_cvttps_epi32(_mm_castsi128_ps(exp)));
+}
+#endif
+
+static inline bool ds_bloom_has_hash(const DsBloom *bf, size_t hash) {
+    uint32_t key;
+    const uint32_t *block = ds__bloom_block(bf, hash, &key);
+#if defined(__AVX2__)
+    __m256i bits = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32((int)key),
+                                                        _mm256_setr_epi32(DS__BLOOM_SALTS)), 27);
+    __m256i mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), bits);
+    return _mm256_testc_si256(_mm256_load_si256((const __m256i *)block), mask);
+#elif defined(__SSE2__) || defined(_M_X64)
+    static const uint32_t salts[DS__BLOOM_WORDS] = {DS__BLOOM_SALTS};
+    __m128i k = _mm_set1_epi32((int)key);
+    __m128i miss = _mm_or_si128(ds__bloom_miss4(k, salts, block), ds__bloom_miss4(k, salts + 4, block + 4));
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(miss, _mm_setzero_si128())) == 0xFFFF;
+#elif defined(__ARM_NEON)
+    static const uint32_t salts[DS__BLOOM_WORDS] = {DS__BLOOM_SALTS};
+    uint32x4_t k = vdupq_n_u32(key), one = vdupq_n_u32(1);
+    uint32x4_t lo = vshlq_u32(one, vreinterpretq_s32_u32(vshrq_n_u32(vmulq_u32(k, vld1q_u32(salts)), 27)));
+    uint32x4_t hi = vshlq_u32(one, vreinterpretq_s32_u32(vshrq_n_u32(vmulq_u32(k, vld1q_u32(salts + 4)), 27)));
+    uint32x4_t miss = vorrq_u32(vbicq_u32(lo, vld1q_u32(block)), vbicq_u32(hi, vld1q_u32(block + 4)));
+    uint64x2_t m = vreinterpretq_u64_u32(miss);
+    return (vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1)) == 0;
+#else
+    /* branch-free so compilers can vectorize it */
+    static const uint32_t salts[DS__BLOOM_WORDS] = {DS__BLOOM_SALTS};
+    uint32_t miss = 0;
+    for (int i = 0; i < DS__BLOOM_WORDS; i++) miss |= ~block[i] & (1u << ((key * salts[i]) >> 27));
+    return miss == 0;
+#endif
+}
+
+static inline void ds_bloom_add_hash(DsBloom *bf, size_t hash) {
+    static const uint32_t salts[DS__BLOOM_WORDS] = {DS__BLOOM_SALTS};
+    uint32_t key;
+    uint32_t *block = (uint32_t *)ds__bloom_block(bf, hash, &key);
+    for (int i = 0; i < DS__BLOOM_WORDS; i++) block[i] |= 1u << ((key * salts[i]) >> 27);
+}
+
+/**
+ * Size the filter for `expected` keys at a false positive rate of `fpp`
+ * (0 < fpp < 1), e.g. about 10.5 bits per key for 1%.
+ */
+void ds_bloom_init(DsBloom *bf, size_t expected, double fpp);
+
+/**
+ * Remove every key, keeping the memory.
+ */
+void ds_bloom_clear(DsBloom *bf);
+
+void ds_bloom_free(DsBloom *bf);
+
+/**
+ * Add a key to the filter.
+ */
+#define ds_bloom_add(bf, key_v)                                         \
+    do {                                                                \
+        __typeof__((void)0, (key_v)) _k = (key_v); /* arrays decay */   \
+        ds_bloom_add_hash((bf), ds__entry_hfn(_k)(&_k, sizeof(_k), 0)); \
+    } while (0)
+
+/**
+ * False if the key was never added, true if it probably was.
+ */
+#define ds_bloom_has(bf, key_v)                                         \
+    ({                                                                  \
+        __typeof__((void)0, (key_v)) _k = (key_v); /* arrays decay */   \
+        ds_bloom_has_hash((bf), ds__entry_hfn(_k)(&_k, sizeof(_k), 0)); \
+    })
+
+#ifndef DS_BTREE_NODE_SIZE
+/**
+ * Target size in bytes of a `ds_btree_declare` node. A search prefetches all
+ * of a node's key lines at once, so a bigger node costs little more than a
+ * small one and saves levels; 4096 gives page-sized nodes.
+ */
+#define DS_BTREE_NODE_SIZE 1024
+#endif
+
+/* keys per node of DS_BTREE_NODE_SIZE bytes, at least 4 */
+#define ds__btree_fanout(item, header) \
+    ((DS_BTREE_NODE_SIZE - (header)) / (item) < 4 ? 4 : (DS_BTREE_NODE_SIZE - (header)) / (item))
+
+/**
+ * Declare an ordered map (B+tree) from `key_t` to `val_t`. Keys are compared
+ * with `<`, C strings by content; for other key types use
+ * `ds_btree_declare_ex`.
+ * Entries live in the leaves, which are chained in key order, and inner nodes
+ * only route: a node holds its keys in one array apart from the values or
+ * children, is about DS_BTREE_NODE_SIZE bytes, and is searched with a branch
+ * free binary search, so a lookup costs one node per level and a range scan
+ * reads the leaves sequentially.
+ * Generated:
+ *   `name_set(t, key, value)` insert or update
+ *   `name_get(t, key)` pointer to the value or NULL
+ *   `name_has(t, key)`
+ *   `name_remove(t, key)` true if the key was present
+ *   `name_first(t)`, `name_lower_bound(t, key)` (first key >= key) and
+ *   `name_upper_bound(t, key)` (first key > key) return a `name_Iter` whose
+ *   `key` and `value` point at the entry, or are NULL past the end;
+ *   `name_next(&it)` moves to the next key
+ *   `name_load(t, entries, n)` builds an empty tree from `name_Entry`s sorted
+ *   by strictly increasing key, e.g. a sorted `ds_da`, with full nodes
+ *   `name_free(t)`
+ * Nodes are allocated with DS_ALLOC, or from `t.arena` when set: then
+ * `name_free` and removes leave them to `ds_a_free`. Keys are stored as they
+ * are, strings are not copied. Pointers into the tree are valid until the
+ * next insert or remove.
+ * Example:
+ ```c
+ ds_btree_declare(Scores, const char *, int);
+
+ Scores t = {0}; // or {.arena = &arena}
+ Scores_set(&t, "bob", 3);
+ Scores_set(&t, "alice", 5);
+ for (Scores_Iter it = Scores_lower_bound(&t, "a"); it.key && strcmp(*it.key, "b") < 0; Scores_next(&it))
+     printf("%s: %d\n", *it.key, *it.value); // alice: 5
+ Scores_free(&t);
+ ```
+ */
+#define ds_btree_declare(name, key_t, val_t) ds_btree_declare_ex(name, key_t, val_t, ds__less)
+
+/**
+ * Declare a B+tree like `ds_btree_declare` with a custom order:
+ * `less(a, b)` is true when key `a` sorts before key `b`, a function or a
+ * macro taking two `key_t` lvalues.
+ * Example:
+ ```c
+ typedef struct { int x, y; } Point;
+ #define point_less(a, b) ((a).x < (b).x || ((a).x == (b).x && (a).y < (b).y))
+ ds_btree_declare_ex(PointTree, Point, int, point_less);
+ ```
+ */
+#define ds_btree_declare_ex(name, key_t, val_t, less)                                                           \
+    enum {                                                                                                      \
+        name##__LEAF_CAP = ds__btree_fanout(sizeof(key_t) + sizeof(val_t), sizeof(void *) + sizeof(uint32_t)),  \
+        name##__INNER_CAP = ds__btree_fanout(sizeof(key_t) + sizeof(void *), 2 * sizeof(void *)),               \
+    };                                                                                                          \
+    typedef struct name##_Leaf {                                                                                \
+        uint32_t count;                                                                                         \
+        struct name##_Leaf *next;                                                                               \
+        key_t keys[name##__LEAF_CAP];                                                                           \
+        val_t values[name##__LEAF_CAP];                                                                         \
+    } name##_Leaf;                                                                                              \
+    typedef struct {                                                                                            \
+        uint32_t count; /* keys; count + 1 children */                                                          \
+        key_t keys[name##__INNER_CAP];                                                                          \
+        void *children[name##__INNER_CAP + 1];                                                                  \
+    } name##_Inner;                                                                                             \
+    typedef struct {                                                                                            \
+        void *root;                                                                                             \
+        size_t height; /* inner levels above the leaves */                                                      \
+        size_t length;                                                                                          \
+        DsArena *arena;                                                                                         \
+    } name;                                                                                                     \
+    typedef struct {                                                                                            \
+        key_t key;                                                                                              \
+        val_t value;                                                                                            \
+    } name##_Entry;                                                                                             \
+    typedef struct {                                                                                            \
+        name##_Leaf *leaf;                                                                                      \
+        uint32_t pos;                                                                                           \
+        key_t *key;                                                                                             \
+        val_t *value;                                                                                           \
+    } name##_Iter;                                                                                              \
+    /* the search's loads depend on each other: start every line of the keys */                                 \
+    static inline void name##__prefetch(const key_t *keys, uint32_t n) {                                        \
+        for (size_t off = DS_CACHE_LINE; off < n * sizeof(key_t); off += DS_CACHE_LINE) {                       \
+            DS__PREFETCH((const char *)keys + off);                                                             \
+        }                                                                                                       \
+    }                                                                                                           \
+    /* first index whose key is not less than `key` */                                                          \
+    static inline uint32_t name##__lower(const key_t *keys, uint32_t n, key_t key) {                            \
+        if (n == 0) return 0;                                                                                   \
+        name##__prefetch(keys, n);                                                                              \
+        const key_t *base = keys;                                                                               \
+        while (n > 1) {                                                                                         \
+            uint32_t half = n / 2;                                                                              \
+            base += less(base[half], key) ? half : 0;                                                           \
+            n -= half;                                                                                          \
+        }                                                                                                       \
+        return (uint32_t)(base - keys) + (less(*base, key) ? 1 : 0);                                            \
+    }                                                                                                           \
+    /* first index whose key is greater than `key` */                                                           \
+    static inline uint32_t name##__upper(const key_t *keys, uint32_t n, key_t key) {                            \
+        if (n == 0) return 0;                                                                                   \
+        name##__prefetch(keys, n);                                                                              \
+        const key_t *base = keys;                                                                               \
+        while (n > 1) {                                                                                         \
+            uint32_t half = n / 2;                                                                              \
+            base += less(key, base[half]) ? 0 : half;                                                           \
+            n -= half;                                                                                          \
+        }                                                                                                       \
+        return (uint32_t)(base - keys) + (less(key, *base) ? 0 : 1);                                            \
+    }                                                                                                           \
+    static inline void *name##__node(name *t, size_t size) {                                                    \
+        void *node = t->arena ? ds_a_malloc(t->arena, size) : DS_ALLOC(size);                                   \
+        assert(node && "out of memory");                                                                        \
+        return node;                                                                                            \
+    }                                                                                                           \
+    static inline void name##__release(name *t, void *node) {                                                   \
+        if (!t->arena) DS_FREE(node);                                                                           \
+    }                                                                                                           \
+    static inline name##_Leaf *name##__leaf(name *t, key_t key) {                                               \
+        void *node = t->root;                                                                                   \
+        for (size_t level = t->height; level > 0; level--) {                                                    \
+            name##_Inner *in = node;                                                                            \
+            node = in->children[name##__upper(in->keys, in->count, key)];                                       \
+        }                                                                                                       \
+        return node;                                                                                            \
+    }                                                                                                           \
+    static inline val_t *name##_get(name *t, key_t key) {                                                       \
+        name##_Leaf *leaf = name##__leaf(t, key);                                                               \
+        if (!leaf) return NULL;                                                                                 \
+        uint32_t i = name##__lower(leaf->keys, leaf->count, key);                                               \
+        return i < leaf->count && !less(key, leaf->keys[i]) ? &leaf->values[i] : NULL;                          \
+    }                                                                                                           \
+    static inline bool name##_has(name *t, key_t key) {                                                         \
+        return name##_get(t, key) != NULL;                                                                      \
+    }                                                                                                           \
+    /* insert under `node`; a split returns the new right sibling and the key                                   \
+       that separates it in *sep */                                                                             \
+    static inline void *name##__insert(name *t, void *node, size_t level, key_t key, val_t value, key_t *sep) { \
+        if (level == 0) {                                                                                       \
+            name##_Leaf *leaf = node, *right = NULL;                                                            \
+            uint32_t i = name##__lower(leaf->keys, leaf->count, key);                                           \
+            if (i < leaf->count && !less(key, leaf->keys[i])) {                                                 \
+                leaf->values[i] = value;                                                                        \
+                return NULL;                                                                                    \
+            }                                                                                                   \
+            t->length++;                                                                                        \
+            if (leaf->count == name##__LEAF_CAP) {                                                              \
+                uint32_t mid = name##__LEAF_CAP / 2;                                                            \
+                right = name##__node(t, sizeof(name##_Leaf));                                                   \
+                right->count = leaf->count - mid;                                                               \
+                memcpy(right->keys, leaf->keys + mid, right->count * sizeof(key_t));                            \
+                memcpy(right->values, leaf->values + mid, right->count * sizeof(val_t));                        \
+                right->next = leaf->next;                                                                       \
+                leaf->next = right;                                                                             \
+                leaf->count = mid;                                                                              \
+                if (i > mid) {                                                                                  \
+                    i -= mid;                                                                                   \
+                    leaf = right;                                                                               \
+                }                                                                                               \
+            }                                                                                                   \
+            memmove(leaf->keys + i + 1, leaf->keys + i, (leaf->count - i) * sizeof(key_t));                     \
+            memmove(leaf->values + i + 1, leaf->values + i, (leaf->count - i) * sizeof(val_t));                 \
+            leaf->keys[i] = key;                                                                                \
+            leaf->values[i] = value;                                                                            \
+            leaf->count++;                                                                                      \
+            if (right) *sep = right->keys[0];                                                                   \
+            return right;                                                                                       \
+        }                                                                                                       \
+        name##_Inner *in = node, *right = NULL;                                                                 \
+        uint32_t c = name##__upper(in->keys, in->count, key);                                                   \
+        key_t child_sep;                                                                                        \
+        void *child = name##__insert(t, in->children[c], level - 1, key, value, &child_sep);                    \
+        if (!child) return NULL;                                                                                \
+        if (in->count == name##__INNER_CAP) {                                                                   \
+            /* the middle key moves up, the keys after it go right */                                           \
+            uint32_t mid = name##__INNER_CAP / 2;                                                               \
+            right = name##__node(t, sizeof(name##_Inner));                                                      \
+            right->count = in->count - mid - 1;                                                                 \
+            memcpy(right->keys, in->keys + mid + 1, right->count * sizeof(key_t));                              \
+            memcpy(right->children, in->children + mid + 1, (right->count + 1) * sizeof(void *));               \
+            *sep = in->keys[mid];                                                                               \
+            in->count = mid;                                                                                    \
+            if (c > mid) {                                                                                      \
+                c -= mid + 1;                                                                                   \
+                in = right;                                                                                     \
+            }                                                                                                   \
+        }                                                                                                       \
+        memmove(in->keys + c + 1, in->keys + c, (in->count - c) * sizeof(key_t));                               \
+        memmove(in->children + c + 2, in->children + c + 1, (in->count - c) * sizeof(void *));                  \
+        in->keys[c] = child_sep;                                                                                \
+        in->children[c + 1] = child;                                                                            \
+        in->count++;                                                                                            \
+        return right;                                                                                           \
+    }                                                                                                           \
+    static inline void name##_set(name *t, key_t key, val_t value) {                                            \
+        if (!t->root) {                                                                                         \
+            name##_Leaf *leaf = name##__node(t, sizeof(name##_Leaf));                                           \
+            leaf->count = 0;                                                                                    \
+            leaf->next = NULL;                                                                                  \
+            t->root = leaf;                                                                                     \
+            t->height = 0;                                                                                      \
+        }                                                                                                       \
+        key_t sep;                                                                                              \
+        void *right = name##__insert(t, t->root, t->height, key, value, &sep);                                  \
+        if (right) {                                                                                            \
+            name##_Inner *root = name##__node(t, sizeof(name##_Inner));                                         \
+            root->count = 1;                                                                                    \
+            root->keys[0] = sep;                                                                                \
+            root->children[0] = t->root;                                                                        \
+            root->children[1] = right;                                                                          \
+            t->root = root;                                                                                     \
+            t->height++;                                                                                        \
+        }                                                                                                       \
+    }                                                                                                           \
+    /* child `c` of `in` fell below half full: merge it with a neighbour if                                     \
+       both fit in one node, else take one entry from the fuller of the two */                                  \
+    static inline void name##__rebalance(name *t, name##_Inner *in, uint32_t c, size_t level) {                 \
+        uint32_t l = c > 0 ? c - 1 : c; /* between children l and l + 1 */                                      \
+        if (level == 1) {                                                                                       \
+            name##_Leaf *a = in->children[l], *b = in->children[l + 1];                                         \
+            if (a->count + b->count <= name##__LEAF_CAP) {                                                      \
+                memcpy(a->keys + a->count, b->keys, b->count * sizeof(key_t));                                  \
+                memcpy(a->values + a->count, b->values, b->count * sizeof(val_t));                              \
+                a->count += b->count;                                                                           \
+                a->next = b->next;                                                                              \
+                name##__release(t, b);                                                                          \
+            } else {                                                                                            \
+                if (a->count > b->count) {                                                                      \
+                    memmove(b->keys + 1, b->keys, b->count * sizeof(key_t));                                    \
+                    memmove(b->values + 1, b->values, b->count * sizeof(val_t));                                \
+                    a->count--;                                                                                 \
+                    b->keys[0] = a->keys[a->count];                                                             \
+                    b->values[0] = a->values[a->count];                                                         \
+                    b->count++;                                                                                 \
+                } else {                                                                                        \
+                    a->keys[a->count] = b->keys[0];                                                             \
+                    a->values[a->count] = b->values[0];                                                         \
+                    a->count++;                                                                                 \
+                    b->count--;                                                                                 \
+                    memmove(b->keys, b->keys + 1, b->count * sizeof(key_t));                                    \
+                    memmove(b->values, b->values + 1, b->count * sizeof(val_t));                                \
+                }                                                                                               \
+                in->keys[l] = b->keys[0];                                                                       \
+                return;                                                                                         \
+            }                                                                                                   \
+        } else {                                                                                                \
+            name##_Inner *a = in->children[l], *b = in->children[l + 1];                                        \
+            if (a->count + b->count + 1 <= name##__INNER_CAP) {                                                 \
+                a->keys[a->count] = in->keys[l];                                                                \
+                memcpy(a->keys + a->count + 1, b->keys, b->count * sizeof(key_t));                              \
+                memcpy(a->children + a->count + 1, b->children, (b->count + 1) * sizeof(void *));               \
+                a->count += b->count + 1;                                                                       \
+                name##__release(t, b);                                                                          \
+            } else {                                                                                            \
+                /* rotate through the separator */                                                              \
+                if (a->count > b->count) {                                                                      \
+                    memmove(b->keys + 1, b->keys, b->count * sizeof(key_t));                                    \
+                    memmove(b->children + 1, b->children, (b->count + 1) * sizeof(void *));                     \
+                    b->keys[0] = in->keys[l];                                                                   \
+                    b->children[0] = a->children[a->count];                                                     \
+                    in->keys[l] = a->keys[a->count - 1];                                                        \
+                    a->count--;                                                                                 \
+                    b->count++;                                                                                 \
+                } else {                                                                                        \
+                    a->keys[a->count] = in->keys[l];                                                            \
+                    a->children[a->count + 1] = b->children[0];                                                 \
+                    in->keys[l] = b->keys[0];                                                                   \
+                    a->count++;                                                                                 \
+                    b->count--;                                                                                 \
+                    memmove(b->keys, b->keys + 1, b->count * sizeof(key_t));                                    \
+                    memmove(b->children, b->children + 1, (b->count + 1) * sizeof(void *));                     \
+                }                                                                                               \
+                return;                                                                                         \
+            }                                                                                                   \
+        }                                                                                                       \
+        /* merged: drop the separator and the right child */                                                    \
+        memmove(in->keys + l, in->keys + l + 1, (in->count - l - 1) * sizeof(key_t));                           \
+        memmove(in->children + l + 1, in->children + l + 2, (in->count - l - 1) * sizeof(void *));              \
+        in->count--;                                                                                            \
+    }                                                                                                           \
+    static inline bool name##__remove(name *t, void *node, size_t level, key_t key) {                           \
+        if (level == 0) {                                                                                       \
+            name##_Leaf *leaf = node;                                                                           \
+            uint32_t i = name##__lower(leaf->keys, leaf->count, key);                                           \
+            if (i == leaf->count || less(key, leaf->keys[i])) return false;                                     \
+            leaf->count--;                                                                                      \
+            memmove(leaf->keys + i, leaf->keys + i + 1, (leaf->count - i) * sizeof(key_t));                     \
+            memmove(leaf->values + i, leaf->values + i + 1, (leaf->count - i) * sizeof(val_t));                 \
+            t->length--;                                                                                        \
+            return true;                                                                                        \
+        }                                                                                                       \
+        name##_Inner *in = node;                                                                                \
+        uint32_t c = name##__upper(in->keys, in->count, key);                                                   \
+        if (!name##__remove(t, in->children[c], level - 1, key)) return false;                                  \
+        bool under = level == 1 ? ((name##_Leaf *)in->children[c])->count < name##__LEAF_CAP / 2                \
+                                : ((name##_Inner *)in->children[c])->count < (name##__INNER_CAP - 1) / 2;       \
+        if (under) name##__rebalance(t, in, c, level);                                                          \
+        return true;                                                                                            \
+    }                                                                                                           \
+    static inline bool name##_remove(name *t, key_t key) {                                                      \
+        if (!t->root || !name##__remove(t, t->root, t->height, key)) return false;                              \
+        void *root = t->root;                                                                                   \
+        if (t->height > 0 && ((name##_Inner *)root)->count == 0) {                                              \
+            t->root = ((name##_Inner *)root)->children[0];                                                      \
+            t->height--;                                                                                        \
+            name##__release(t, root);                                                                           \
+        } else if (t->height == 0 && ((name##_Leaf *)root)->count == 0) {                                       \
+            t->root = NULL;                                                                                     \
+            name##__release(t, root);                                                                           \
+        }                                                                                                       \
+        return true;                                                                                            \
+    }                                                                                                           \
+    static inline name##_Iter name##__iter(name##_Leaf *leaf, uint32_t pos) {                                   \
+        while (leaf && pos == leaf->count) {                                                                    \
+            leaf = leaf->next;                                                                                  \
+            pos = 0;                                                                                            \
+        }                                                                                                       \
+        name##_Iter it = {leaf, pos, leaf ? &leaf->keys[pos] : NULL, leaf ? &leaf->values[pos] : NULL};         \
+        return it;                                                                                              \
+    }                                                                                                           \
+    static inline name##_Iter name##_first(name *t) {                                                           \
+        void *node = t->root;                                                                                   \
+        for (size_t level = t->height; level > 0; level--) node = ((name##_Inner *)node)->children[0];          \
+        return name##__iter(node, 0);                                                                           \
+    }                                                                                                           \
+    static inline name##_Iter name##_lower_bound(name *t, key_t key) {                                          \
+        name##_Leaf *leaf = name##__leaf(t, key);                                                               \
+        return name##__iter(leaf, leaf ? name##__lower(leaf->keys, leaf->count, key) : 0);                      \
+    }                                                                                                           \
+    static inline name##_Iter name##_upper_bound(name *t, key_t key) {                                          \
+        name##_Leaf *leaf = name##__leaf(t, key);                                                               \
+        return name##__iter(leaf, leaf ? name##__upper(leaf->keys, leaf->count, key) : 0);                      \
+    }                                                                                                           \
+    static inline void name##_next(name##_Iter *it) {                                                           \
+        *it = name##__iter(it->leaf, it->pos + 1);                                                              \
+    }                                                                                                           \
+    /* leaves first, spreading the entries evenly so every node but a lone                                      \
+       root is at least half full, then each level of inner nodes over the                                      \
+       one below */                                                                                             \
+    static inline void name##_load(name *t, const name##_Entry *entries, size_t n) {                            \
+        assert(!t->root && "load into an empty tree");                                                          \
+        if (n == 0) return;                                                                                     \
+        size_t count = (n + name##__LEAF_CAP - 1) / name##__LEAF_CAP;                                           \
+        void **nodes = DS_ALLOC(count * sizeof(void *));                                                        \
+        key_t *firsts = DS_ALLOC(count * sizeof(key_t));                                                        \
+        assert(nodes && firsts && "out of memory");                                                             \
+        name##_Leaf *prev = NULL;                                                                               \
+        for (size_t j = 0, at = 0; j < count; j++) {                                                            \
+            name##_Leaf *leaf = name##__node(t, sizeof(name##_Leaf));                                           \
+            leaf->count = (uint32_t)(n / count + (j < n % count));                                              \
+            leaf->next = NULL;                                                                                  \
+            for (uint32_t i = 0; i < leaf->count; i++, at++) {                                                  \
+                assert((at == 0 || less(entries[at - 1].key, entries[at].key)) && "keys sorted and unique");    \
+                leaf->keys[i] = entries[at].key;                                                                \
+                leaf->values[i] = entries[at].value;                                                            \
+            }                                                                                                   \
+            if (prev) prev->next = leaf;                                                                        \
+            prev = leaf;                                                                                        \
+            nodes[j] = leaf;                                                                                    \
+            firsts[j] = leaf->keys[0];                                                                          \
+        }                                                                                                       \
+        t->height = 0;                                                                                          \
+        while (count > 1) {                                                                                     \
+            size_t parents = (count + name##__INNER_CAP) / (name##__INNER_CAP + 1);                             \
+            for (size_t j = 0, at = 0; j < parents; j++) {                                                      \
+                name##_Inner *in = name##__node(t, sizeof(name##_Inner));                                       \
+                uint32_t children = (uint32_t)(count / parents + (j < count % parents));                        \
+                key_t first = firsts[at];                                                                       \
+                in->count = children - 1;                                                                       \
+                for (uint32_t i = 0; i < children; i++, at++) {                                                 \
+                    in->children[i] = nodes[at];                                                                \
+                    if (i > 0) in->keys[i - 1] = firsts[at];                                                    \
+                }                                                                                               \
+                nodes[j] = in;                                                                                  \
+                firsts[j] = first;                                                                              \
+            }                                                                                                   \
+            count = parents;                                                                                    \
+            t->height++;                                                                                        \
+        }                                                                                                       \
+        t->root = nodes[0];                                                                                     \
+        t->length = n;                                                                                          \
+        DS_FREE(nodes);                                                                                         \
+        DS_FREE(firsts);                                                                                        \
+    }                                                                                                           \
+    static inline void name##__free(name *t, void *node, size_t level) {                                        \
+        if (level > 0) {                                                                                        \
+            name##_Inner *in = node;                                                                            \
+            for (uint32_t i = 0; i <= in->count; i++) name##__free(t, in->children[i], level - 1);              \
+        }                                                                                                       \
+        name##__release(t, node);                                                                               \
+    }                                                                                                           \
+    static inline void name##_free(name *t) {                                                                   \
+        if (t->root && !t->arena) name##__free(t, t->root, t->height);                                          \
+        t->root = NULL;                                                                                         \
+        t->height = 0;                                                                                          \
+        t->length = 0;                                                                                          \
+    }
+
+#ifndef DS_FM_MAX
+/**
+ * Entries a `ds_fm_declare` map holds in its sorted arrays; the insert past
+ * it moves everything into a hash map.
+ */
+#define DS_FM_MAX 64
+#endif
+
+/**
+ * Declare a flat map for small key sets: keys sorted in one array and the
+ * values at the same index in another, searched with a branch free binary
+ * search and no hashing. It allocates two arrays growing from 4 entries
+ * where a `ds_Hm` starts with a DS_HM_INIT_CAPACITY slot index, so a map of
+ * a handful of entries takes several times less memory. Once it holds
+ * DS_FM_MAX entries the next insert promotes it to a `name_Map`, declared
+ * with `ds_hm_declare_ex` (`fm.map`), which it stays. Keys are compared with
+ * `<`, C strings by content, and hashed like `ds_hm` keys after promotion;
+ * `ds_fm_declare_ex` takes its own ordering and hash.
+ * Generated:
+ *   `name_set(m, key, value)` insert or update
+ *   `name_get(m, key)` pointer to the value or NULL
+ *   `name_has(m, key)`
+ *   `name_remove(m, key)` true if the key was present
+ *   `name_length(m)`
+ *   `name_free(m)`
+ * Keys are stored as they are, flat or promoted: strings are not copied and
+ * must outlive the map. Iterate with `ds_fm_foreach`, in key order until the
+ * map is promoted.
+ * Example:
+ ```c
+ ds_fm_declare(Headers, const char *, const char *);
+
+ Headers h = {0};
+ Headers_set(&h, "content-type", "text/plain");
+ const char **v = Headers_get(&h, "content-type");
+ ds_fm_foreach(&h, k, v) printf("%s: %s\n", *k, *v);
+ Headers_free(&h);
+ ```
+ */
+#define ds_fm_declare(name, key_t, val_t) ds_fm_declare_ex(name, key_t, val_t, ds__less, ds__fm_hash)
+
+/* the ds_hm hash of `*key` */
+#define ds__fm_hash(key, seed) ds__entry_hfn(*(key))((key), sizeof(*(key)), (seed))
+
+/**
+ * Declare a flat map like `ds_fm_declare` ordered by `less(a, b)`, a function
+ * or a macro taking two `key_t` lvalues, and hashed after promotion with
+ * `size_t hash_fn(const key_t *key, size_t seed)`. Keys equal under `less`
+ * must hash alike.
+ * Example:
+ ```c
+ ds_fm_declare_ex(CiFlat, const char *, int, ci_less, ci_hash); // case-insensitive
+ ```
+ */
+#define ds_fm_declare_ex(name, key_t, val_t, less, hash_fn)                                   \
+    static inline bool name##__eq(const key_t *a, const key_t *b) {                           \
+        return !less(*a, *b) && !less(*b, *a);                                                \
+    }                                                                                         \
+    ds_hm_declare_ex(name##_Map, key_t, val_t, hash_fn, name##__eq)                           \
+    typedef struct {                                                                          \
+        struct {                                                                              \
+            key_t *data;                                                                      \
+            size_t length;                                                                    \
+            size_t capacity;                                                                  \
+        } keys;                                                                               \
+        struct {                                                                              \
+            val_t *data;                                                                      \
+            size_t length;                                                                    \
+            size_t capacity;                                                                  \
+        } values;                                                                             \
+        name##_Map *map;                                                                      \
+    } name;                                                                                   \
+    /* first index whose key is not less than `key` */                                        \
+    static inline size_t name##__lower(const name *m, key_t key) {                            \
+        const key_t *base = m->keys.data;                                                     \
+        size_t n = m->keys.length;                                                            \
+        if (n == 0) return 0;                                                                 \
+        while (n > 1) {                                                                       \
+            size_t half = n / 2;                                                              \
+            base += less(base[half], key) ? half : 0;                                         \
+            n -= half;                                                                        \
+        }                                                                                     \
+        return (size_t)(base - m->keys.data) + (less(*base, key) ? 1 : 0);                    \
+    }                                                                                         \
+    static inline val_t *name##_get(name *m, key_t key) {                                     \
+        if (m->map) return name##_Map_try(m->map, key);                                       \
+        size_t i = name##__lower(m, key);                                                     \
+        return i < m->keys.length && !less(key, m->keys.data[i]) ? &m->values.data[i] : NULL; \
+    }                                                                                         \
+    static inline bool name##_has(name *m, key_t key) {                                       \
+        return name##_get(m, key) != NULL;                                                    \
+    }                                                                                         \
+    static inline void name##__promote(name *m) {                                             \
+        m->map = DS_ALLOC(sizeof(*m->map));                                                   \
+        assert(m->map && "out of memory");                                                    \
+        memset(m->map, 0, sizeof(*m->map));                                                   \
+        ds_hm_reserve(m->map, m->keys.length * 2);                                            \
+        for (size_t i = 0; i < m->keys.length; i++)                                           \
+            name##_Map_set(m->map, m->keys.data[i], m->values.data[i]);                       \
+        ds_da_free(&m->keys);                                                                 \
+        ds_da_free(&m->values);                                                               \
+    }                                                                                         \
+    static inline void name##_set(name *m, key_t key, val_t value) {                          \
+        if (!m->map) {                                                                        \
+            size_t i = name##__lower(m, key);                                                 \
+            if (i < m->keys.length && !less(key, m->keys.data[i])) {                          \
+                m->values.data[i] = value;                                                    \
+                return;                                                                       \
+            }                                                                                 \
+            if (m->keys.length < DS_FM_MAX) {                                                 \
+                ds_da_reserve_with_init_capacity(&m->keys, m->keys.length + 1, 4);            \
+                ds_da_reserve_with_init_capacity(&m->values, m->values.length + 1, 4);        \
+                ds_da_insert(&m->keys, i, key);                                               \
+                ds_da_insert(&m->values, i, value);                                           \
+                return;                                                                       \
+            }                                                                                 \
+            name##__promote(m);                                                               \
+        }                                                                                     \
+        name##_Map_set(m->map, key, value);                                                   \
+    }                                                                                         \
+    static inline bool name##_remove(name *m, key_t key) {                                    \
+        if (m->map) return name##_Map_remove(m->map, key) != NULL;                            \
+        size_t i = name##__lower(m, key);                                                     \
+        if (i == m->keys.length || less(key, m->keys.data[i])) return false;                  \
+        ds_da_remove(&m->keys, i, 1);                                                         \
+        ds_da_remove(&m->values, i, 1);                                                       \
+        return true;                                                                          \
+    }                                                                                         \
+    static inline size_t name##_length(const name *m) {                                       \
+        return m->map ? m->map->length : m->keys.length;                                      \
+    }                                                                                         \
+    static inline void name##_free(name *m) {                                                 \
+        if (m->map) {                                                                         \
+            ds_hm_free(m->map);                                                               \
+            DS_FREE(m->map);                                                                  \
+            m->map = NULL;                                                                    \
+        }                                                                                     \
+        ds_da_free(&m->keys);                                                                 \
+        ds_da_free(&m->values);                                                               \
+    }
+
+/**
+ * Iterate over a `ds_fm_declare` map, defining `k` and `v` pointers to each
+ * key and value. `break` leaves the whole loop.
+ * Example:
+ *   `ds_fm_foreach(&m, k, v) printf("%d: %d\n", *k, *v);`
+ */
+#define ds_fm_foreach(fm, k, v)                                                                                                     \
+    for (size_t _i = 0, _n = (fm)->map ? (fm)->map->length : (fm)->keys.length, _more = 1; _more && _i < _n; _i++)                  \
+        for (__typeof__((fm)->keys.data) k = (_more = 0, (fm)->map ? &(fm)->map->data[_i].key : &(fm)->keys.data[_i]); k; k = NULL) \
+            for (__typeof__((fm)->values.data) v = (fm)->map ? &(fm)->map->data[_i].value : &(fm)->values.data[_i]; v; v = NULL, _more = 1)
+
+/**
+ * Iterates array map and sets
+ */
+#define ds_foreach ds_da_foreach
+#define ds_foreach_idx ds_da_foreach_idx
+
+/**
+ * Declare a linked list.
+ * The linked list will store elements of the specified type.
+ * Example:
+ * `ds_ll_declare(my_list, int);`
+ *
+ * This will create a linked list type called `my_list` that stores `int` values like this:
+```c
+typedef struct my_list_Node {
+    int val;
+    struct my_list_Node *next;
+} my_list_Node;
+
+typedef struct {
+    my_list_Node *head;
+    my_list_Node *tail;
+    size_t size;
+} my_list;
+```
+ */
+#define ds_ll_declare(name, type) \
+    typedef struct name##_Node {  \
+        type val;                 \
+        struct name##_Node *next; \
+    } name##_Node;                \
+    typedef struct {              \
         name##_Node *head;        \
         name##_Node *tail;        \
         size_t size;              \
@@ -947,6 +3780,487 @@ typedef struct {
         DS_FREE(ds_ll_pop(ll)); \
     }
 
+#ifndef DS_RB_INIT_CAPACITY
+/**
+ * Initial capacity of a growable ring buffer, a power of two.
+ */
+#define DS_RB_INIT_CAPACITY 16
+#endif // DS_RB_INIT_CAPACITY
+
+/**
+ * Ring buffer (double-ended queue) declaration.
+ * Items live in one power-of-two array, from `head` around the end and back
+ * to the start: pushing and popping at either end is O(1) and allocation
+ * free until the buffer grows, and bulk pushes and pops copy at most two
+ * spans. `ds_rb_init_fixed` turns it into a fixed-capacity queue over a
+ * caller's buffer that never allocates.
+ * Example:
+ ```c
+ ds_rb_declare(Jobs, Job);
+ ...
+    Jobs q = {0};
+    ds_rb_push_back(&q, job);
+    while (q.length) run(ds_rb_pop_front(&q));
+    ds_rb_free(&q);
+ ```
+ */
+#define ds_rb_declare(name, type) \
+    typedef struct {              \
+        type *data;               \
+        size_t head;              \
+        size_t length;            \
+        size_t capacity;          \
+        bool fixed;               \
+    } name
+
+/* The helpers take the fields they need rather than the struct, so the
+   typed struct is never accessed through a different struct type. */
+void *ds__rb_grow(void *data, size_t *head, size_t length, size_t *capacity, size_t n, size_t item_size);
+void ds__rb_write(void *data, size_t capacity, size_t pos, const void *items, size_t n, size_t item_size);
+void ds__rb_read(const void *data, size_t capacity, size_t pos, void *out, size_t n, size_t item_size);
+
+/**
+ * Use `buffer`, an array of `capacity` items (a power of two), as the fixed
+ * storage of an empty ring buffer: pushes fail instead of growing, and
+ * `ds_rb_free` does not free it.
+ * Example:
+ ```c
+ Job slots[64];
+ Jobs q = {0};
+ ds_rb_init_fixed(&q, slots, 64);
+ if (!ds_rb_push_back(&q, job)) { ... } // full
+ ```
+ */
+#define ds_rb_init_fixed(rb, buffer, n)                                                 \
+    do {                                                                                \
+        assert((n) > 0 && ((n) & ((n) - 1)) == 0 && "capacity must be a power of two"); \
+        (rb)->data = (buffer);                                                          \
+        (rb)->head = 0;                                                                 \
+        (rb)->length = 0;                                                               \
+        (rb)->capacity = (n);                                                           \
+        (rb)->fixed = true;                                                             \
+    } while (0)
+
+/**
+ * Make room for `n` items in a ring buffer. False if it is fixed and smaller.
+ */
+#define ds_rb_reserve(rb, n)                                                                 \
+    ({                                                                                       \
+        size_t _rn = (n);                                                                    \
+        bool _rok = _rn <= (rb)->capacity || !(rb)->fixed;                                   \
+        if (_rn > (rb)->capacity && _rok)                                                    \
+            (rb)->data = ds__rb_grow((rb)->data, &(rb)->head, (rb)->length, &(rb)->capacity, \
+                                     _rn, sizeof(*(rb)->data));                              \
+        _rok;                                                                                \
+    })
+
+/**
+ * Pointer to the `i`th item from the front of a ring buffer, `i` < length.
+ */
+#define ds_rb_at(rb, i) (&(rb)->data[((rb)->head + (i)) & ((rb)->capacity - 1)])
+
+/**
+ * Pointer to the first item of a ring buffer, or NULL if it is empty.
+ */
+#define ds_rb_front(rb) ((rb)->length > 0 ? &(rb)->data[(rb)->head] : NULL)
+
+/**
+ * Pointer to the last item of a ring buffer, or NULL if it is empty.
+ */
+#define ds_rb_back(rb) ((rb)->length > 0 ? ds_rb_at((rb), (rb)->length - 1) : NULL)
+
+/**
+ * Add an item at the back of a ring buffer. Returns false when a fixed
+ * buffer is full.
+ */
+#define ds_rb_push_back(rb, item)                                                          \
+    ({                                                                                     \
+        bool _ok = (rb)->length < (rb)->capacity || ds_rb_reserve((rb), (rb)->length + 1); \
+        if (_ok) {                                                                         \
+            (rb)->data[((rb)->head + (rb)->length) & ((rb)->capacity - 1)] = (item);       \
+            (rb)->length++;                                                                \
+        }                                                                                  \
+        _ok;                                                                               \
+    })
+
+/**
+ * Add an item at the front of a ring buffer. Returns false when a fixed
+ * buffer is full.
+ */
+#define ds_rb_push_front(rb, item)                                                         \
+    ({                                                                                     \
+        bool _ok = (rb)->length < (rb)->capacity || ds_rb_reserve((rb), (rb)->length + 1); \
+        if (_ok) {                                                                         \
+            (rb)->head = ((rb)->head - 1) & ((rb)->capacity - 1);                          \
+            (rb)->data[(rb)->head] = (item);                                               \
+            (rb)->length++;                                                                \
+        }                                                                                  \
+        _ok;                                                                               \
+    })
+
+/**
+ * Remove and return the first item of a non-empty ring buffer.
+ */
+#define ds_rb_pop_front(rb)                                   \
+    ({                                                        \
+        assert((rb)->length > 0);                             \
+        __typeof__(*(rb)->data) _v = (rb)->data[(rb)->head];  \
+        (rb)->head = ((rb)->head + 1) & ((rb)->capacity - 1); \
+        (rb)->length--;                                       \
+        _v;                                                   \
+    })
+
+/**
+ * Remove and return the last item of a non-empty ring buffer.
+ */
+#define ds_rb_pop_back(rb)             \
+    ({                                 \
+        assert((rb)->length > 0);      \
+        (rb)->length--;                \
+        *ds_rb_at((rb), (rb)->length); \
+    })
+
+#define ds__rb_push_many(rb, items, n, front)                                                         \
+    ({                                                                                                \
+        size_t _pn = (n);                                                                             \
+        bool _pok = ds_rb_reserve((rb), (rb)->length + _pn);                                          \
+        if (_pok && _pn > 0) {                                                                        \
+            size_t _mask = (rb)->capacity - 1;                                                        \
+            size_t _pos = (front) ? ((rb)->head - _pn) & _mask : ((rb)->head + (rb)->length) & _mask; \
+            ds__rb_write((rb)->data, (rb)->capacity, _pos, (items), _pn, sizeof(*(rb)->data));        \
+            if (front) (rb)->head = _pos;                                                             \
+            (rb)->length += _pn;                                                                      \
+        }                                                                                             \
+        _pok;                                                                                         \
+    })
+
+#define ds__rb_pop_many(rb, out, n, front)                                                             \
+    ({                                                                                                 \
+        size_t _pn = (n);                                                                              \
+        void *_pout = (out);                                                                           \
+        if (_pn > (rb)->length) _pn = (rb)->length;                                                    \
+        if (_pn > 0) {                                                                                 \
+            size_t _mask = (rb)->capacity - 1;                                                         \
+            size_t _pos = (front) ? (rb)->head : ((rb)->head + (rb)->length - _pn) & _mask;            \
+            if (_pout) ds__rb_read((rb)->data, (rb)->capacity, _pos, _pout, _pn, sizeof(*(rb)->data)); \
+            if (front) (rb)->head = ((rb)->head + _pn) & _mask;                                        \
+            (rb)->length -= _pn;                                                                       \
+        }                                                                                              \
+        _pn;                                                                                           \
+    })
+
+/**
+ * Add `n` items from a plain array at the back of a ring buffer, in order,
+ * with at most two `memcpy`s. Returns false, adding nothing, when a fixed
+ * buffer has no room for all of them.
+ * Example:
+ *   `ds_rb_push_back_many(&q, jobs, 8);`
+ */
+#define ds_rb_push_back_many(rb, items, n) ds__rb_push_many((rb), (items), (n), false)
+
+/**
+ * Add `n` items from a plain array at the front of a ring buffer, keeping
+ * their order: `items[0]` becomes the first item.
+ */
+#define ds_rb_push_front_many(rb, items, n) ds__rb_push_many((rb), (items), (n), true)
+
+/**
+ * Remove up to `n` items from the front of a ring buffer into `out`, in
+ * order, or drop them if `out` is NULL. Returns the number removed.
+ * Example:
+ *   `size_t got = ds_rb_pop_front_many(&q, batch, 32);`
+ */
+#define ds_rb_pop_front_many(rb, out, n) ds__rb_pop_many((rb), (out), (n), true)
+
+/**
+ * Remove up to `n` items from the back of a ring buffer into `out`, which
+ * receives them in front-to-back order. Returns the number removed.
+ */
+#define ds_rb_pop_back_many(rb, out, n) ds__rb_pop_many((rb), (out), (n), false)
+
+/**
+ * Iterate over a ring buffer from front to back, with `var` pointing at the
+ * current item; `break` leaves the whole loop.
+ */
+#define ds_rb_foreach(rb, var)                                       \
+    for (size_t _i = 0, _more = 1; _more && _i < (rb)->length; _i++) \
+        for (__typeof__((rb)->data) var = (_more = 0, ds_rb_at((rb), _i)); var; var = NULL, _more = 1)
+
+/**
+ * Remove all the items of a ring buffer, keeping its storage.
+ */
+#define ds_rb_clear(rb)   \
+    do {                  \
+        (rb)->head = 0;   \
+        (rb)->length = 0; \
+    } while (0)
+
+/**
+ * Free a ring buffer's storage, unless it is a fixed buffer, and zero it.
+ */
+#define ds_rb_free(rb)                                       \
+    do {                                                     \
+        if (!(rb)->fixed && (rb)->data) DS_FREE((rb)->data); \
+        memset((rb), 0, sizeof(*(rb)));                      \
+    } while (0)
+
+/**
+ * Lock-free single-producer single-consumer queue declaration.
+ * A bounded power-of-two ring where one thread pushes and one thread pops.
+ * The consumer's `head` and the producer's `tail` sit on their own cache
+ * lines next to a cached copy of the other side's index, so a push or pop
+ * only touches the shared line when the cached copy says the queue looks
+ * full or empty. `ds_spsc_push_many` and `ds_spsc_pop_many` move a batch
+ * with one index update.
+ * Example:
+ ```c
+ ds_spsc_declare(JobQueue, Job);
+ ...
+    JobQueue q;
+    ds_spsc_init(&q, 1024);
+    while (!ds_spsc_push(&q, job)) sched_yield(); // producer thread
+    ...
+    Job job;
+    if (ds_spsc_pop(&q, &job)) run(job);         // consumer thread
+    ...
+    ds_spsc_free(&q);
+ ```
+ */
+#define ds_spsc_declare(name, type)          \
+    typedef struct {                         \
+        _Alignas(DS_CACHE_LINE) size_t head; \
+        size_t tail_cache;                   \
+        _Alignas(DS_CACHE_LINE) size_t tail; \
+        size_t head_cache;                   \
+        _Alignas(DS_CACHE_LINE) type *data;  \
+        size_t capacity;                     \
+    } name
+
+/* smallest power of two >= both `n` and `min` */
+size_t ds__pow2_ceil(size_t n, size_t min);
+
+/**
+ * Initialize a queue for at least `capacity` items (rounded up to a power
+ * of two). Not thread safe.
+ */
+#define ds_spsc_init(q, n)                                        \
+    do {                                                          \
+        memset((q), 0, sizeof(*(q)));                             \
+        (q)->capacity = ds__pow2_ceil((n), 1);                    \
+        (q)->data = DS_ALLOC((q)->capacity * sizeof(*(q)->data)); \
+        assert((q)->data && "out of memory");                     \
+    } while (0)
+
+/**
+ * Push an item. Producer thread only. Returns false if the queue is full.
+ */
+#define ds_spsc_push(q, item)                                                               \
+    ({                                                                                      \
+        __typeof__(*(q)->data) _v = (item);                                                 \
+        size_t _t = __atomic_load_n(&(q)->tail, __ATOMIC_RELAXED);                          \
+        bool _ok = _t - (q)->head_cache < (q)->capacity ||                                  \
+                   _t - ((q)->head_cache = __atomic_load_n(&(q)->head, __ATOMIC_ACQUIRE)) < \
+                       (q)->capacity;                                                       \
+        if (_ok) {                                                                          \
+            (q)->data[_t & ((q)->capacity - 1)] = _v;                                       \
+            __atomic_store_n(&(q)->tail, _t + 1, __ATOMIC_RELEASE);                         \
+        }                                                                                   \
+        _ok;                                                                                \
+    })
+
+/**
+ * Pop an item into `*out_p` (when not NULL). Consumer thread only.
+ * Returns false if the queue is empty.
+ */
+#define ds_spsc_pop(q, out_p)                                                               \
+    ({                                                                                      \
+        size_t _h = __atomic_load_n(&(q)->head, __ATOMIC_RELAXED);                          \
+        bool _ok = _h != (q)->tail_cache ||                                                 \
+                   _h != ((q)->tail_cache = __atomic_load_n(&(q)->tail, __ATOMIC_ACQUIRE)); \
+        if (_ok) {                                                                          \
+            __typeof__((q)->data) _out = (out_p);                                           \
+            if (_out) *_out = (q)->data[_h & ((q)->capacity - 1)];                          \
+            __atomic_store_n(&(q)->head, _h + 1, __ATOMIC_RELEASE);                         \
+        }                                                                                   \
+        _ok;                                                                                \
+    })
+
+/**
+ * Push up to `n` items from a plain array and publish them at once.
+ * Producer thread only. Returns how many were pushed.
+ * Example:
+ *   `size_t sent = ds_spsc_push_many(&q, jobs, 32);`
+ */
+#define ds_spsc_push_many(q, items, n)                                                                  \
+    ({                                                                                                  \
+        size_t _sn = (n);                                                                               \
+        size_t _t = __atomic_load_n(&(q)->tail, __ATOMIC_RELAXED);                                      \
+        if ((q)->capacity - (_t - (q)->head_cache) < _sn)                                               \
+            (q)->head_cache = __atomic_load_n(&(q)->head, __ATOMIC_ACQUIRE);                            \
+        if (_sn > (q)->capacity - (_t - (q)->head_cache)) _sn = (q)->capacity - (_t - (q)->head_cache); \
+        if (_sn > 0) {                                                                                  \
+            ds__rb_write((q)->data, (q)->capacity, _t & ((q)->capacity - 1), (items), _sn,              \
+                         sizeof(*(q)->data));                                                           \
+            __atomic_store_n(&(q)->tail, _t + _sn, __ATOMIC_RELEASE);                                   \
+        }                                                                                               \
+        _sn;                                                                                            \
+    })
+
+/**
+ * Pop up to `n` items into `out` (or drop them if `out` is NULL) and
+ * release their slots at once. Consumer thread only. Returns how many
+ * were popped.
+ */
+#define ds_spsc_pop_many(q, out, n)                                                                      \
+    ({                                                                                                   \
+        size_t _sn = (n);                                                                                \
+        void *_sout = (out);                                                                             \
+        size_t _h = __atomic_load_n(&(q)->head, __ATOMIC_RELAXED);                                       \
+        if ((q)->tail_cache - _h < _sn) (q)->tail_cache = __atomic_load_n(&(q)->tail, __ATOMIC_ACQUIRE); \
+        if (_sn > (q)->tail_cache - _h) _sn = (q)->tail_cache - _h;                                      \
+        if (_sn > 0) {                                                                                   \
+            if (_sout)                                                                                   \
+                ds__rb_read((q)->data, (q)->capacity, _h & ((q)->capacity - 1), _sout, _sn,              \
+                            sizeof(*(q)->data));                                                         \
+            __atomic_store_n(&(q)->head, _h + _sn, __ATOMIC_RELEASE);                                    \
+        }                                                                                                \
+        _sn;                                                                                             \
+    })
+
+/**
+ * Number of items in the queue. Exact only when neither side is running.
+ */
+#define ds_spsc_length(q) \
+    (__atomic_load_n(&(q)->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&(q)->head, __ATOMIC_ACQUIRE))
+
+/**
+ * Free a queue. Not thread safe.
+ */
+#define ds_spsc_free(q)               \
+    do {                              \
+        DS_FREE((q)->data);           \
+        memset((q), 0, sizeof(*(q))); \
+    } while (0)
+
+/**
+ * Lock-free bounded multi-producer multi-consumer queue declaration.
+ * Dmitry Vyukov's design: every cell carries a sequence number telling
+ * whether it is ready to be written or read for the current lap, so a push
+ * or pop is one compare-and-swap on the shared enqueue or dequeue counter
+ * (each on its own cache line) and never waits on a lock. Any number of
+ * threads can push and pop.
+ * Example:
+ ```c
+ ds_mpmc_declare(WorkQueue, Job);
+ ...
+    WorkQueue q;
+    ds_mpmc_init(&q, 4096);
+    while (!ds_mpmc_push(&q, job)) sched_yield(); // any thread
+    ...
+    Job job;
+    while (ds_mpmc_pop(&q, &job)) run(job);       // any thread
+    ...
+    ds_mpmc_free(&q);
+ ```
+ */
+#define ds_mpmc_declare(name, type)             \
+    typedef struct {                            \
+        _Alignas(DS_CACHE_LINE) size_t enqueue; \
+        _Alignas(DS_CACHE_LINE) size_t dequeue; \
+        _Alignas(DS_CACHE_LINE) struct {        \
+            size_t seq;                         \
+            type val;                           \
+        } *cells;                               \
+        size_t capacity;                        \
+    } name
+
+/**
+ * Initialize a queue for at least `capacity` items (rounded up to a power
+ * of two, at least 2). Not thread safe.
+ */
+#define ds_mpmc_init(q, n)                                                                \
+    do {                                                                                  \
+        memset((q), 0, sizeof(*(q)));                                                     \
+        (q)->capacity = ds__pow2_ceil((n), 2); /* one cell cannot tell full from empty */ \
+        (q)->cells = DS_ALLOC((q)->capacity * sizeof(*(q)->cells));                       \
+        assert((q)->cells && "out of memory");                                            \
+        for (size_t _i = 0; _i < (q)->capacity; _i++) (q)->cells[_i].seq = _i;            \
+    } while (0)
+
+/**
+ * Push an item from any thread. Returns false if the queue is full.
+ */
+#define ds_mpmc_push(q, item)                                                                           \
+    ({                                                                                                  \
+        __typeof__((q)->cells->val) _v = (item);                                                        \
+        __typeof__((q)->cells) _c;                                                                      \
+        size_t _pos = __atomic_load_n(&(q)->enqueue, __ATOMIC_RELAXED);                                 \
+        bool _ok;                                                                                       \
+        for (;;) {                                                                                      \
+            _c = &(q)->cells[_pos & ((q)->capacity - 1)];                                               \
+            ptrdiff_t _d = (ptrdiff_t)(__atomic_load_n(&_c->seq, __ATOMIC_ACQUIRE) - _pos);             \
+            if (_d == 0) {                                                                              \
+                if (__atomic_compare_exchange_n(&(q)->enqueue, &_pos, _pos + 1, true, __ATOMIC_RELAXED, \
+                                                __ATOMIC_RELAXED)) {                                    \
+                    _ok = true;                                                                         \
+                    break;                                                                              \
+                }                                                                                       \
+            } else if (_d < 0) {                                                                        \
+                _ok = false; /* the cell still holds last lap's item */                                 \
+                break;                                                                                  \
+            } else {                                                                                    \
+                _pos = __atomic_load_n(&(q)->enqueue, __ATOMIC_RELAXED);                                \
+            }                                                                                           \
+        }                                                                                               \
+        if (_ok) {                                                                                      \
+            _c->val = _v;                                                                               \
+            __atomic_store_n(&_c->seq, _pos + 1, __ATOMIC_RELEASE);                                     \
+        }                                                                                               \
+        _ok;                                                                                            \
+    })
+
+/**
+ * Pop an item into `*out_p` (when not NULL) from any thread.
+ * Returns false if the queue is empty.
+ */
+#define ds_mpmc_pop(q, out_p)                                                                           \
+    ({                                                                                                  \
+        __typeof__((q)->cells) _c;                                                                      \
+        size_t _pos = __atomic_load_n(&(q)->dequeue, __ATOMIC_RELAXED);                                 \
+        bool _ok;                                                                                       \
+        for (;;) {                                                                                      \
+            _c = &(q)->cells[_pos & ((q)->capacity - 1)];                                               \
+            ptrdiff_t _d = (ptrdiff_t)(__atomic_load_n(&_c->seq, __ATOMIC_ACQUIRE) - (_pos + 1));       \
+            if (_d == 0) {                                                                              \
+                if (__atomic_compare_exchange_n(&(q)->dequeue, &_pos, _pos + 1, true, __ATOMIC_RELAXED, \
+                                                __ATOMIC_RELAXED)) {                                    \
+                    _ok = true;                                                                         \
+                    break;                                                                              \
+                }                                                                                       \
+            } else if (_d < 0) {                                                                        \
+                _ok = false; /* nothing written to the cell this lap yet */                             \
+                break;                                                                                  \
+            } else {                                                                                    \
+                _pos = __atomic_load_n(&(q)->dequeue, __ATOMIC_RELAXED);                                \
+            }                                                                                           \
+        }                                                                                               \
+        if (_ok) {                                                                                      \
+            __typeof__(&_c->val) _out = (out_p);                                                        \
+            if (_out) *_out = _c->val;                                                                  \
+            __atomic_store_n(&_c->seq, _pos + (q)->capacity, __ATOMIC_RELEASE);                         \
+        }                                                                                               \
+        _ok;                                                                                            \
+    })
+
+/**
+ * Free a queue. Not thread safe.
+ */
+#define ds_mpmc_free(q)               \
+    do {                              \
+        DS_FREE((q)->cells);          \
+        memset((q), 0, sizeof(*(q))); \
+    } while (0)
+
 /**
  * Read the entire contents of a file into a string builder.
  * Example:
@@ -1050,7 +4364,7 @@ typedef struct DsRRegion {
  * Arena allocator structure.
  * Better for allocating many small objects with similar lifetimes.
  */
-typedef struct {
+typedef struct DsArena {
     DsRegion *start, *end;
 } DsArena;
 
@@ -1100,6 +4414,16 @@ ds_a_free(&arena);
  */
 void ds_a_free(DsArena *a);
 void ds_a_rfree(DsRArena *a);
+/**
+ * Drop every allocation but keep the regions: later allocations reuse them.
+ * Example:
+```c
+DsArena arena = {0};
+int *arr = ds_a_malloc(&arena, 10 * sizeof(int));
+ds_a_reset(&arena); // arr is invalid, its memory is handed out again
+```
+ */
+void ds_a_reset(DsArena *a);
 void ds_a_rfree_one(DsRArena *a, void *ptr);
 
 /**
@@ -1187,6 +4511,12 @@ int closedir(DIR *dirp);
 #endif // DS_H_
 
 #ifdef DS_IMPLEMENTATION
+#ifndef _WIN32
+#include <pthread.h> // DS_HS_THREADS set operations
+#include <fcntl.h>   // ds_hm_save, ds_hm_map
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 int ds_log_level = DS_LOG_INFO;
 void ds_set_log_level(int level) {
@@ -1251,6 +4581,165 @@ void ds_set_log_handler(void (*handler)(int level, const char *fmt, ...)) {
     ds_log_handler = handler;
 }
 
+#if defined(DS_DA_LARGE_THRESHOLD) && !defined(_WIN32) && !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#if defined(DS_DA_LARGE_THRESHOLD) && !defined(_WIN32) && defined(MAP_ANONYMOUS)
+#if defined(__linux__) && !defined(MREMAP_MAYMOVE)
+/* declared by <sys/mman.h> only under _GNU_SOURCE */
+#define MREMAP_MAYMOVE 1
+void *mremap(void *old_address, size_t old_size, size_t new_size, int flags, ...);
+#endif
+#define DS__HUGE_PAGE ((size_t)2 << 20)
+
+static size_t ds__page_round(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) & ~(page - 1);
+}
+
+static void *ds__da_map(size_t size) {
+    size = ds__page_round(size);
+    size_t align = DS_DA_LARGE_HUGEPAGES && size >= DS__HUGE_PAGE ? DS__HUGE_PAGE : 0;
+    char *p = mmap(NULL, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    if (align) {
+        /* trim the extra to a huge page boundary on both sides */
+        size_t head = (align - ((uintptr_t)p & (align - 1))) & (align - 1);
+        if (head) munmap(p, head);
+        if (align - head) munmap(p + head + size, align - head);
+        p += head;
+#ifdef MADV_HUGEPAGE
+        madvise(p, size, MADV_HUGEPAGE);
+#endif
+    }
+    return p;
+}
+
+void *ds__da_realloc(void *data, size_t used, size_t old_size, size_t size) {
+    bool was_mapped = data && old_size >= DS_DA_LARGE_THRESHOLD;
+    bool mapped = size >= DS_DA_LARGE_THRESHOLD;
+    if (!was_mapped && !mapped) return DS_REALLOC(data, size);
+    if (was_mapped && mapped) {
+        if (ds__page_round(size) <= ds__page_round(old_size)) {
+            size_t keep = ds__page_round(size);
+            if (keep < ds__page_round(old_size)) munmap((char *)data + keep, ds__page_round(old_size) - keep);
+            return data;
+        }
+#ifdef __linux__
+        void *p = mremap(data, ds__page_round(old_size), ds__page_round(size), MREMAP_MAYMOVE);
+        return p == MAP_FAILED ? NULL : p;
+#endif
+    }
+    void *p = mapped ? ds__da_map(size) : DS_ALLOC(size);
+    if (!p) return NULL;
+    if (used) memcpy(p, data, used);
+    if (data) ds__da_free(data, old_size);
+    return p;
+}
+
+void ds__da_free(void *data, size_t size) {
+    if (size >= DS_DA_LARGE_THRESHOLD)
+        munmap(data, ds__page_round(size));
+    else
+        DS_FREE(data);
+}
+#elif defined(DS_DA_LARGE_THRESHOLD)
+void *ds__da_realloc(void *data, size_t used, size_t old_size, size_t size) {
+    DS_UNUSED(used);
+    DS_UNUSED(old_size);
+    return DS_REALLOC(data, size);
+}
+
+void ds__da_free(void *data, size_t size) {
+    DS_UNUSED(size);
+    DS_FREE(data);
+}
+#endif // DS_DA_LARGE_THRESHOLD
+
+void *ds__da_spill(const void *items, size_t used, size_t size) {
+    void *heap = DS__DA_REALLOC(NULL, 0, 0, size);
+    assert(heap && "out of memory");
+    memcpy(heap, items, used);
+    return heap;
+}
+
+/* the key at `p` as an unsigned integer in the same order */
+static inline uint64_t ds__radix_key(const unsigned char *p, size_t key_size, int kind) {
+    uint64_t k;
+    switch (key_size) {
+    case 1: {
+        uint8_t v;
+        memcpy(&v, p, 1);
+        k = v;
+    } break;
+    case 2: {
+        uint16_t v;
+        memcpy(&v, p, 2);
+        k = v;
+    } break;
+    case 4: {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        k = v;
+    } break;
+    default:
+        memcpy(&k, p, 8);
+        break;
+    }
+    uint64_t sign = 1ull << (key_size * 8 - 1);
+    if (kind == 1) return k ^ sign;
+    if (kind == 2) return k & sign ? ~k & (sign | (sign - 1)) : k | sign;
+    return k;
+}
+
+/* scatter `src` into `dst` by the key byte at `shift`; `size` is a
+   constant in the common cases so the copy inlines */
+#define DS__RADIX_SCATTER(size)                                                        \
+    for (size_t i = 0; i < n; i++) {                                                   \
+        const unsigned char *item = src + i * (size);                                  \
+        size_t d = (ds__radix_key(item + key_offset, key_size, kind) >> shift) & 0xff; \
+        memcpy(dst + offsets[d]++ * (size), item, (size));                             \
+    }
+
+void ds__radix_sort(void *data, size_t n, size_t size, size_t key_offset, size_t key_size, int kind) {
+    assert((key_size == 1 || key_size == 2 || key_size == 4 || key_size == 8) && "radix sort needs a numeric key");
+    if (n < 2) return;
+    size_t counts[8][256] = {0};
+    unsigned char *src = data;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t k = ds__radix_key(src + i * size + key_offset, key_size, kind);
+        for (size_t b = 0; b < key_size; b++) counts[b][(k >> (b * 8)) & 0xff]++;
+    }
+    uint64_t first = ds__radix_key(src + key_offset, key_size, kind);
+    unsigned char *buf = NULL, *dst = NULL;
+    for (size_t b = 0; b < key_size; b++) {
+        size_t shift = b * 8;
+        if (counts[b][(first >> shift) & 0xff] == n) continue; // all keys share this byte
+        if (!buf) {
+            buf = DS_ALLOC(n * size);
+            assert(buf && "out of memory");
+            dst = buf;
+        }
+        size_t offsets[256];
+        for (size_t d = 0, sum = 0; d < 256; d++) {
+            offsets[d] = sum;
+            sum += counts[b][d];
+        }
+        switch (size) {
+        case 4: DS__RADIX_SCATTER(4); break;
+        case 8: DS__RADIX_SCATTER(8); break;
+        case 16: DS__RADIX_SCATTER(16); break;
+        default: DS__RADIX_SCATTER(size); break;
+        }
+        unsigned char *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != data) memcpy(data, src, n * size);
+    DS_FREE(buf);
+}
+#undef DS__RADIX_SCATTER
+
 void ds__str_append(DsString *str, ...) {
     va_list args;
     va_start(args, str);
@@ -1304,109 +4793,651 @@ void ds_str_prependf(DsString *str, const char *fmt, ...) {
     }
 }
 
-void ds_str_insert(DsString *dstr, const char *str, size_t index) {
-    if (!dstr || !str || index > dstr->length) return;
-    size_t len = strlen(str);
-    ds_da_reserve(dstr, dstr->length + len + 1);
-    memmove(dstr->data + index + len, dstr->data + index, dstr->length - index);
-    memcpy(dstr->data + index, str, len);
-    dstr->length += len;
-    dstr->data[dstr->length] = '\0';
+void ds_str_insert(DsString *dstr, const char *str, size_t index) {
+    if (!dstr || !str || index > dstr->length) return;
+    size_t len = strlen(str);
+    ds_da_reserve(dstr, dstr->length + len + 1);
+    memmove(dstr->data + index + len, dstr->data + index, dstr->length - index);
+    memcpy(dstr->data + index, str, len);
+    dstr->length += len;
+    dstr->data[dstr->length] = '\0';
+}
+
+bool ds_str_include(const DsString *str, const char *substr) {
+    if (!str || !substr || str->length == 0 || strlen(substr) == 0) return false;
+    return strstr(str->data, substr) != NULL;
+}
+
+DsString *ds_str_ltrim(DsString *str) {
+    if (str && str->length > 0) {
+        size_t i = 0;
+        while (i < str->length && (str->data[i] == ' ' || str->data[i] == '\t' || str->data[i] == '\n' || str->data[i] == '\r')) {
+            i++;
+        }
+        if (i > 0) {
+            memmove(str->data, str->data + i, str->length - i + 1);
+            str->length -= i;
+        }
+    }
+    return str;
+}
+
+DsString *ds_str_rtrim(DsString *str) {
+    if (str && str->length > 0) {
+        size_t i = str->length;
+        while (i > 0 && (str->data[i - 1] == ' ' || str->data[i - 1] == '\t' || str->data[i - 1] == '\n' || str->data[i - 1] == '\r')) {
+            i--;
+        }
+        if (i < str->length) {
+            str->data[i] = '\0';
+            str->length = i;
+        }
+    }
+    return str;
+}
+
+/* 64x64 -> 128 bit multiply, low half in `a` and high half in `b` */
+static const uint64_t ds__wysecret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                         0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+static inline uint64_t ds__wyr8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t ds__wyr4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+size_t ds_wyhash(const void *data, size_t len, size_t seed) {
+    const uint8_t *p = data;
+    const uint64_t *s = ds__wysecret;
+    uint64_t h = (uint64_t)seed ^ ds__wymix((uint64_t)seed ^ s[0], s[1]);
+    uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            size_t o = (len >> 3) << 2;
+            a = (ds__wyr4(p) << 32) | ds__wyr4(p + o);
+            b = (ds__wyr4(p + len - 4) << 32) | ds__wyr4(p + len - 4 - o);
+        } else if (len > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t h1 = h, h2 = h;
+            do {
+                h = ds__wymix(ds__wyr8(p) ^ s[1], ds__wyr8(p + 8) ^ h);
+                h1 = ds__wymix(ds__wyr8(p + 16) ^ s[2], ds__wyr8(p + 24) ^ h1);
+                h2 = ds__wymix(ds__wyr8(p + 32) ^ s[3], ds__wyr8(p + 40) ^ h2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            h ^= h1 ^ h2;
+        }
+        while (i > 16) {
+            h = ds__wymix(ds__wyr8(p) ^ s[1], ds__wyr8(p + 8) ^ h);
+            p += 16;
+            i -= 16;
+        }
+        a = ds__wyr8(p + i - 16);
+        b = ds__wyr8(p + i - 8);
+    }
+    a ^= s[1];
+    b ^= h;
+    ds__wymum(&a, &b);
+    return (size_t)ds__wymix(a ^ s[0] ^ len, b ^ s[1]);
+}
+
+size_t ds_fnv1a(const void *data, size_t len, size_t seed) {
+    const unsigned char *p = data;
+    uint64_t hash = 0xcbf29ce484222325ull ^ seed;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull; // 64-bit FNV prime
+    }
+    return (size_t)hash;
+}
+
+size_t ds__hash_string(const void *entry, size_t key_size, size_t seed) {
+    DS_UNUSED(key_size);
+    const char *str = *(const char *const *)entry;
+    if (!str) return seed;
+    return DS_HASH_FN(str, strlen(str), seed);
+}
+
+size_t ds__hash_bytes(const void *entry, size_t key_size, size_t seed) {
+    if (!entry || key_size == 0) return seed;
+    switch (key_size) {
+    case 4: {
+        uint32_t v;
+        memcpy(&v, entry, sizeof(v));
+        return DS_HASH_INT_FN(v, seed);
+    }
+    case 8: {
+        uint64_t v;
+        memcpy(&v, entry, sizeof(v));
+        return DS_HASH_INT_FN(v, seed);
+    }
+    default:
+        return DS_HASH_FN(entry, key_size, seed);
+    }
+}
+
+int ds__eq_bytes(const void *entry, const void *user_key, size_t key_size) {
+    return memcmp(entry, user_key, key_size) == 0;
+}
+
+int ds__eq_sv(const void *entry, const void *user_key, size_t key_size) {
+    DS_UNUSED(key_size);
+    const char *str = *(const char *const *)entry;
+    const DsStringIterator *sv = user_key;
+    if (!str || !sv->data) return str == sv->data;
+    size_t len;
+    memcpy(&len, str - DS__KEY_PREFIX, sizeof(len));
+    return len == sv->length && memcmp(str, sv->data, len) == 0;
+}
+
+int ds__eq_str(const void *entry, const void *user_key, size_t key_size) {
+    DS_UNUSED(key_size);
+    const char *str = *(const char *const *)entry;
+    const char *key = user_key;
+    if (str == key) return 1;
+    if (!str || !key) return 0;
+    return strcmp(str, key) == 0;
+}
+
+
+
+static inline void ds__table_set_idx(struct ds__ht_idxs *table, size_t slot, size_t idx) {
+    switch (table->width) {
+    case 1: ((uint8_t *)table->data)[slot] = (uint8_t)idx; break;
+    case 2: ((uint16_t *)table->data)[slot] = (uint16_t)idx; break;
+    case 4: ((uint32_t *)table->data)[slot] = (uint32_t)idx; break;
+    default: ((uint64_t *)table->data)[slot] = idx; break;
+    }
+}
+
+/* Smallest index width able to address `capacity` entries */
+static inline uint8_t ds__table_width(size_t capacity) {
+    if (capacity <= (1ull << 8)) return 1;
+    if (capacity <= (1ull << 16)) return 2;
+    if ((uint64_t)capacity <= (1ull << 32)) return 4;
+    return 8;
+}
+
+
+static inline void ds__table_set_ctrl(struct ds__ht_idxs *table, size_t slot, uint8_t c) {
+    ds__table_ctrl(table)[slot] = c;
+    for (size_t m = slot + table->capacity; m < table->capacity + DS__GROUP_WIDTH; m += table->capacity)
+        ds__table_ctrl(table)[m] = c;
+}
+
+/* First empty slot at or after `slot` */
+static inline size_t ds__table_find_empty(const struct ds__ht_idxs *table, size_t slot) {
+    size_t mask = table->capacity - 1;
+    for (;;) {
+        uint64_t empty = ds__group_match_empty(ds__table_ctrl(table) + slot);
+        if (empty) return (slot + ds__group_lane(empty)) & mask;
+        slot = (slot + DS__GROUP_WIDTH) & mask;
+    }
+}
+
+
+/* Entry the first control byte matching `key_hash` points to, or NULL */
+static inline size_t ds__frozen_pos(const struct ds__ht_idxs *t, size_t n, size_t key_hash);
+
+const void *ds__table_entry_guess(const struct ds__ht *ht, size_t entry_size, size_t key_hash) {
+    const struct ds__ht_idxs *t = &ht->table;
+    if (!t->capacity) return NULL;
+    if (t->flags & DS__HT_FROZEN) return (const char *)ht->data + ds__frozen_pos(t, ht->length, key_hash) * entry_size;
+    size_t mask = t->capacity - 1;
+    size_t pos = key_hash & mask;
+    uint64_t match = ds__group_match(ds__table_ctrl(t) + pos, ds__ht_h2(key_hash));
+    if (!match) return NULL;
+    size_t idx = ds__table_idx(t, (pos + ds__group_lane(match)) & mask);
+    return (const char *)ht->data + idx * entry_size;
+}
+
+/* Robin Hood insert: skip the entries at least as far from their home as
+ * the new one is from its own, then shift the rest of the cluster one slot
+ * forward to make room. `hashes` are the stored hashes of the entries. */
+static size_t ds__table_insert_rh(struct ds__ht_idxs *t, const size_t *hashes, size_t key_hash, size_t idx) {
+    size_t mask = t->capacity - 1;
+    size_t pos = key_hash & mask, dist = 0;
+    while (ds__table_ctrl(t)[pos] != DS__CTRL_EMPTY &&
+           ((pos - hashes[ds__table_idx(t, pos)]) & mask) >= dist) {
+        pos = (pos + 1) & mask;
+        dist++;
+    }
+    size_t longest = dist;
+    for (size_t j = ds__table_find_empty(t, pos); j != pos; j = (j - 1) & mask) {
+        size_t prev = (j - 1) & mask;
+        size_t moved = ds__table_idx(t, prev);
+        size_t d = (j - hashes[moved]) & mask;
+        if (d > longest) longest = d;
+        ds__table_set_idx(t, j, moved);
+        ds__table_set_ctrl(t, j, ds__table_ctrl(t)[prev]);
+    }
+    ds__table_set_idx(t, pos, idx);
+    ds__table_set_ctrl(t, pos, ds__ht_h2(key_hash));
+    if (longest > ds__ht_max_probe(t)) ds__table_extra(t)->max_probe = longest;
+    return pos;
+}
+
+size_t ds__table_insert(struct ds__ht_idxs *table, size_t slot, size_t key_hash, size_t idx) {
+    struct ds__ht_extra *x = table->extra;
+    if (x && x->hashes) x->hashes[idx] = key_hash;
+    if (x && x->bloom) ds_bloom_add_hash(x->bloom, key_hash);
+    /* the Robin Hood slot depends on the cluster order, not on the probe */
+    if (table->flags & DS__HT_ROBIN_HOOD) return ds__table_insert_rh(table, x->hashes, key_hash, idx);
+    ds__table_set_idx(table, slot, idx);
+    ds__table_set_ctrl(table, slot, ds__ht_h2(key_hash));
+    return slot;
+}
+
+static inline size_t ds__table_entry_hash(const struct ds__ht *ht, size_t entry_size, size_t key_size, ds_entry_hash_fn hash_fn, size_t idx) {
+    const size_t *hashes = ds__ht_hashes(&ht->table);
+    if (hashes) return hashes[idx];
+    return hash_fn((const char *)ht->data + idx * entry_size, key_size, ht->seed);
+}
+
+/* (1 - (31/32)^j)^8: false positive rate of a block holding j keys */
+static double ds__bloom_block_fpp(size_t j) {
+    double q = 1, x = 31.0 / 32.0;
+    for (size_t n = j; n; n >>= 1, x *= x) {
+        if (n & 1) q *= x;
+    }
+    double p = 1 - q;
+    p *= p;
+    p *= p;
+    return p * p;
+}
+
+/* Expected false positive rate with `lambda` keys per block on average:
+ * the block loads are Poisson, weighted relative to the mode (no libm). */
+static double ds__bloom_fpp(double lambda) {
+    size_t mode = (size_t)lambda;
+    double total = 0, fp = 0, w = 1;
+    for (size_t j = mode; w > 1e-12; j++) {
+        total += w;
+        fp += w * ds__bloom_block_fpp(j);
+        w *= lambda / (double)(j + 1);
+    }
+    w = 1;
+    for (size_t j = mode; j > 0 && w > 1e-12; j--) {
+        w *= (double)j / lambda;
+        total += w;
+        fp += w * ds__bloom_block_fpp(j - 1);
+    }
+    return fp / total;
+}
+
+void ds_bloom_init(DsBloom *bf, size_t expected, double fpp) {
+    assert(fpp > 0 && fpp < 1);
+    if (expected == 0) expected = 1;
+    /* double, then bisect, the block count until the rate is met */
+    size_t lo = 0, hi = expected / 64 + 1;
+    while (ds__bloom_fpp((double)expected / (double)hi) > fpp) {
+        lo = hi;
+        hi *= 2;
+    }
+    while (hi - lo > 1 && hi - lo > hi / 256) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ds__bloom_fpp((double)expected / (double)mid) > fpp) lo = mid;
+        else hi = mid;
+    }
+    size_t bytes = hi * DS__BLOOM_WORDS * sizeof(uint32_t);
+    bf->mem = DS_ALLOC(bytes + 31);
+    assert(bf->mem != NULL);
+    bf->blocks = (uint32_t *)(((uintptr_t)bf->mem + 31) & ~(uintptr_t)31);
+    bf->block_count = hi;
+    bf->capacity = expected;
+    bf->fpp = fpp;
+    ds_bloom_clear(bf);
+}
+
+void ds_bloom_clear(DsBloom *bf) {
+    if (bf->blocks) memset(bf->blocks, 0, bf->block_count * DS__BLOOM_WORDS * sizeof(uint32_t));
 }
 
-bool ds_str_include(const DsString *str, const char *substr) {
-    if (!str || !substr || str->length == 0 || strlen(substr) == 0) return false;
-    return strstr(str->data, substr) != NULL;
+void ds_bloom_free(DsBloom *bf) {
+    DS_FREE(bf->mem);
+    memset(bf, 0, sizeof(*bf));
 }
 
-DsString *ds_str_ltrim(DsString *str) {
-    if (str && str->length > 0) {
-        size_t i = 0;
-        while (i < str->length && (str->data[i] == ' ' || str->data[i] == '\t' || str->data[i] == '\n' || str->data[i] == '\r')) {
-            i++;
-        }
-        if (i > 0) {
-            memmove(str->data, str->data + i, str->length - i + 1);
-            str->length -= i;
-        }
+/* (re)build the table's filter for the current index size from every entry */
+void ds__table_bloom(struct ds__ht *ht, size_t entry_size, size_t key_size, ds_entry_hash_fn hash_fn, double fpp) {
+    struct ds__ht_idxs *t = &ht->table;
+    struct ds__ht_extra *x = ds__table_extra(t);
+    if (x->bloom) {
+        ds_bloom_free(x->bloom);
+    } else {
+        x->bloom = DS_ALLOC(sizeof(DsBloom));
+        assert(x->bloom != NULL);
     }
-    return str;
+    size_t expected = (size_t)((t->capacity ? t->capacity : DS_HM_INIT_CAPACITY) * DS_HM_LOAD_FACTOR);
+    if (expected < ht->length) expected = ht->length;
+    ds_bloom_init(x->bloom, expected, fpp);
+    for (size_t i = 0; i < ht->length; i++)
+        ds_bloom_add_hash(x->bloom, ds__table_entry_hash(ht, entry_size, key_size, hash_fn, i));
 }
 
-DsString *ds_str_rtrim(DsString *str) {
-    if (str && str->length > 0) {
-        size_t i = str->length;
-        while (i > 0 && (str->data[i - 1] == ' ' || str->data[i - 1] == '\t' || str->data[i - 1] == '\n' || str->data[i - 1] == '\r')) {
-            i--;
+/* Backward-shift deletion of `slot` in `t`: pull later cluster members into
+ * the hole unless their home slot lies cyclically between the hole and them */
+static void ds__table_erase(const struct ds__ht *ht, struct ds__ht_idxs *t, size_t entry_size, size_t key_size, ds_entry_hash_fn hash_fn, size_t slot) {
+    size_t mask = t->capacity - 1;
+    size_t hole = slot;
+    for (size_t j = (slot + 1) & mask; ds__table_ctrl(t)[j] != DS__CTRL_EMPTY; j = (j + 1) & mask) {
+        size_t moved = ds__table_idx(t, j);
+        size_t home = ds__table_entry_hash(ht, entry_size, key_size, hash_fn, moved) & mask;
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            ds__table_set_idx(t, hole, moved);
+            ds__table_set_ctrl(t, hole, ds__table_ctrl(t)[j]);
+            hole = j;
+        } else if (t->flags & DS__HT_ROBIN_HOOD) {
+            break; /* later entries have later homes: none of them moves */
         }
-        if (i < str->length) {
-            str->data[i] = '\0';
-            str->length = i;
+    }
+    ds__table_set_ctrl(t, hole, DS__CTRL_EMPTY);
+}
+
+/* Repoint the slot of entry `from` (with hash `h`) to entry `to` */
+static bool ds__table_repoint(struct ds__ht_idxs *t, size_t h, size_t from, size_t to) {
+    size_t mask = t->capacity - 1;
+    size_t pos = h & mask;
+    uint8_t h2 = ds__ht_h2(h);
+    for (;;) {
+        const uint8_t *group = ds__table_ctrl(t) + pos;
+        uint64_t empty = ds__group_match_empty(group);
+        uint64_t match = ds__group_match(group, h2);
+        if (empty) match &= (empty & (0 - empty)) - 1;
+        for (; match; match &= match - 1) {
+            size_t s = (pos + ds__group_lane(match)) & mask;
+            if (ds__table_idx(t, s) == from) {
+                ds__table_set_idx(t, s, to);
+                return true;
+            }
         }
+        if (empty) return false;
+        pos = (pos + DS__GROUP_WIDTH) & mask;
     }
-    return str;
 }
 
-size_t ds__hash_string(const void *entry, size_t key_size, size_t seed) {
-    DS_UNUSED(key_size);
-    const char *str = *(const char *const *)entry;
-    if (!str || !*str) return seed ? seed : 0;
+/* Move up to `steps` old slots into the current table (stored hashes only) */
+static void ds__table_migrate(struct ds__ht *ht, size_t steps) {
+    struct ds__ht_migration *m = ht->table.extra->old;
+    struct ds__ht_idxs *t = &ht->table;
+    size_t mask = t->capacity - 1;
+    while (steps-- && m->pos < m->table.capacity) {
+        if (ds__table_ctrl(&m->table)[m->pos] == DS__CTRL_EMPTY) {
+            m->pos++;
+            continue;
+        }
+        /* erasing may shift a later entry into `pos`, so it is not advanced */
+        size_t idx = ds__table_idx(&m->table, m->pos);
+        size_t h = t->extra->hashes[idx];
+        ds__table_insert(t, ds__table_find_empty(t, h & mask), h, idx);
+        ds__table_erase(ht, &m->table, 0, 0, NULL, m->pos);
+    }
+    if (m->pos == m->table.capacity) {
+        DS_FREE(m->table.data);
+        DS_FREE(m);
+        t->extra->old = NULL;
+    }
+}
 
-    size_t hash = seed ? seed : 5381;
+static int ds__eq_str_mapped(const void *entry, const void *user_key, size_t key_size);
+static int ds__eq_sv_mapped(const void *entry, const void *user_key, size_t key_size);
 
-    // DJB2 hash algorithm - simple, fast, and well-distributed
-    int c;
-    while ((c = *str++)) {
-        hash = ((hash << 5) + hash) + c; // hash * 33 + c
+static bool ds__table_lookup(struct ds__ht *ht, size_t entry_size, size_t key_size, const void *user_key, size_t key_hash, ds_entry_eq_fn eq_fn, size_t *out_slot, size_t *out_idx) {
+    if (ht->table.flags & DS__HT_MAPPED) {
+        /* string keys of an image are offsets */
+        if (eq_fn == ds__eq_str) eq_fn = ds__eq_str_mapped;
+        else if (eq_fn == ds__eq_sv) eq_fn = ds__eq_sv_mapped;
+    }
+    if (ht->table.flags & DS__HT_FROZEN) {
+        size_t idx = ds__frozen_pos(&ht->table, ht->length, key_hash);
+        DS__HT_COUNT(ht, probes, 1);
+        *out_slot = *out_idx = idx;
+        return eq_fn((const char *)ht->data + idx * entry_size, user_key, key_size);
+    }
+    if (!ht->table.capacity) return false;
+    if (!ds__ht_old(&ht->table)) return ds__table_probe(ht, &ht->table, entry_size, key_size, user_key, key_hash, eq_fn, out_slot, out_idx);
+
+    ds__table_migrate(ht, DS_HM_MIGRATE_STEP);
+    if (ds__table_probe(ht, &ht->table, entry_size, key_size, user_key, key_hash, eq_fn, out_slot, out_idx)) return true;
+    struct ds__ht_migration *m = ht->table.extra->old;
+    size_t old_slot;
+    if (m && ds__table_probe(ht, &m->table, entry_size, key_size, user_key, key_hash, eq_fn, &old_slot, out_idx)) {
+        /* found in the old table: move it over so the slot refers to the current one */
+        *out_slot = ds__table_insert(&ht->table, *out_slot, key_hash, *out_idx);
+        ds__table_erase(ht, &m->table, 0, 0, NULL, old_slot);
+        return true;
     }
+    return false;
+}
 
-    return hash;
+bool ds__table_find(struct ds__ht *ht, size_t entry_size, size_t key_size, const void *user_key, size_t key_hash, ds_entry_eq_fn eq_fn, size_t *out_slot, size_t *out_idx) {
+    bool found = ds__table_lookup(ht, entry_size, key_size, user_key, key_hash, eq_fn, out_slot, out_idx);
+    DS__HT_COUNT(ht, lookups, 1);
+    DS__HT_COUNT(ht, misses, !found);
+    return found;
 }
 
-size_t ds__hash_bytes(const void *entry, size_t key_size, size_t seed) {
-    if (!entry || key_size == 0) return seed;
+/* the user key of a set value, as ds__table_find takes it */
+static inline const void *ds__hs_key(const void *entry, bool cstr) {
+    return cstr ? *(const char *const *)entry : entry;
+}
 
-    const unsigned char *data = (const unsigned char *)entry;
-    size_t hash = seed ? seed : 5381;
+/* Hash the values [b, b + m) of `src` for lookups in `dst` and prefetch
+ * their slots, then their likely entries. Stored hashes are reused when
+ * both sets hash with the same seed. */
+static void ds__hs_hash_batch(const struct ds__ht *dst, const struct ds__ht *src, size_t b, size_t m, size_t entry_size, ds_entry_hash_fn hash_fn, size_t *hs) {
+    const size_t *stored = ds__ht_hashes(&src->table);
+    bool reuse = stored && src->seed == dst->seed;
+    bool pf = dst->table.capacity >= DS_HM_PREFETCH_MIN_CAPACITY;
+    for (size_t i = 0; i < m; i++) {
+        hs[i] = reuse ? stored[b + i]
+                      : hash_fn((const char *)src->data + (b + i) * entry_size, entry_size, dst->seed);
+        if (pf) ds__table_prefetch(&dst->table, hs[i]);
+    }
+    for (size_t i = 0; pf && i < m; i++)
+        DS__PREFETCH(ds__table_entry_guess(dst, entry_size, hs[i]));
+}
 
-    // FNV-1a hash algorithm
-    for (size_t i = 0; i < key_size; i++) {
-        hash ^= data[i];
-        hash *= 0x01000193; // FNV prime
+void ds__hs_cat(struct ds__ht *set, struct ds__ht *other, size_t entry_size, ds_entry_hash_fn hash_fn, ds_entry_eq_fn eq_fn, bool cstr) {
+    /* room was reserved for both sets: no resize checks */
+    size_t hs[DS_HM_BATCH];
+    for (size_t b = 0; b < other->length; b += DS_HM_BATCH) {
+        size_t m = other->length - b < DS_HM_BATCH ? other->length - b : DS_HM_BATCH;
+        ds__hs_hash_batch(set, other, b, m, entry_size, hash_fn, hs);
+        for (size_t i = 0; i < m; i++) {
+            const char *entry = (const char *)other->data + (b + i) * entry_size;
+            size_t slot = 0, idx;
+            if (ds__table_find(set, entry_size, entry_size, ds__hs_key(entry, cstr), hs[i], eq_fn, &slot, &idx)) continue;
+            memcpy((char *)set->data + set->length * entry_size, entry, entry_size);
+            ds__table_insert(&set->table, slot, hs[i], set->length++);
+        }
     }
+}
+
+/* A walk of `scan` looking its values up in `probe`. `marks` (optional)
+ * gets a bit per value of the set being filtered: the scanned index, or
+ * the index found in `probe` when `mark_probe`. */
+struct ds__hs_walk {
+    struct ds__ht *scan;
+    struct ds__ht *probe;
+    size_t entry_size;
+    ds_entry_hash_fn hash_fn;
+    ds_entry_eq_fn eq_fn;
+    bool cstr;
+    bool mark_probe;
+    bool atomic;
+    uint64_t *marks;
+    size_t begin;
+    size_t end;
+    size_t found;
+};
 
-    return hash;
+static void ds__hs_walk_range(struct ds__hs_walk *w) {
+    size_t hs[DS_HM_BATCH];
+    for (size_t b = w->begin; b < w->end; b += DS_HM_BATCH) {
+        size_t m = w->end - b < DS_HM_BATCH ? w->end - b : DS_HM_BATCH;
+        ds__hs_hash_batch(w->probe, w->scan, b, m, w->entry_size, w->hash_fn, hs);
+        for (size_t i = 0; i < m; i++) {
+            const char *entry = (const char *)w->scan->data + (b + i) * w->entry_size;
+            size_t slot, idx;
+            if (!ds__table_find(w->probe, w->entry_size, w->entry_size, ds__hs_key(entry, w->cstr), hs[i], w->eq_fn, &slot, &idx)) continue;
+            w->found++;
+            if (!w->marks) continue;
+            size_t bit = w->mark_probe ? idx : b + i;
+            if (w->atomic) __atomic_fetch_or(&w->marks[bit / 64], (uint64_t)1 << (bit % 64), __ATOMIC_RELAXED);
+            else w->marks[bit / 64] |= (uint64_t)1 << (bit % 64);
+        }
+    }
 }
 
-int ds__eq_bytes(const void *entry, const void *user_key, size_t key_size) {
-    return memcmp(entry, user_key, key_size) == 0;
+#ifdef _WIN32
+static DWORD WINAPI ds__hs_walk_thread(LPVOID arg) {
+    ds__hs_walk_range(arg);
+    return 0;
+}
+#else
+static void *ds__hs_walk_thread(void *arg) {
+    ds__hs_walk_range(arg);
+    return NULL;
 }
+#endif
 
-int ds__eq_str(const void *entry, const void *user_key, size_t key_size) {
-    DS_UNUSED(key_size);
-    const char *str = *(const char *const *)entry;
-    const char *key = user_key;
-    if (str == key) return 1;
-    if (!str || !key) return 0;
-    return strcmp(str, key) == 0;
+/* Walk the smaller of `set` and `other` looking its values up in the
+ * larger one, in DS_HS_THREADS slices when it is large. `marks` (optional,
+ * zeroed, a bit per value of `set`) gets the values of `set` found in
+ * `other`. Returns how many were found. */
+static size_t ds__hs_overlap(struct ds__ht *set, struct ds__ht *other, size_t entry_size, ds_entry_hash_fn hash_fn, ds_entry_eq_fn eq_fn, bool cstr, uint64_t *marks) {
+    /* lookups must not migrate entries: finish pending resizes first */
+    if (ds__ht_old(&set->table)) ds__table_migrate(set, SIZE_MAX);
+    if (ds__ht_old(&other->table)) ds__table_migrate(other, SIZE_MAX);
+    bool scan_set = set->length <= other->length;
+    struct ds__hs_walk w = {
+        .scan = scan_set ? set : other,
+        .probe = scan_set ? other : set,
+        .entry_size = entry_size,
+        .hash_fn = hash_fn,
+        .eq_fn = eq_fn,
+        .cstr = cstr,
+        .mark_probe = !scan_set,
+        .marks = marks,
+        .end = scan_set ? set->length : other->length,
+    };
+    size_t threads = w.end >= DS_HS_PARALLEL_MIN && DS_HS_THREADS > 1 ? DS_HS_THREADS : 1;
+    if (threads == 1) {
+        ds__hs_walk_range(&w);
+        return w.found;
+    }
+    struct ds__hs_walk jobs[DS_HS_THREADS > 1 ? DS_HS_THREADS : 1];
+#ifdef _WIN32
+    HANDLE handles[DS_HS_THREADS > 1 ? DS_HS_THREADS : 1];
+#else
+    pthread_t handles[DS_HS_THREADS > 1 ? DS_HS_THREADS : 1];
+#endif
+    bool started[DS_HS_THREADS > 1 ? DS_HS_THREADS : 1];
+    /* slices of whole mark words, so only marks of found indices are shared */
+    size_t slice = (w.end / threads + 63) & ~(size_t)63;
+    for (size_t t = 0; t < threads; t++) {
+        jobs[t] = w;
+        jobs[t].atomic = w.mark_probe;
+        jobs[t].begin = t * slice < w.end ? t * slice : w.end;
+        jobs[t].end = t + 1 == threads || (t + 1) * slice > w.end ? w.end : (t + 1) * slice;
+        started[t] = false;
+        if (t + 1 == threads) break; /* the last slice runs here */
+#ifdef _WIN32
+        handles[t] = CreateThread(NULL, 0, ds__hs_walk_thread, &jobs[t], 0, NULL);
+        started[t] = handles[t] != NULL;
+#else
+        started[t] = pthread_create(&handles[t], NULL, ds__hs_walk_thread, &jobs[t]) == 0;
+#endif
+    }
+    size_t found = 0;
+    for (size_t t = 0; t < threads; t++) {
+        if (!started[t]) {
+            ds__hs_walk_range(&jobs[t]);
+        } else {
+#ifdef _WIN32
+            WaitForSingleObject(handles[t], INFINITE);
+            CloseHandle(handles[t]);
+#else
+            pthread_join(handles[t], NULL);
+#endif
+        }
+        found += jobs[t].found;
+    }
+    return found;
 }
 
-bool ds__table_find(const struct ds__ht *ht, size_t entry_size, size_t key_size, const void *user_key, size_t key_hash, ds_entry_eq_fn eq_fn, size_t *out_slot, size_t *out_idx) {
-    if (!ht->table.capacity) return false;
-    size_t mask = ht->table.capacity - 1;
-    size_t slot = key_hash & mask;
-    while (ht->table.data[slot] != 0) {
-        size_t idx = ht->table.data[slot] - 1;
-        const void *entry = (const char *)ht->data + idx * entry_size;
-        if (eq_fn(entry, user_key, key_size)) {
-            *out_slot = slot;
-            *out_idx = idx;
-            return true;
+/* Keep the values of `set` that are (`keep_found`) or are not in `other`:
+ * mark them, compact the data array in place and rebuild the index. */
+static void ds__hs_filter(struct ds__ht *set, struct ds__ht *other, size_t entry_size, ds_entry_hash_fn hash_fn, ds_entry_eq_fn eq_fn, bool cstr, bool keep_found) {
+    if (!set->length) return;
+    size_t words = (set->length + 63) / 64;
+    uint64_t *marks = DS_ALLOC(words * sizeof(uint64_t));
+    assert(marks != NULL);
+    memset(marks, 0, words * sizeof(uint64_t));
+    size_t found = ds__hs_overlap(set, other, entry_size, hash_fn, eq_fn, cstr, marks);
+    if (found == (keep_found ? set->length : 0)) {
+        DS_FREE(marks);
+        return;
+    }
+    size_t *hashes = ds__ht_hashes(&set->table);
+    size_t n = 0;
+    for (size_t i = 0; i < set->length; i++) {
+        if ((bool)((marks[i / 64] >> (i % 64)) & 1) != keep_found) continue;
+        if (n != i) {
+            memcpy((char *)set->data + n * entry_size, (char *)set->data + i * entry_size, entry_size);
+            if (hashes) hashes[n] = hashes[i];
         }
-        slot = (slot + 1) & mask;
+        n++;
     }
-    *out_slot = slot;
-    return false;
+    DS_FREE(marks);
+    set->length = n;
+    ds__table_resize(set, entry_size, entry_size, hash_fn, set->table.capacity);
+}
+
+void ds__hs_sub(struct ds__ht *set, struct ds__ht *other, size_t entry_size, ds_entry_hash_fn hash_fn, ds_entry_eq_fn eq_fn, bool cstr) {
+    if (!set->length || !other->length) return;
+    if (other->length * 8 >= set->length) {
+        ds__hs_filter(set, other, entry_size, hash_fn, eq_fn, cstr, false);
+        return;
+    }
+    /* few values to remove: find and remove them one by one */
+    if (set->table.flags & DS__HT_FROZEN) ds__table_resize(set, entry_size, entry_size, hash_fn, set->table.capacity);
+    size_t hs[DS_HM_BATCH];
+    for (size_t b = 0; b < other->length; b += DS_HM_BATCH) {
+        size_t m = other->length - b < DS_HM_BATCH ? other->length - b : DS_HM_BATCH;
+        ds__hs_hash_batch(set, other, b, m, entry_size, hash_fn, hs);
+        for (size_t i = 0; i < m; i++) {
+            const char *entry = (const char *)other->data + (b + i) * entry_size;
+            size_t slot, idx;
+            if (!ds__table_find(set, entry_size, entry_size, ds__hs_key(entry, cstr), hs[i], eq_fn, &slot, &idx)) continue;
+            set->length--;
+            memcpy((char *)set->data + idx * entry_size, (char *)set->data + set->length * entry_size, entry_size);
+            ds__table_remove_slot(set, entry_size, entry_size, hash_fn, slot, idx);
+        }
+    }
+}
+
+void ds__hs_intersect(struct ds__ht *set, struct ds__ht *other, size_t entry_size, ds_entry_hash_fn hash_fn, ds_entry_eq_fn eq_fn, bool cstr) {
+    ds__hs_filter(set, other, entry_size, hash_fn, eq_fn, cstr, true);
+}
+
+size_t ds__hs_intersect_count(struct ds__ht *set, struct ds__ht *other, size_t entry_size, ds_entry_hash_fn hash_fn, ds_entry_eq_fn eq_fn, bool cstr) {
+    return ds__hs_overlap(set, other, entry_size, hash_fn, eq_fn, cstr, NULL);
 }
 
 size_t ds__ht_fit_capacity(size_t length) {
@@ -1418,7 +5449,7 @@ size_t ds__ht_fit_capacity(size_t length) {
     return cap;
 }
 
-void ds__ht_copy_key(void *dst, const void *src, size_t key_size, bool is_cstr_key) {
+void ds__ht_copy_key(struct ds__ht_idxs *table, void *dst, const void *src, size_t key_size, bool is_cstr_key) {
     if (!is_cstr_key) {
         memcpy(dst, src, key_size);
         return;
@@ -1426,79 +5457,743 @@ void ds__ht_copy_key(void *dst, const void *src, size_t key_size, bool is_cstr_k
 
     const char *str = NULL;
     memcpy(&str, src, sizeof(str));
-    if (!str) {
-        memset(dst, 0, key_size);
-        return;
-    }
+    ds__ht_copy_key_n(table, dst, str, str ? strlen(str) : 0);
+}
 
-    size_t len = strlen(str) + 1;
-    char *copy = DS_ALLOC(len);
-    assert(copy != NULL);
-    memcpy(copy, str, len);
+void ds__ht_copy_key_n(struct ds__ht_idxs *table, void *dst, const char *str, size_t len) {
+    char *copy = NULL;
+    if (str) {
+        DsArena *keys = ds__ht_keys(table);
+        if ((table->flags & DS__HT_OWN_KEYS) && !keys) {
+            keys = ds__table_extra(table)->keys = DS_ALLOC(sizeof(DsArena));
+            assert(keys != NULL);
+            memset(keys, 0, sizeof(DsArena));
+        }
+        size_t size = DS__KEY_PREFIX + len + 1;
+        char *block = keys ? ds_a_malloc(keys, size) : DS_ALLOC(size);
+        assert(block != NULL);
+        memcpy(block, &len, sizeof(len));
+        copy = block + DS__KEY_PREFIX;
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
     memcpy(dst, &copy, sizeof(copy));
 }
 
-void ds__ht_free_key(void *key, bool is_cstr_key) {
-    if (!is_cstr_key) return;
+void ds__ht_free_key(struct ds__ht_idxs *table, void *key, bool is_cstr_key) {
+    /* arena keys go with the arena, borrowed ones stay with the caller */
+    if (!is_cstr_key || ds__ht_keys(table) || (table->flags & DS__HT_BORROWED)) return;
 
-    void *ptr = NULL;
+    char *ptr = NULL;
     memcpy(&ptr, key, sizeof(ptr));
-    DS_FREE(ptr);
+    if (ptr) DS_FREE(ptr - DS__KEY_PREFIX);
 }
 
-void ds__ht_free_cstr_keys(void *ht, size_t entry_size) {
+void ds__ht_free_cstr_keys(void *ht, size_t entry_size, bool reuse) {
     struct ds__ht *h = ht;
+    struct ds__ht_idxs *t = &h->table;
+    if (t->flags & DS__HT_BORROWED) return;
+    DsArena *keys = ds__ht_keys(t);
+    if (keys) {
+        if (!(t->flags & DS__HT_OWN_KEYS)) return;
+        if (reuse) {
+            ds_a_reset(keys);
+        } else {
+            ds_a_free(keys);
+            DS_FREE(keys);
+            t->extra->keys = NULL;
+        }
+        return;
+    }
     for (size_t i = 0; i < h->length; i++) {
         void *entry = (char *)h->data + i * entry_size;
-        ds__ht_free_key(entry, true);
+        ds__ht_free_key(t, entry, true);
     }
 }
 
 void ds__table_resize(struct ds__ht *ht, size_t entry_size, size_t key_size, ds_entry_hash_fn hash_fn, size_t new_capacity) {
+    struct ds__ht_idxs *t = &ht->table;
+    assert(!(t->flags & DS__HT_MAPPED) && "mapped maps are read-only");
+    if (t->flags & DS__HT_FROZEN) {
+        /* thaw: drop the displacements, the entries get a regular index */
+        DS_FREE(t->data);
+        t->data = NULL;
+        t->capacity = 0;
+        t->flags &= ~DS__HT_FROZEN;
+        new_capacity = DS_HM_INIT_CAPACITY;
+        while (ht->length >= new_capacity * DS_HM_LOAD_FACTOR)
+            new_capacity <<= 1;
+    }
     assert((new_capacity & (new_capacity - 1)) == 0); /* must be power of 2 */
-    DS_FREE(ht->table.data);
+    assert(ht->length <= new_capacity);
+    if (ds__ht_old(t)) ds__table_migrate(ht, SIZE_MAX);
+    if (!t->capacity) t->flags |= DS__HT_DEFAULT_FLAGS;
+#ifdef DS_HM_STATS
+    ds__table_extra(t); /* lookups only count into an existing one */
+#endif
+    if (t->flags & (DS__HT_INCREMENTAL | DS__HT_ROBIN_HOOD)) t->flags |= DS__HT_STORE_HASH;
+    /* probes got too long: the keys may collide under this seed, pick another */
+    bool reseed = ds__ht_max_probe(t) > DS_HM_MAX_PROBE && !(t->flags & DS__HT_KEEP_SEED);
+    if (reseed) ht->seed = ds_hash_u64((uint64_t)(uintptr_t)t->data ^ ht->seed, ht->length + t->capacity);
+    if (t->flags & DS__HT_STORE_HASH) {
+        struct ds__ht_extra *hx = ds__table_extra(t);
+        bool had_hashes = hx->hashes != NULL;
+        hx->hashes = DS_REALLOC(hx->hashes, new_capacity * sizeof(size_t));
+        assert(hx->hashes != NULL);
+        if (!had_hashes || reseed) {
+            for (size_t i = 0; i < ht->length; i++)
+                hx->hashes[i] = hash_fn((const char *)ht->data + i * entry_size, key_size, ht->seed);
+        }
+    }
+    struct ds__ht_idxs old = *t;
+    struct ds__ht_extra *x = t->extra;
+    if (x) x->max_probe = 0;
+    t->resizes++;
+    uint8_t width = ds__table_width(new_capacity);
+    size_t idx_bytes = new_capacity * width;
+    char *block = DS_ALLOC(idx_bytes + new_capacity + DS__GROUP_WIDTH);
+    assert(block != NULL);
+    t->data = block;
+    t->width = width;
+    t->capacity = new_capacity;
+    memset(block + idx_bytes, DS__CTRL_EMPTY, new_capacity + DS__GROUP_WIDTH);
+    /* the filter grows with the index, and must forget the hashes of the old seed */
+    if (x && x->bloom && (reseed || new_capacity * DS_HM_LOAD_FACTOR > x->bloom->capacity))
+        ds__table_bloom(ht, entry_size, key_size, hash_fn, x->bloom->fpp);
+    if ((t->flags & DS__HT_INCREMENTAL) && old.capacity >= DS_HM_INCREMENTAL_MIN_CAPACITY && new_capacity > old.capacity && !reseed) {
+        /* keep the old table around and drain it from later operations */
+        struct ds__ht_migration *m = DS_ALLOC(sizeof(*m));
+        assert(m != NULL);
+        m->table = old;
+        m->table.extra = NULL;
+        m->pos = 0;
+        ds__table_extra(t)->old = m;
+        return;
+    }
     size_t mask = new_capacity - 1;
-    size_t *new_data = DS_ALLOC(new_capacity * sizeof(size_t));
-    assert(new_data != NULL);
-    memset(new_data, 0, new_capacity * sizeof(size_t));
     for (size_t i = 0; i < ht->length; i++) {
-        const void *entry = (const char *)ht->data + i * entry_size;
-        size_t h = hash_fn(entry, key_size, ht->seed) & mask;
-        while (new_data[h] != 0) {
-            h = (h + 1) & mask;
+        size_t h = ds__table_entry_hash(ht, entry_size, key_size, hash_fn, i);
+        if (t->flags & DS__HT_ROBIN_HOOD) ds__table_insert_rh(t, t->extra->hashes, h, i);
+        else ds__table_insert(t, ds__table_find_empty(t, h & mask), h, i);
+    }
+    DS_FREE(old.data);
+}
+
+struct ds__ht_extra *ds__table_extra(struct ds__ht_idxs *t) {
+    if (!t->extra) {
+        t->extra = DS_ALLOC(sizeof(*t->extra));
+        assert(t->extra && "out of memory");
+        memset(t->extra, 0, sizeof(*t->extra));
+    }
+    return t->extra;
+}
+
+/* Also forgets a caller key arena: the keys were released just before */
+void ds__table_free(struct ds__ht_idxs *table) {
+    struct ds__ht_extra *x = table->extra;
+    if (x) {
+        if (x->old) {
+            DS_FREE(x->old->table.data);
+            DS_FREE(x->old);
+        }
+        if (x->bloom) {
+            ds_bloom_free(x->bloom);
+            DS_FREE(x->bloom);
+        }
+        DS_FREE(x->hashes);
+        DS_FREE(x);
+        table->extra = NULL;
+    }
+    DS_FREE(table->data);
+    table->data = NULL;
+    table->capacity = 0;
+    table->resizes = 0;
+    table->flags &= ~DS__HT_FROZEN;
+}
+
+/* probe histogram and displacements of the entries indexed by `t` */
+static void ds__table_stats(const struct ds__ht *ht, const struct ds__ht_idxs *t, size_t entry_size, size_t key_size, bool cstr_keys, ds_entry_hash_fn hash_fn, DsHmStats *out, double *total) {
+    size_t mask = t->capacity - 1;
+    const size_t *hashes = ds__ht_hashes(&ht->table);
+    for (size_t slot = 0; slot < t->capacity; slot++) {
+        if (ds__table_ctrl(t)[slot] == DS__CTRL_EMPTY) continue;
+        size_t idx = ds__table_idx(t, slot), h;
+        const char *entry = (const char *)ht->data + idx * entry_size;
+        if (hashes) {
+            h = hashes[idx];
+        } else if (cstr_keys && (ht->table.flags & DS__HT_MAPPED)) {
+            const char *key = ds__mapped_str(entry);
+            h = hash_fn(&key, key_size, ht->seed);
+        } else {
+            h = hash_fn(entry, key_size, ht->seed);
+        }
+        size_t dist = (slot - h) & mask, groups = dist / DS__GROUP_WIDTH;
+        out->probe_hist[groups < DS_HM_STATS_HIST ? groups : DS_HM_STATS_HIST - 1]++;
+        if (dist > out->max_displacement) out->max_displacement = dist;
+        *total += (double)dist;
+    }
+}
+
+static size_t ds__table_bytes(const struct ds__ht_idxs *t) {
+    if (!t->capacity) return 0;
+    if (t->flags & DS__HT_FROZEN) return t->capacity * sizeof(uint32_t);
+    return t->capacity * t->width + t->capacity + DS__GROUP_WIDTH;
+}
+
+void ds__ht_stats(const struct ds__ht *ht, size_t entry_size, size_t key_size, bool cstr_keys, ds_entry_hash_fn hash_fn, DsHmStats *out) {
+    const struct ds__ht_idxs *t = &ht->table;
+    memset(out, 0, sizeof(*out));
+    out->length = ht->length;
+    out->slots = t->capacity;
+    out->frozen = (t->flags & DS__HT_FROZEN) != 0;
+    out->resizes = t->resizes;
+#ifdef DS_HM_STATS
+    if (t->extra) {
+        out->lookups = t->extra->counters.lookups;
+        out->misses = t->extra->counters.misses;
+        out->probes = t->extra->counters.probes;
+    }
+#endif
+    out->entry_bytes = ht->capacity * entry_size;
+    out->index_bytes = ds__table_bytes(t);
+    if (ds__ht_hashes(t)) out->index_bytes += (out->frozen || (t->flags & DS__HT_MAPPED) ? ht->length : t->capacity) * sizeof(size_t);
+    const DsBloom *bloom = ds__ht_bloom(t);
+    if (bloom) out->index_bytes += bloom->block_count * DS__BLOOM_WORDS * sizeof(uint32_t);
+    if (out->frozen) {
+        /* one probe each, wherever the entry sits */
+        out->load_factor = 1;
+        out->probe_hist[0] = ht->length;
+    } else if (t->capacity) {
+        double total = 0;
+        ds__table_stats(ht, t, entry_size, key_size, cstr_keys, hash_fn, out, &total);
+        const struct ds__ht_migration *m = ds__ht_old(t);
+        if (m) {
+            out->index_bytes += ds__table_bytes(&m->table);
+            ds__table_stats(ht, &m->table, entry_size, key_size, cstr_keys, hash_fn, out, &total);
+        }
+        out->load_factor = (double)ht->length / (double)t->capacity;
+        out->mean_displacement = ht->length ? total / (double)ht->length : 0;
+    }
+    if (cstr_keys && !(t->flags & DS__HT_MAPPED)) {
+        const DsArena *keys = ds__ht_keys(t);
+        if (keys && (t->flags & DS__HT_OWN_KEYS)) {
+            for (const DsRegion *r = keys->start; r; r = r->next) out->key_bytes += sizeof(DsRegion) + r->capacity;
+        } else {
+            for (size_t i = 0; i < ht->length; i++) {
+                const char *key;
+                memcpy(&key, (const char *)ht->data + i * entry_size, sizeof(key));
+                if (key) out->key_bytes += DS__KEY_PREFIX + strlen(key) + 1;
+            }
+        }
+    }
+}
+
+void ds_hm_stats_json(DsString *out, const DsHmStats *st) {
+    ds_str_appendf(out,
+                   "{\"length\":%zu,\"slots\":%zu,\"max_displacement\":%zu,\"index_bytes\":%zu,"
+                   "\"entry_bytes\":%zu,\"key_bytes\":%zu,\"resizes\":%zu,\"lookups\":%zu,\"misses\":%zu,"
+                   "\"probes\":%zu,\"load_factor\":%.3f,\"mean_displacement\":%.3f,\"frozen\":%s,\"probe_hist\":[",
+                   st->length, st->slots, st->max_displacement, st->index_bytes, st->entry_bytes, st->key_bytes,
+                   st->resizes, st->lookups, st->misses, st->probes, st->load_factor, st->mean_displacement,
+                   st->frozen ? "true" : "false");
+    for (size_t i = 0; i < DS_HM_STATS_HIST; i++) ds_str_appendf(out, i ? ",%zu" : "%zu", st->probe_hist[i]);
+    ds_str_appendf(out, "]}");
+}
+
+void ds__table_clear(struct ds__ht_idxs *table) {
+    struct ds__ht_extra *x = table->extra;
+    if (x && x->old) {
+        DS_FREE(x->old->table.data);
+        DS_FREE(x->old);
+        x->old = NULL;
+    }
+    if (table->flags & DS__HT_FROZEN) {
+        DS_FREE(table->data);
+        table->data = NULL;
+        table->capacity = 0;
+        table->flags &= ~DS__HT_FROZEN;
+    }
+    if (table->capacity) memset(ds__table_ctrl(table), DS__CTRL_EMPTY, table->capacity + DS__GROUP_WIDTH);
+    if (x && x->bloom) ds_bloom_clear(x->bloom);
+    if (x) x->max_probe = 0;
+}
+
+/* Frozen tables: CHD-style hash and displace. Entries are split into
+ * buckets by hash; each bucket gets the first displacement `d` for which
+ * all its entries land on free positions, position = mix(hash, d) mod n.
+ * Buckets with a single entry store its position directly instead. */
+#define DS__FROZEN_DIRECT 0x80000000u
+
+static inline uint64_t ds__frozen_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+/* fast x * n / 2^32 range reduction */
+static inline size_t ds__frozen_range(uint32_t x, size_t n) {
+    return (size_t)(((uint64_t)x * n) >> 32);
+}
+
+static inline size_t ds__frozen_bucket(size_t key_hash, size_t buckets) {
+    return ds__frozen_range((uint32_t)(ds__frozen_mix((uint64_t)key_hash) >> 32), buckets);
+}
+
+static inline size_t ds__frozen_slot(size_t key_hash, uint32_t d, size_t n) {
+    return ds__frozen_range((uint32_t)ds__frozen_mix((uint64_t)key_hash ^ ((uint64_t)d * 0x9E3779B97F4A7C15ull)), n);
+}
+
+static inline size_t ds__frozen_pos(const struct ds__ht_idxs *t, size_t n, size_t key_hash) {
+    uint32_t d = ((const uint32_t *)t->data)[ds__frozen_bucket(key_hash, t->capacity)];
+    if (d & DS__FROZEN_DIRECT) return d & ~DS__FROZEN_DIRECT;
+    return ds__frozen_slot(key_hash, d, n);
+}
+
+bool ds__table_freeze(struct ds__ht *ht, size_t entry_size, size_t key_size, ds_entry_hash_fn hash_fn) {
+    struct ds__ht_idxs *t = &ht->table;
+    size_t n = ht->length;
+    if (t->flags & DS__HT_FROZEN) return true;
+    if (n == 0 || n >= DS__FROZEN_DIRECT) return false;
+    if (ds__ht_old(t)) ds__table_migrate(ht, SIZE_MAX);
+
+    size_t nb = (n + DS_HM_FREEZE_BUCKET - 1) / DS_HM_FREEZE_BUCKET;
+    size_t *hashes = DS_ALLOC(n * sizeof(size_t));
+    uint32_t *start = DS_ALLOC((nb + 1) * sizeof(uint32_t));    /* bucket -> first member */
+    uint32_t *members = DS_ALLOC(n * sizeof(uint32_t));         /* entries grouped by bucket */
+    uint32_t *order = DS_ALLOC(nb * sizeof(uint32_t));          /* buckets, largest first */
+    uint32_t *dest = DS_ALLOC(n * sizeof(uint32_t));            /* entry -> position */
+    uint32_t *disp = DS_ALLOC(nb * sizeof(uint32_t));
+    uint8_t *taken = DS_ALLOC(n);
+    assert(hashes && start && members && order && dest && disp && taken);
+    memset(start, 0, (nb + 1) * sizeof(uint32_t));
+    memset(taken, 0, n);
+
+    size_t max_size = 0;
+    for (size_t i = 0; i < n; i++) {
+        hashes[i] = ds__table_entry_hash(ht, entry_size, key_size, hash_fn, i);
+        start[ds__frozen_bucket(hashes[i], nb) + 1]++;
+    }
+    for (size_t b = 0; b < nb; b++) {
+        if (start[b + 1] > max_size) max_size = start[b + 1];
+        start[b + 1] += start[b];
+    }
+    /* counting sorts: members by bucket, buckets by decreasing size */
+    uint32_t *cursor = dest;
+    memcpy(cursor, start, nb * sizeof(uint32_t));
+    for (size_t i = 0; i < n; i++)
+        members[cursor[ds__frozen_bucket(hashes[i], nb)]++] = (uint32_t)i;
+    uint32_t *by_size = DS_ALLOC((max_size + 2) * sizeof(uint32_t));
+    assert(by_size != NULL);
+    memset(by_size, 0, (max_size + 2) * sizeof(uint32_t));
+    for (size_t b = 0; b < nb; b++)
+        by_size[max_size - (start[b + 1] - start[b]) + 1]++;
+    for (size_t k = 0; k <= max_size; k++)
+        by_size[k + 1] += by_size[k];
+    for (size_t b = 0; b < nb; b++)
+        order[by_size[max_size - (start[b + 1] - start[b])]++] = (uint32_t)b;
+    DS_FREE(by_size);
+
+    bool ok = true;
+    size_t next_free = 0;
+    size_t slots[64];
+    for (size_t o = 0; o < nb && ok; o++) {
+        size_t b = order[o];
+        size_t size = start[b + 1] - start[b];
+        const uint32_t *m = members + start[b];
+        if (size == 0) {
+            disp[b] = 0;
+        } else if (size == 1) {
+            while (taken[next_free]) next_free++;
+            taken[next_free] = 1;
+            dest[m[0]] = (uint32_t)next_free;
+            disp[b] = DS__FROZEN_DIRECT | (uint32_t)next_free;
+        } else if (size > DS_ARRAY_LEN(slots)) {
+            ok = false;
+        } else {
+            uint32_t d = 0;
+            for (;; d++) {
+                if (d >= DS__FROZEN_DIRECT) {
+                    ok = false; /* keys with identical hashes never separate */
+                    break;
+                }
+                size_t k = 0;
+                for (; k < size; k++) {
+                    size_t pos = ds__frozen_slot(hashes[m[k]], d, n);
+                    if (taken[pos]) break;
+                    taken[pos] = 1;
+                    slots[k] = pos;
+                }
+                if (k == size) break;
+                while (k--) taken[slots[k]] = 0;
+            }
+            if (!ok) break;
+            for (size_t k = 0; k < size; k++) dest[m[k]] = (uint32_t)slots[k];
+            disp[b] = d;
+        }
+    }
+    DS_FREE(hashes);
+    DS_FREE(start);
+    DS_FREE(members);
+    DS_FREE(order);
+    DS_FREE(taken);
+    if (!ok) {
+        DS_FREE(dest);
+        DS_FREE(disp);
+        return false;
+    }
+
+    /* move every entry (and its stored hash) to its position, cycle by cycle */
+    char *tmp = DS_ALLOC(entry_size);
+    assert(tmp != NULL);
+    size_t *stored = ds__ht_hashes(t);
+    for (size_t i = 0; i < n; i++) {
+        while (dest[i] != i) {
+            size_t j = dest[i];
+            char *a = (char *)ht->data + i * entry_size, *b = (char *)ht->data + j * entry_size;
+            memcpy(tmp, a, entry_size);
+            memcpy(a, b, entry_size);
+            memcpy(b, tmp, entry_size);
+            if (stored) {
+                size_t h = stored[i];
+                stored[i] = stored[j];
+                stored[j] = h;
+            }
+            dest[i] = dest[j];
+            dest[j] = (uint32_t)j;
         }
-        new_data[h] = i + 1;
     }
-    ht->table.data = new_data;
-    ht->table.capacity = new_capacity;
+    DS_FREE(tmp);
+    DS_FREE(dest);
+
+    DS_FREE(t->data);
+    t->data = disp;
+    t->capacity = nb;
+    t->width = sizeof(uint32_t);
+    t->flags |= DS__HT_FROZEN;
+    return true;
 }
 
 void ds__table_remove_slot(struct ds__ht *ht, size_t entry_size, size_t key_size, ds_entry_hash_fn hash_fn, size_t slot, size_t idx) {
-    size_t mask = ht->table.capacity - 1;
+    struct ds__ht_idxs *t = &ht->table;
+    assert(!(t->flags & DS__HT_MAPPED) && "mapped maps are read-only");
     if (idx < ht->length) {
-        const void *moved = (const char *)ht->data + idx * entry_size;
-        size_t h = hash_fn(moved, key_size, ht->seed) & mask;
-        while (ht->table.data[h] != 0) {
-            if (ht->table.data[h] - 1 == ht->length) {
-                ht->table.data[h] = idx + 1;
-                break;
+        /* the last entry was moved into `idx`: repoint its slot */
+        size_t h;
+        size_t *hashes = ds__ht_hashes(t);
+        if (hashes) {
+            h = hashes[idx] = hashes[ht->length];
+        } else {
+            h = hash_fn((const char *)ht->data + idx * entry_size, key_size, ht->seed);
+        }
+        if (!ds__table_repoint(t, h, ht->length, idx)) {
+            bool found = ds__ht_old(t) && ds__table_repoint(&t->extra->old->table, h, ht->length, idx);
+            assert(found);
+            DS_UNUSED(found);
+        }
+    }
+    ds__table_erase(ht, t, entry_size, key_size, hash_fn, slot);
+}
+
+/* Map images: a header, then the entries, the index table (control bytes
+ * mirrored for the widest group), the stored hashes and the key strings,
+ * each section DS__IMAGE_ALIGN aligned. A `char *` key holds the offset of
+ * its length-prefixed string from its entry, 0 for NULL. */
+#define DS__IMAGE_MAGIC "DSHMIMG1"
+#define DS__IMAGE_ALIGN 64
+#define DS__IMAGE_MIRROR 32
+#define DS__IMAGE_FLAGS (DS__HT_STORE_HASH | DS__HT_FROZEN | DS__HT_ROBIN_HOOD | DS__HT_KEEP_SEED)
+
+struct ds__hm_image {
+    char magic[8];
+    uint32_t size_t_bytes;
+    uint32_t entry_size;
+    uint32_t key_size;
+    uint32_t cstr_keys;
+    uint32_t flags;
+    uint32_t width;
+    uint64_t length;
+    uint64_t capacity;
+    uint64_t seed;
+    uint64_t fingerprint; /* hash of a fixed key: catches other hash functions */
+    uint64_t index_off;
+    uint64_t hashes_off;
+    uint64_t strings_off;
+    uint64_t size;
+};
+
+#define DS__IMAGE_DATA_OFF \
+    ((sizeof(struct ds__hm_image) + DS__IMAGE_ALIGN - 1) & ~(size_t)(DS__IMAGE_ALIGN - 1))
+
+static inline size_t ds__image_align(size_t off) {
+    return (off + DS__IMAGE_ALIGN - 1) & ~(size_t)(DS__IMAGE_ALIGN - 1);
+}
+
+static uint64_t ds__image_fingerprint(size_t key_size, bool cstr_keys, ds_entry_hash_fn hash_fn, size_t seed) {
+    if (cstr_keys) {
+        const char *probe = "ds.h image";
+        return hash_fn(&probe, key_size, seed);
+    }
+    unsigned char *probe = DS_ALLOC(key_size ? key_size : 1);
+    assert(probe != NULL);
+    memset(probe, 0x5A, key_size);
+    uint64_t h = hash_fn(probe, key_size, seed);
+    DS_FREE(probe);
+    return h;
+}
+
+const char *ds__mapped_str(const void *entry) {
+    intptr_t off;
+    memcpy(&off, entry, sizeof(off));
+    return off ? (const char *)entry + off : NULL;
+}
+
+static int ds__eq_str_mapped(const void *entry, const void *user_key, size_t key_size) {
+    DS_UNUSED(key_size);
+    const char *str = ds__mapped_str(entry);
+    const char *key = user_key;
+    if (!str || !key) return str == key;
+    return strcmp(str, key) == 0;
+}
+
+static int ds__eq_sv_mapped(const void *entry, const void *user_key, size_t key_size) {
+    const char *str = ds__mapped_str(entry);
+    return ds__eq_sv(&str, user_key, key_size);
+}
+
+/* write `n` bytes at `*pos`, zero-padding up to `off` first */
+static bool ds__image_write(FILE *f, size_t *pos, size_t off, const void *buf, size_t n) {
+    static const char zeros[DS__IMAGE_ALIGN];
+    while (*pos < off) {
+        size_t pad = off - *pos < sizeof(zeros) ? off - *pos : sizeof(zeros);
+        if (fwrite(zeros, 1, pad, f) != pad) return false;
+        *pos += pad;
+    }
+    if (n && fwrite(buf, 1, n, f) != n) return false;
+    *pos += n;
+    return true;
+}
+
+bool ds__hm_save(struct ds__ht *ht, size_t entry_size, size_t key_size, bool cstr_keys, ds_entry_hash_fn hash_fn, const char *path) {
+    struct ds__ht_idxs *t = &ht->table;
+    if (ds__ht_old(t)) ds__table_migrate(ht, SIZE_MAX);
+    bool frozen = t->flags & DS__HT_FROZEN;
+    size_t ctrl_bytes = frozen || !t->capacity ? 0 : t->capacity + DS__IMAGE_MIRROR;
+    size_t index_bytes = t->capacity * (frozen ? sizeof(uint32_t) : t->width);
+
+    struct ds__hm_image h = {0};
+    memcpy(h.magic, DS__IMAGE_MAGIC, sizeof(h.magic));
+    h.size_t_bytes = sizeof(size_t);
+    h.entry_size = (uint32_t)entry_size;
+    h.key_size = (uint32_t)key_size;
+    h.cstr_keys = cstr_keys;
+    h.flags = t->flags & DS__IMAGE_FLAGS;
+    h.width = t->width;
+    h.length = ht->length;
+    h.capacity = t->capacity;
+    h.seed = ht->seed;
+    h.fingerprint = ds__image_fingerprint(key_size, cstr_keys, hash_fn, ht->seed);
+    h.index_off = ds__image_align(DS__IMAGE_DATA_OFF + ht->length * entry_size);
+    size_t end = h.index_off + index_bytes + ctrl_bytes;
+    if (ds__ht_hashes(t)) {
+        h.hashes_off = ds__image_align(end);
+        end = h.hashes_off + ht->length * sizeof(size_t);
+    }
+    h.strings_off = ds__image_align(end);
+    size_t strings_bytes = 0;
+    for (size_t i = 0; cstr_keys && i < ht->length; i++) {
+        const char *str = *(const char *const *)((const char *)ht->data + i * entry_size);
+        if (str) strings_bytes += DS__KEY_PREFIX + strlen(str) + 1;
+    }
+    h.size = h.strings_off + strings_bytes;
+
+    bool result = false;
+    size_t pos = 0;
+    char *entry = DS_ALLOC(entry_size);
+    size_t tmp_len = strlen(path) + 5;
+    char *tmp = DS_ALLOC(tmp_len);
+    assert(entry != NULL && tmp != NULL);
+    snprintf(tmp, tmp_len, "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) goto cleanup;
+    if (!ds__image_write(f, &pos, 0, &h, sizeof(h))) goto cleanup;
+
+    size_t str_pos = h.strings_off;
+    for (size_t i = 0; i < ht->length; i++) {
+        memcpy(entry, (const char *)ht->data + i * entry_size, entry_size);
+        if (cstr_keys) {
+            const char *str = *(const char **)entry;
+            intptr_t off = 0;
+            if (str) {
+                off = (intptr_t)(str_pos + DS__KEY_PREFIX) - (intptr_t)(DS__IMAGE_DATA_OFF + i * entry_size);
+                str_pos += DS__KEY_PREFIX + strlen(str) + 1;
             }
-            h = (h + 1) & mask;
+            memset(entry, 0, key_size);
+            memcpy(entry, &off, sizeof(off));
+        }
+        if (!ds__image_write(f, &pos, DS__IMAGE_DATA_OFF, entry, entry_size)) goto cleanup;
+    }
+    if (!ds__image_write(f, &pos, h.index_off, t->data, index_bytes)) goto cleanup;
+    if (ctrl_bytes) {
+        if (!ds__image_write(f, &pos, pos, ds__table_ctrl(t), t->capacity)) goto cleanup;
+        for (size_t i = 0; i < DS__IMAGE_MIRROR; i++) {
+            if (!ds__image_write(f, &pos, pos, &ds__table_ctrl(t)[i & (t->capacity - 1)], 1)) goto cleanup;
+        }
+    }
+    if (ds__ht_hashes(t) && !ds__image_write(f, &pos, h.hashes_off, t->extra->hashes, ht->length * sizeof(size_t))) goto cleanup;
+    if (!ds__image_write(f, &pos, h.strings_off, NULL, 0)) goto cleanup;
+    for (size_t i = 0; cstr_keys && i < ht->length; i++) {
+        const char *str = *(const char *const *)((const char *)ht->data + i * entry_size);
+        if (!str) continue;
+        size_t len = strlen(str);
+        if (!ds__image_write(f, &pos, pos, &len, sizeof(len))) goto cleanup;
+        if (!ds__image_write(f, &pos, pos, str, len + 1)) goto cleanup;
+    }
+    if (fclose(f) != 0) {
+        f = NULL;
+        goto cleanup;
+    }
+    f = NULL;
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (rename(tmp, path) != 0) goto cleanup;
+    result = true;
+cleanup:
+    if (!result) ds_log(DS_LOG_ERROR, "Could not save map to %s: %s\n", path, strerror(errno));
+    if (f) {
+        fclose(f);
+        remove(tmp);
+    }
+    DS_FREE(entry);
+    DS_FREE(tmp);
+    return result;
+}
+
+bool ds__hm_map(struct ds__ht *ht, size_t entry_size, size_t key_size, bool cstr_keys, ds_entry_hash_fn hash_fn, const char *path) {
+    assert(ht->length == 0 && ht->table.capacity == 0 && "map into an empty map");
+    const char *error = NULL;
+    char *base = NULL;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER file_size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size)) {
+        error = "cannot open file";
+    } else if ((size = (size_t)file_size.QuadPart) >= sizeof(struct ds__hm_image)) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (mapping) CloseHandle(mapping);
+        if (!base) error = "cannot map file";
+    }
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        error = strerror(errno);
+    } else if ((size = (size_t)st.st_size) >= sizeof(struct ds__hm_image)) {
+        base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            base = NULL;
+            error = strerror(errno);
         }
     }
-    ht->table.data[slot] = 0;
-    slot = (slot + 1) & mask;
-    while (ht->table.data[slot] != 0) {
-        size_t i = ht->table.data[slot] - 1;
-        ht->table.data[slot] = 0;
-        const void *entry = (const char *)ht->data + i * entry_size;
-        size_t h = hash_fn(entry, key_size, ht->seed) & mask;
-        while (ht->table.data[h] != 0) {
-            h = (h + 1) & mask;
+    if (fd >= 0) close(fd);
+#endif
+    struct ds__hm_image h;
+    if (!error && !base) error = "not a map image";
+    if (!error) {
+        memcpy(&h, base, sizeof(h));
+        if (memcmp(h.magic, DS__IMAGE_MAGIC, sizeof(h.magic)) != 0 || h.size != size)
+            error = "not a map image";
+        else if (h.size_t_bytes != sizeof(size_t) || h.entry_size != entry_size ||
+                 h.key_size != key_size || h.cstr_keys != cstr_keys)
+            error = "saved from a different map type";
+        else if (h.fingerprint != ds__image_fingerprint(key_size, cstr_keys, hash_fn, (size_t)h.seed))
+            error = "saved with different hash functions";
+    }
+    if (error) {
+        ds_log(DS_LOG_ERROR, "Could not map %s: %s\n", path, error);
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+#else
+        if (base) munmap(base, size);
+#endif
+        return false;
+    }
+
+    struct ds__ht_idxs *t = &ht->table;
+    ht->data = base + DS__IMAGE_DATA_OFF;
+    ht->length = ht->capacity = (size_t)h.length;
+    ht->seed = (size_t)h.seed;
+    memset(t, 0, sizeof(*t));
+    t->capacity = (size_t)h.capacity;
+    t->width = (uint8_t)h.width;
+    t->flags = h.flags | DS__HT_MAPPED;
+#ifdef DS_HM_STATS
+    ds__table_extra(t);
+#endif
+    if (t->capacity) t->data = base + h.index_off;
+    if (h.hashes_off) ds__table_extra(t)->hashes = (size_t *)(base + h.hashes_off);
+    return true;
+}
+
+void ds__hm_unmap(struct ds__ht *ht) {
+    char *base = (char *)ht->data - DS__IMAGE_DATA_OFF;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+#else
+    struct ds__hm_image h;
+    memcpy(&h, base, sizeof(h));
+    munmap(base, (size_t)h.size);
+#endif
+    DS_FREE(ht->table.extra);
+    memset(&ht->table, 0, sizeof(ht->table));
+    ht->data = NULL;
+    ht->length = ht->capacity = 0;
+    ht->seed = 0;
+}
+
+void *ds__rb_grow(void *data, size_t *head, size_t length, size_t *capacity, size_t n, size_t item_size) {
+    size_t old = *capacity, cap = old ? old : DS_RB_INIT_CAPACITY;
+    while (cap < n) cap *= 2;
+    char *grown = DS_REALLOC(data, cap * item_size);
+    assert(grown && "out of memory");
+    if (*head + length > old) {
+        /* the items wrap around the old end: move the shorter part so
+           they wrap around the new one */
+        size_t wrapped = *head + length - old, front = old - *head;
+        if (wrapped <= front) {
+            memcpy(grown + old * item_size, grown, wrapped * item_size);
+        } else {
+            memcpy(grown + (cap - front) * item_size, grown + *head * item_size, front * item_size);
+            *head = cap - front;
         }
-        ht->table.data[h] = i + 1;
-        slot = (slot + 1) & mask;
     }
+    *capacity = cap;
+    return grown;
+}
+
+/* copy `n` items into the ring from slot `pos`, wrapping at the end */
+void ds__rb_write(void *data, size_t capacity, size_t pos, const void *items, size_t n, size_t item_size) {
+    size_t first = capacity - pos < n ? capacity - pos : n;
+    memcpy((char *)data + pos * item_size, items, first * item_size);
+    memcpy(data, (const char *)items + first * item_size, (n - first) * item_size);
+}
+
+void ds__rb_read(const void *data, size_t capacity, size_t pos, void *out, size_t n, size_t item_size) {
+    size_t first = capacity - pos < n ? capacity - pos : n;
+    memcpy(out, (const char *)data + pos * item_size, first * item_size);
+    memcpy((char *)out + first * item_size, data, (n - first) * item_size);
+}
+
+size_t ds__pow2_ceil(size_t n, size_t min) {
+    size_t p = min;
+    while (p < n) p *= 2;
+    return p;
 }
 
 bool ds_read_entire_file(const char *path, DsString *str) {
@@ -1623,6 +6318,10 @@ bool ds_ends_with_sn(const char *str, const char *suffix, size_t str_len, size_t
 void *ds_a_malloc(DsArena *a, size_t size) {
     if (size == 0) return NULL;
     size = (size + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1);
+    /* regions after `end` are empty ones kept by ds_a_reset */
+    while (a->end && a->end->size + size > a->end->capacity && a->end->next) {
+        a->end = a->end->next;
+    }
     if (!a->end || a->end->size + size > a->end->capacity) {
         size_t region_size = DS_MIN_ALLOC_REGION;
         if (size + sizeof(DsRegion) > region_size) {
@@ -1713,6 +6412,13 @@ void ds_a_free(DsArena *a) {
     a->start = a->end = NULL;
 }
 
+void ds_a_reset(DsArena *a) {
+    for (DsRegion *r = a->start; r; r = r->next) {
+        r->size = 0;
+    }
+    a->end = a->start;
+}
+
 void ds_a_rfree(DsRArena *a) {
     DsRRegion *r = a->start;
     while (r) {
@@ -1881,6 +6587,10 @@ int closedir(DIR *dir) {
 #define ARRAY_LEN DS_ARRAY_LEN
 #define da_declare ds_da_declare
 #define da_reserve ds_da_reserve
+#define sda_declare ds_sda_declare
+#define sda_init ds_sda_init
+#define sda_reset ds_sda_reset
+#define sda_on_heap ds_sda_on_heap
 #define da_reserve_with_init_capacity ds_da_reserve_with_init_capacity
 #define da_reserve_min ds_da_reserve_min
 #define da_append ds_da_append
@@ -1899,6 +6609,25 @@ int closedir(DIR *dir) {
 #define da_foreach_idx ds_da_foreach_idx
 #define da_find ds_da_find
 #define da_index_of ds_da_index_of
+#define sort_declare ds_sort_declare
+#define sort_declare_ex ds_sort_declare_ex
+#define da_sort ds_da_sort
+#define da_stable_sort ds_da_stable_sort
+#define da_bsearch ds_da_bsearch
+#define da_lower_bound ds_da_lower_bound
+#define da_upper_bound ds_da_upper_bound
+#define da_merge ds_da_merge
+#define da_radix_sort ds_da_radix_sort
+#define da_radix_sort_by ds_da_radix_sort_by
+#define seg_declare ds_seg_declare
+#define seg_at ds_seg_at
+#define seg_reserve ds_seg_reserve
+#define seg_append ds_seg_append
+#define seg_append_many ds_seg_append_many
+#define seg_last ds_seg_last
+#define seg_pop ds_seg_pop
+#define seg_free ds_seg_free
+#define seg_foreach ds_seg_foreach
 #define str_append ds_str_append
 #define str_appendf ds_str_appendf
 #define str_prependf ds_str_prependf
@@ -1910,15 +6639,36 @@ int closedir(DIR *dir) {
 #define str_trim ds_str_trim
 #define Hm ds_Hm
 #define hm_declare ds_hm_declare
+#define hm_declare_ex ds_hm_declare_ex
 #define hm_get ds_hm_get
 #define hm_has ds_hm_has
+#define hm_try_sv ds_hm_try_sv
+#define hm_has_sv ds_hm_has_sv
+#define hm_set_sv ds_hm_set_sv
 #define hm_try ds_hm_try
 #define hm_set ds_hm_set
 #define hm_remove ds_hm_remove
 #define hm_foreach ds_hm_foreach
 #define hm_free ds_hm_free
+#define hm_save ds_hm_save
+#define hm_map ds_hm_map
+#define hm_str_key ds_hm_str_key
 #define hm_shrink ds_hm_shrink
-#define hm_clear ds_hm_free
+#define hm_try_many ds_hm_try_many
+#define hm_get_many ds_hm_get_many
+#define hm_set_many ds_hm_set_many
+#define hm_reserve ds_hm_reserve
+#define hm_freeze ds_hm_freeze
+#define hm_store_hash ds_hm_store_hash
+#define hm_incremental_resize ds_hm_incremental_resize
+#define hm_robin_hood ds_hm_robin_hood
+#define hm_key_arena ds_hm_key_arena
+#define hm_stats ds_hm_stats
+#define hm_stats_json ds_hm_stats_json
+#define wyhash ds_wyhash
+#define fnv1a ds_fnv1a
+#define hash_u64 ds_hash_u64
+#define hm_clear ds_hm_clear
 #define Hs ds_Hs
 #define hs_declare ds_hs_declare
 #define hs_has ds_hs_has
@@ -1929,11 +6679,42 @@ int closedir(DIR *dir) {
 #define hs_cat_da ds_hs_cat_da
 #define hs_sub ds_hs_sub
 #define hs_sub_da ds_hs_sub_da
+#define hs_intersect ds_hs_intersect
+#define hs_intersect_count ds_hs_intersect_count
 #define hs_to_da ds_hs_to_da
 #define da_to_hs ds_da_to_hs
 #define hs_free ds_hs_free
 #define hs_shrink ds_hs_shrink
-#define hs_clear ds_hs_free
+#define hs_store_hash ds_hs_store_hash
+#define hs_freeze ds_hs_freeze
+#define hs_incremental_resize ds_hs_incremental_resize
+#define hs_robin_hood ds_hs_robin_hood
+#define hs_clear ds_hs_clear
+#define hs_stats ds_hs_stats
+#define Chm ds_Chm
+#define chm_declare ds_chm_declare
+#define chm_init ds_chm_init
+#define chm_set ds_chm_set
+#define chm_get ds_chm_get
+#define chm_try_get ds_chm_try_get
+#define chm_has ds_chm_has
+#define chm_remove ds_chm_remove
+#define chm_compute_if_absent ds_chm_compute_if_absent
+#define chm_length ds_chm_length
+#define chm_free ds_chm_free
+#define cache_declare ds_cache_declare
+#define btree_declare ds_btree_declare
+#define btree_declare_ex ds_btree_declare_ex
+#define fm_declare ds_fm_declare
+#define fm_declare_ex ds_fm_declare_ex
+#define fm_foreach ds_fm_foreach
+#define bloom_init ds_bloom_init
+#define bloom_add ds_bloom_add
+#define bloom_has ds_bloom_has
+#define bloom_add_hash ds_bloom_add_hash
+#define bloom_has_hash ds_bloom_has_hash
+#define bloom_clear ds_bloom_clear
+#define bloom_free ds_bloom_free
 #define foreach ds_foreach
 #define foreach_idx ds_foreach_idx
 #define ll_declare ds_ll_declare
@@ -1941,6 +6722,36 @@ int closedir(DIR *dir) {
 #define ll_append ds_ll_append
 #define ll_pop ds_ll_pop
 #define ll_free ds_ll_free
+#define rb_declare ds_rb_declare
+#define rb_init_fixed ds_rb_init_fixed
+#define rb_reserve ds_rb_reserve
+#define rb_at ds_rb_at
+#define rb_front ds_rb_front
+#define rb_back ds_rb_back
+#define rb_push_back ds_rb_push_back
+#define rb_push_front ds_rb_push_front
+#define rb_pop_front ds_rb_pop_front
+#define rb_pop_back ds_rb_pop_back
+#define rb_push_back_many ds_rb_push_back_many
+#define rb_push_front_many ds_rb_push_front_many
+#define rb_pop_front_many ds_rb_pop_front_many
+#define rb_pop_back_many ds_rb_pop_back_many
+#define rb_foreach ds_rb_foreach
+#define rb_clear ds_rb_clear
+#define rb_free ds_rb_free
+#define spsc_declare ds_spsc_declare
+#define spsc_init ds_spsc_init
+#define spsc_push ds_spsc_push
+#define spsc_pop ds_spsc_pop
+#define spsc_push_many ds_spsc_push_many
+#define spsc_pop_many ds_spsc_pop_many
+#define spsc_length ds_spsc_length
+#define spsc_free ds_spsc_free
+#define mpmc_declare ds_mpmc_declare
+#define mpmc_init ds_mpmc_init
+#define mpmc_push ds_mpmc_push
+#define mpmc_pop ds_mpmc_pop
+#define mpmc_free ds_mpmc_free
 #define String DsString
 #define read_entire_file ds_read_entire_file
 #define write_entire_file ds_write_entire_file
@@ -1966,6 +6777,7 @@ int closedir(DIR *dir) {
 #define a_malloc ds_a_malloc
 #define a_realloc ds_a_realloc
 #define a_free ds_a_free
+#define a_reset ds_a_reset
 #define a_rmalloc ds_a_rmalloc
 #define a_rrealloc ds_a_rrealloc
 #define a_rfree ds_a_rfree
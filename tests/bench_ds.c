@@ -0,0 +1,1548 @@
+/**
+ * ds.h benchmarks.
+ * Build and run with `tests/run_benchmarks.sh`, or by hand:
+ *   cc -O2 tests/bench_ds.c -o bench_ds && ./bench_ds [section...]
+ * Sections: hash resize chm keys batch freeze probe typed views image cache
+ *   bloom setops btree flatmap stats sort sda seg large rb queue
+ * Define BENCH_LEGACY_HASH to build maps on the old DJB2 / 32-bit-prime FNV
+ * hashes for a before/after comparison, and DS_DA_LARGE_THRESHOLD (e.g.
+ * -DDS_DA_LARGE_THRESHOLD='(64 << 20)') to compare the "large" section.
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+size_t bench_legacy_str_hash(const void *data, size_t len, size_t seed);
+size_t bench_legacy_int_hash(uint64_t x, size_t seed);
+#ifdef BENCH_LEGACY_HASH
+#define DS_HASH_FN bench_legacy_str_hash
+#define DS_HASH_INT_FN bench_legacy_int_hash
+#endif
+
+#define DS_IMPLEMENTATION
+#define DS_CHM
+#include "../ds.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// DJB2, the previous string hash
+size_t bench_legacy_str_hash(const void *data, size_t len, size_t seed) {
+    const unsigned char *p = data;
+    size_t hash = seed ? seed : 5381;
+    for (size_t i = 0; i < len; i++) hash = ((hash << 5) + hash) + p[i];
+    return hash;
+}
+
+// FNV-1a with the 32-bit prime, the previous byte hash
+static size_t bench_legacy_bytes_hash(const void *data, size_t len, size_t seed) {
+    const unsigned char *p = data;
+    size_t hash = seed ? seed : 5381;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+size_t bench_legacy_int_hash(uint64_t x, size_t seed) {
+    return bench_legacy_bytes_hash(&x, sizeof(x), seed);
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool section_enabled(int argc, char **argv, const char *name) {
+    if (argc < 2) return true;
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], name) == 0) return true;
+    return false;
+}
+
+static volatile size_t bench_sink;
+
+// ============================================================================
+// Hash functions
+// ============================================================================
+
+#define HASH_KEYS (1 << 20)
+
+typedef size_t (*bench_hash_fn)(const void *key, size_t len, size_t seed);
+
+static size_t bench_u64_adapter(const void *key, size_t len, size_t seed) {
+    DS_UNUSED(len);
+    return ds_hash_u64(*(const uint64_t *)key, seed);
+}
+
+static size_t bench_legacy_u64_adapter(const void *key, size_t len, size_t seed) {
+    return bench_legacy_bytes_hash(key, len, seed);
+}
+
+typedef struct {
+    const char *name;
+    const void *keys;
+    size_t stride; // distance between keys in bytes
+    size_t count;
+    bool cstr;
+} HashKeySet;
+
+/* Simulate linear probing with `& mask` slot selection at ~0.75 load */
+static void probe_stats(bench_hash_fn fn, const HashKeySet *ks, double *avg, size_t *max) {
+    size_t cap = 1;
+    while (cap * 3 < ks->count * 4) cap <<= 1;
+    char *used = calloc(cap, 1);
+    size_t mask = cap - 1, total = 0, worst = 0;
+    for (size_t i = 0; i < ks->count; i++) {
+        const char *k = (const char *)ks->keys + i * ks->stride;
+        if (ks->cstr) k = *(const char *const *)k;
+        size_t len = ks->cstr ? strlen(k) : ks->stride;
+        size_t slot = fn(k, len, 0) & mask, dist = 0;
+        while (used[slot]) {
+            slot = (slot + 1) & mask;
+            dist++;
+        }
+        used[slot] = 1;
+        total += dist + 1;
+        if (dist + 1 > worst) worst = dist + 1;
+    }
+    free(used);
+    *avg = (double)total / ks->count;
+    *max = worst;
+}
+
+static double hash_ns_per_key(bench_hash_fn fn, const HashKeySet *ks) {
+    size_t acc = 0;
+    double t0 = now_sec();
+    for (int rep = 0; rep < 4; rep++) {
+        for (size_t i = 0; i < ks->count; i++) {
+            const char *k = (const char *)ks->keys + i * ks->stride;
+            if (ks->cstr) k = *(const char *const *)k;
+            acc += fn(k, ks->cstr ? strlen(k) : ks->stride, 0);
+        }
+    }
+    bench_sink = acc;
+    return (now_sec() - t0) * 1e9 / (4.0 * ks->count);
+}
+
+ds_hm_declare(BenchIntMap, uint64_t, uint64_t);
+ds_hm_declare(BenchStrMap, char *, uint64_t);
+
+void bench_hash(void) {
+    printf("\n[hash]\n");
+    uint64_t *seq = malloc(HASH_KEYS * sizeof(uint64_t));
+    uint64_t *strided = malloc(HASH_KEYS * sizeof(uint64_t));
+    char **short_strs = malloc(HASH_KEYS * sizeof(char *));
+    char **long_strs = malloc(HASH_KEYS * sizeof(char *));
+    char buf[128];
+    for (size_t i = 0; i < HASH_KEYS; i++) {
+        seq[i] = i;
+        strided[i] = i << 12;
+        snprintf(buf, sizeof(buf), "user:%zu", i);
+        short_strs[i] = strdup(buf);
+        snprintf(buf, sizeof(buf), "/api/v2/accounts/%zu/sessions/%zu/events?limit=100", i * 7, i);
+        long_strs[i] = strdup(buf);
+    }
+
+    HashKeySet sets[] = {
+        {"u64 sequential", seq, sizeof(uint64_t), HASH_KEYS, false},
+        {"u64 stride 4096", strided, sizeof(uint64_t), HASH_KEYS, false},
+        {"short strings", short_strs, sizeof(char *), HASH_KEYS, true},
+        {"long strings", long_strs, sizeof(char *), HASH_KEYS, true},
+    };
+    printf("  %-18s %-22s %10s %10s %10s\n", "keys", "hash", "ns/key", "avg probe", "max probe");
+    for (size_t s = 0; s < DS_ARRAY_LEN(sets); s++) {
+        struct {
+            const char *name;
+            bench_hash_fn fn;
+        } fns[2];
+        if (sets[s].cstr) {
+            fns[0].name = "djb2 (legacy)", fns[0].fn = bench_legacy_str_hash;
+            fns[1].name = "ds_wyhash", fns[1].fn = ds_wyhash;
+        } else {
+            fns[0].name = "fnv-1a/32 (legacy)", fns[0].fn = bench_legacy_u64_adapter;
+            fns[1].name = "ds_hash_u64", fns[1].fn = bench_u64_adapter;
+        }
+        for (size_t f = 0; f < 2; f++) {
+            double avg;
+            size_t max;
+            probe_stats(fns[f].fn, &sets[s], &avg, &max);
+            double ns = hash_ns_per_key(fns[f].fn, &sets[s]);
+            printf("  %-18s %-22s %10.2f %10.2f %10zu\n", sets[s].name, fns[f].name, ns, avg, max);
+        }
+    }
+
+    // look keys up in random order, like real traffic
+    size_t *order = malloc(HASH_KEYS * sizeof(size_t));
+    for (size_t i = 0; i < HASH_KEYS; i++) order[i] = i;
+    srand(42);
+    for (size_t i = HASH_KEYS - 1; i > 0; i--) {
+        size_t j = ((size_t)rand() << 16 ^ (size_t)rand()) % (i + 1), t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+#ifdef BENCH_LEGACY_HASH
+    printf("  maps built on the legacy hashes:\n");
+#else
+    printf("  maps built on the default hashes:\n");
+#endif
+    BenchIntMap im = {0};
+    double t0 = now_sec();
+    for (size_t i = 0; i < HASH_KEYS; i++) ds_hm_set(&im, strided[i], i);
+    double t1 = now_sec();
+    size_t hits = 0;
+    for (size_t i = 0; i < HASH_KEYS; i++) hits += ds_hm_has(&im, strided[order[i]]);
+    double t2 = now_sec();
+    printf("  %-18s insert %7.1f ns/op   lookup %7.1f ns/op\n", "u64 stride map",
+           (t1 - t0) * 1e9 / HASH_KEYS, (t2 - t1) * 1e9 / HASH_KEYS);
+    ds_hm_free(&im);
+
+    BenchStrMap sm = {0};
+    t0 = now_sec();
+    for (size_t i = 0; i < HASH_KEYS; i++) ds_hm_set(&sm, short_strs[i], i);
+    t1 = now_sec();
+    for (size_t i = 0; i < HASH_KEYS; i++) hits += ds_hm_has(&sm, short_strs[order[i]]);
+    t2 = now_sec();
+    printf("  %-18s insert %7.1f ns/op   lookup %7.1f ns/op\n", "short string map",
+           (t1 - t0) * 1e9 / HASH_KEYS, (t2 - t1) * 1e9 / HASH_KEYS);
+    ds_hm_free(&sm);
+    bench_sink = hits;
+
+    for (size_t i = 0; i < HASH_KEYS; i++) {
+        free(short_strs[i]);
+        free(long_strs[i]);
+    }
+    free(order);
+    free(seq);
+    free(strided);
+    free(short_strs);
+    free(long_strs);
+}
+
+
+// ============================================================================
+// Resize latency
+// ============================================================================
+
+#define RESIZE_KEYS ((size_t)1 << 22)
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void resize_run(const char *name, bool incremental, double *lat) {
+    BenchIntMap hm = {0};
+    if (incremental) ds_hm_incremental_resize(&hm);
+    double start = now_sec();
+    for (size_t i = 0; i < RESIZE_KEYS; i++) {
+        double t0 = now_sec();
+        ds_hm_set(&hm, i << 12, i);
+        lat[i] = now_sec() - t0;
+    }
+    double total = now_sec() - start;
+    ds_hm_free(&hm);
+    qsort(lat, RESIZE_KEYS, sizeof(double), cmp_double);
+    printf("  %-14s %8.1f %10.0f %10.0f %12.0f\n", name, total * 1e9 / RESIZE_KEYS,
+           lat[RESIZE_KEYS * 99 / 100] * 1e9, lat[RESIZE_KEYS * 9999 / 10000] * 1e9,
+           lat[RESIZE_KEYS - 1] * 1e9);
+}
+
+void bench_resize(void) {
+    printf("\n[resize] %zu inserts, per-insert latency in ns\n", RESIZE_KEYS);
+    double *lat = malloc(RESIZE_KEYS * sizeof(double));
+    printf("  %-14s %8s %10s %10s %12s\n", "mode", "avg", "p99", "p99.99", "max");
+    resize_run("stop-the-world", false, lat);
+    resize_run("incremental", true, lat);
+    free(lat);
+}
+
+
+// ============================================================================
+// Concurrent map
+// ============================================================================
+
+#define CHM_KEYS (1 << 20)
+#define CHM_OPS_PER_THREAD (1 << 19)
+
+ds_chm_declare(BenchCMap, uint64_t, uint64_t);
+
+typedef struct {
+    BenchCMap *cmap;
+    BenchIntMap *map; // single-lock baseline
+    pthread_mutex_t *mutex;
+    uint64_t rng;
+    int write_pct;
+    size_t hits;
+} ChmBenchWorker;
+
+static uint64_t bench_rand(uint64_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static void *chm_bench_worker(void *arg) {
+    ChmBenchWorker *w = arg;
+    size_t hits = 0;
+    for (size_t i = 0; i < CHM_OPS_PER_THREAD; i++) {
+        uint64_t r = bench_rand(&w->rng), key = r % CHM_KEYS;
+        bool write = (int)(r >> 40) % 100 < w->write_pct;
+        if (w->cmap) {
+            if (write) ds_chm_set(w->cmap, key, i);
+            else hits += ds_chm_has(w->cmap, key);
+        } else {
+            pthread_mutex_lock(w->mutex);
+            if (write) ds_hm_set(w->map, key, i);
+            else hits += ds_hm_has(w->map, key);
+            pthread_mutex_unlock(w->mutex);
+        }
+    }
+    w->hits = hits;
+    return NULL;
+}
+
+static double chm_run(int threads, int write_pct, BenchCMap *cmap, BenchIntMap *map) {
+    pthread_t tid[8];
+    ChmBenchWorker w[8];
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    double t0 = now_sec();
+    for (int t = 0; t < threads; t++) {
+        w[t] = (ChmBenchWorker){cmap, map, &mutex, 0x9E3779B97F4A7C15ull * (t + 1), write_pct, 0};
+        pthread_create(&tid[t], NULL, chm_bench_worker, &w[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tid[t], NULL);
+        bench_sink += w[t].hits;
+    }
+    return (double)threads * CHM_OPS_PER_THREAD / (now_sec() - t0) / 1e6;
+}
+
+void bench_chm(void) {
+    printf("\n[chm] %d keys, %d shards, throughput in Mops/s\n", CHM_KEYS, DS_CHM_SHARDS);
+    BenchCMap cmap;
+    ds_chm_init(&cmap);
+    BenchIntMap map = {0};
+    for (uint64_t k = 0; k < CHM_KEYS; k++) {
+        ds_chm_set(&cmap, k, k);
+        ds_hm_set(&map, k, k);
+    }
+    int write_pcts[] = {0, 10, 50};
+    printf("  %-8s %-8s %14s %14s\n", "threads", "writes", "mutex + ds_hm", "ds_chm");
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        for (size_t p = 0; p < DS_ARRAY_LEN(write_pcts); p++) {
+            double base = chm_run(threads, write_pcts[p], NULL, &map);
+            double sharded = chm_run(threads, write_pcts[p], &cmap, NULL);
+            printf("  %-8d %6d%% %14.1f %14.1f\n", threads, write_pcts[p], base, sharded);
+        }
+    }
+    ds_chm_free(&cmap);
+    ds_hm_free(&map);
+}
+
+
+// ============================================================================
+// String key storage
+// ============================================================================
+
+#define KEYS_COUNT (1 << 21)
+
+static void keys_run(const char *name, char **keys, bool arena) {
+    BenchStrMap hm = {0};
+    if (arena) ds_hm_key_arena(&hm, NULL);
+    double t0 = now_sec();
+    for (size_t i = 0; i < KEYS_COUNT; i++) ds_hm_set(&hm, keys[i], i);
+    double t1 = now_sec();
+    ds_hm_clear(&hm);
+    for (size_t i = 0; i < KEYS_COUNT; i++) ds_hm_set(&hm, keys[i], i);
+    double t2 = now_sec();
+    ds_hm_free(&hm);
+    double t3 = now_sec();
+    printf("  %-10s %12.1f %14.1f %12.1f\n", name, (t1 - t0) * 1e9 / KEYS_COUNT,
+           (t2 - t1) * 1e9 / KEYS_COUNT, (t3 - t2) * 1e3);
+}
+
+void bench_keys(void) {
+    printf("\n[keys] %zu short string keys\n", (size_t)KEYS_COUNT);
+    char **keys = malloc(KEYS_COUNT * sizeof(char *));
+    char buf[32];
+    for (size_t i = 0; i < KEYS_COUNT; i++) {
+        snprintf(buf, sizeof(buf), "k%zu", i);
+        keys[i] = strdup(buf);
+    }
+    printf("  %-10s %12s %14s %12s\n", "keys", "insert ns", "clear+refill", "free ms");
+    keys_run("malloc", keys, false);
+    keys_run("arena", keys, true);
+    for (size_t i = 0; i < KEYS_COUNT; i++) free(keys[i]);
+    free(keys);
+}
+
+
+// ============================================================================
+// Batched lookups
+// ============================================================================
+
+#define BATCH_KEYS (1 << 23)
+
+void bench_batch(void) {
+    printf("\n[batch] %zu u64 keys, random-order lookups, ns/key\n", (size_t)BATCH_KEYS);
+    uint64_t *keys = malloc(BATCH_KEYS * sizeof(uint64_t));
+    uint64_t *vals = malloc(BATCH_KEYS * sizeof(uint64_t));
+    uint64_t *probe = malloc(BATCH_KEYS * sizeof(uint64_t));
+    uint64_t s = 0x2545F4914F6CDD1Dull;
+    for (size_t i = 0; i < BATCH_KEYS; i++) {
+        keys[i] = bench_rand(&s);
+        vals[i] = i;
+    }
+    for (size_t i = 0; i < BATCH_KEYS; i++) probe[i] = keys[bench_rand(&s) % BATCH_KEYS];
+
+    BenchIntMap hm = {0};
+    double t0 = now_sec();
+    for (size_t i = 0; i < BATCH_KEYS; i++) ds_hm_set(&hm, keys[i], vals[i]);
+    double t1 = now_sec();
+    ds_hm_free(&hm);
+    ds_hm_set_many(&hm, keys, vals, BATCH_KEYS);
+    double t2 = now_sec();
+    printf("  %-10s %10s %10s\n", "", "one-by-one", "batched");
+    printf("  %-10s %10.1f %10.1f\n", "set", (t1 - t0) * 1e9 / BATCH_KEYS, (t2 - t1) * 1e9 / BATCH_KEYS);
+
+    size_t hits = 0;
+    t0 = now_sec();
+    for (size_t i = 0; i < BATCH_KEYS; i++) hits += ds_hm_get(&hm, probe[i]);
+    t1 = now_sec();
+    hits += ds_hm_get_many(&hm, probe, BATCH_KEYS, vals);
+    t2 = now_sec();
+    printf("  %-10s %10.1f %10.1f\n", "get", (t1 - t0) * 1e9 / BATCH_KEYS, (t2 - t1) * 1e9 / BATCH_KEYS);
+    bench_sink = hits;
+    ds_hm_free(&hm);
+    free(keys);
+    free(vals);
+    free(probe);
+}
+
+
+// ============================================================================
+// Frozen maps
+// ============================================================================
+
+#define FREEZE_KEYS (1 << 20)
+
+static size_t freeze_index_bytes(const BenchIntMap *hm) {
+    const struct ds__ht_idxs *t = &hm->table;
+    if (t->flags & DS__HT_FROZEN) return t->capacity * sizeof(uint32_t);
+    return t->capacity * (t->width + 1);
+}
+
+void bench_freeze(void) {
+    printf("\n[freeze] %zu u64 keys, random-order lookups\n", (size_t)FREEZE_KEYS);
+    uint64_t *probe = malloc(FREEZE_KEYS * sizeof(uint64_t));
+    uint64_t s = 0x9E3779B97F4A7C15ull;
+    BenchIntMap hm = {0};
+    for (size_t i = 0; i < FREEZE_KEYS; i++) ds_hm_set(&hm, bench_rand(&s), i);
+    for (size_t i = 0; i < FREEZE_KEYS; i++) probe[i] = hm.data[bench_rand(&s) % FREEZE_KEYS].key;
+
+    printf("  %-10s %10s %12s %12s\n", "", "ns/lookup", "index bytes", "bytes/key");
+    for (int frozen = 0; frozen < 2; frozen++) {
+        if (frozen) {
+            double f0 = now_sec();
+            if (!ds_hm_freeze(&hm)) printf("  freeze failed\n");
+            printf("  (freeze took %.1f ms)\n", (now_sec() - f0) * 1e3);
+        }
+        size_t hits = 0;
+        double t0 = now_sec();
+        for (size_t i = 0; i < FREEZE_KEYS; i++) hits += ds_hm_get(&hm, probe[i]);
+        double t1 = now_sec();
+        bench_sink = hits;
+        size_t bytes = freeze_index_bytes(&hm);
+        printf("  %-10s %10.1f %12zu %12.2f\n", frozen ? "frozen" : "regular", (t1 - t0) * 1e9 / FREEZE_KEYS,
+               bytes, (double)bytes / FREEZE_KEYS);
+    }
+    ds_hm_free(&hm);
+    free(probe);
+}
+
+
+// ============================================================================
+// Robin Hood probing
+// ============================================================================
+
+/* just under the load factor of a 4M slot table, where clusters are longest */
+#define PROBE_KEYS ((size_t)((1 << 22) * 0.74))
+
+void bench_probe(void) {
+    printf("\n[probe] %zu u64 keys at ~0.74 load, ns/op\n", PROBE_KEYS);
+    printf("  %-12s %10s %10s %10s %10s\n", "", "insert", "hit", "miss", "max probe");
+    for (int rh = 0; rh < 2; rh++) {
+        BenchIntMap hm = {0};
+        if (rh) ds_hm_robin_hood(&hm);
+        uint64_t s = 0x2545F4914F6CDD1Dull;
+        double t0 = now_sec();
+        for (size_t i = 0; i < PROBE_KEYS; i++) ds_hm_set(&hm, bench_rand(&s), i);
+        double t1 = now_sec();
+        size_t hits = 0;
+        for (size_t i = 0; i < PROBE_KEYS; i++) hits += ds_hm_has(&hm, hm.data[bench_rand(&s) % hm.length].key);
+        double t2 = now_sec();
+        for (size_t i = 0; i < PROBE_KEYS; i++) hits += ds_hm_has(&hm, bench_rand(&s));
+        double t3 = now_sec();
+        bench_sink = hits;
+        printf("  %-12s %10.1f %10.1f %10.1f %10zu\n", rh ? "robin hood" : "linear", (t1 - t0) * 1e9 / PROBE_KEYS,
+               (t2 - t1) * 1e9 / PROBE_KEYS, (t3 - t2) * 1e9 / PROBE_KEYS, ds__ht_max_probe(&hm.table));
+        ds_hm_free(&hm);
+    }
+}
+
+
+// ============================================================================
+// Typed maps (ds_hm_declare_ex)
+// ============================================================================
+
+#define TYPED_KEYS (1 << 16)
+#define TYPED_ROUNDS 64
+
+typedef struct {
+    uint32_t a, b, c;
+} BenchKey;
+
+static inline size_t bench_key_hash(const BenchKey *k, size_t seed) {
+    return ds_hash_u64(((uint64_t)k->a << 32 | k->b) ^ ((uint64_t)k->c * 0x9E3779B97F4A7C15ull), seed);
+}
+
+static inline bool bench_key_eq(const BenchKey *x, const BenchKey *y) {
+    return x->a == y->a && x->b == y->b && x->c == y->c;
+}
+
+ds_hm_declare(BenchKeyMap, BenchKey, uint64_t);
+ds_hm_declare_ex(BenchTypedMap, BenchKey, uint64_t, bench_key_hash, bench_key_eq);
+
+void bench_typed(void) {
+    printf("\n[typed] %d 12-byte struct keys (in cache), ns/op\n", TYPED_KEYS);
+    BenchKey *keys = malloc(TYPED_KEYS * sizeof(BenchKey));
+    uint64_t s = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < TYPED_KEYS; i++) {
+        uint64_t r = bench_rand(&s);
+        keys[i] = (BenchKey){(uint32_t)r, (uint32_t)(r >> 32), (uint32_t)i};
+    }
+    BenchKeyMap generic = {0};
+    BenchTypedMap typed = {0};
+    double t0 = now_sec();
+    for (size_t i = 0; i < TYPED_KEYS; i++) ds_hm_set(&generic, keys[i], i);
+    double t1 = now_sec();
+    for (size_t i = 0; i < TYPED_KEYS; i++) BenchTypedMap_set(&typed, keys[i], i);
+    double t2 = now_sec();
+
+    uint64_t sum = 0;
+    double g0 = now_sec();
+    for (int r = 0; r < TYPED_ROUNDS; r++)
+        for (size_t i = 0; i < TYPED_KEYS; i++) sum += *ds_hm_try(&generic, keys[i]);
+    double g1 = now_sec();
+    for (int r = 0; r < TYPED_ROUNDS; r++)
+        for (size_t i = 0; i < TYPED_KEYS; i++) sum += *BenchTypedMap_try(&typed, keys[i]);
+    double g2 = now_sec();
+    bench_sink = sum;
+    double lookups = (double)TYPED_KEYS * TYPED_ROUNDS;
+    printf("  %-10s %10s %10s\n", "", "set", "get");
+    printf("  %-10s %10.1f %10.1f\n", "generic", (t1 - t0) * 1e9 / TYPED_KEYS, (g1 - g0) * 1e9 / lookups);
+    printf("  %-10s %10.1f %10.1f\n", "declare_ex", (t2 - t1) * 1e9 / TYPED_KEYS, (g2 - g1) * 1e9 / lookups);
+    ds_hm_free(&generic);
+    ds_hm_free(&typed);
+    free(keys);
+}
+
+
+// ============================================================================
+// String view lookups
+// ============================================================================
+
+#define VIEW_WORDS 4096
+#define VIEW_ROUNDS 200
+
+void bench_views(void) {
+    printf("\n[views] counting words split from a %d-word buffer, ns/word\n", VIEW_WORDS);
+    DsString text = {0};
+    uint64_t s = 0xC0FFEEull;
+    for (int i = 0; i < VIEW_WORDS; i++) ds_str_appendf(&text, "%sword%u", i ? " " : "", (unsigned)(bench_rand(&s) % 512));
+    BenchStrMap copy = {0}, view = {0};
+    char buf[64];
+
+    double t0 = now_sec();
+    for (int r = 0; r < VIEW_ROUNDS; r++) {
+        DsStringIterator it = ds_str_iter(&text);
+        while (it.length) {
+            DsStringIterator w = ds_s_split(&it, ' ');
+            memcpy(buf, w.data, w.length); /* copy and terminate first */
+            buf[w.length] = '\0';
+            uint64_t *n = ds_hm_try(&copy, buf);
+            if (n) (*n)++;
+            else ds_hm_set(&copy, buf, 1);
+        }
+    }
+    double t1 = now_sec();
+    for (int r = 0; r < VIEW_ROUNDS; r++) {
+        DsStringIterator it = ds_str_iter(&text);
+        while (it.length) {
+            DsStringIterator w = ds_s_split(&it, ' ');
+            uint64_t *n = ds_hm_try_sv(&view, w);
+            if (n) (*n)++;
+            else ds_hm_set_sv(&view, w, 1);
+        }
+    }
+    double t2 = now_sec();
+    double words = (double)VIEW_WORDS * VIEW_ROUNDS;
+    printf("  %-10s %10.1f\n", "copy+try", (t1 - t0) * 1e9 / words);
+    printf("  %-10s %10.1f\n", "try_sv", (t2 - t1) * 1e9 / words);
+    bench_sink = copy.length + view.length;
+    ds_hm_free(&copy);
+    ds_hm_free(&view);
+    ds_da_free(&text);
+}
+
+// ============================================================================
+// Map images (ds_hm_save / ds_hm_map)
+// ============================================================================
+
+#define IMAGE_KEYS (1 << 20)
+#define IMAGE_LOOKUPS (1 << 20)
+
+static double image_lookup_ns(BenchStrMap *hm, char **keys) {
+    uint64_t s = 0xFEEDull, sum = 0;
+    double t0 = now_sec();
+    for (int i = 0; i < IMAGE_LOOKUPS; i++) sum += *ds_hm_try(hm, keys[bench_rand(&s) % IMAGE_KEYS]);
+    double t1 = now_sec();
+    bench_sink = sum;
+    return (t1 - t0) * 1e9 / IMAGE_LOOKUPS;
+}
+
+void bench_image(void) {
+    printf("\n[image] %d string keys: startup (ms) and random lookups (ns)\n", IMAGE_KEYS);
+    const char *path = "/tmp/bench_ds.dshm";
+    char **keys = malloc(IMAGE_KEYS * sizeof(*keys));
+    char buf[32];
+    for (int i = 0; i < IMAGE_KEYS; i++) {
+        snprintf(buf, sizeof(buf), "user:%08x", (unsigned)(i * 2654435761u));
+        keys[i] = strdup(buf);
+    }
+
+    BenchStrMap built = {0};
+    double t0 = now_sec();
+    ds_hm_key_arena(&built, NULL);
+    for (int i = 0; i < IMAGE_KEYS; i++) ds_hm_set(&built, keys[i], (uint64_t)i);
+    double t1 = now_sec();
+    double built_ns = image_lookup_ns(&built, keys);
+    ds_hm_save(&built, path);
+    ds_hm_free(&built);
+
+    BenchStrMap mapped = {0};
+    double t2 = now_sec();
+    ds_hm_map(&mapped, path);
+    double t3 = now_sec();
+    double mapped_ns = image_lookup_ns(&mapped, keys);
+    printf("  %-10s %10s %10s\n", "", "startup", "lookup");
+    printf("  %-10s %10.2f %10.1f\n", "build", (t1 - t0) * 1e3, built_ns);
+    printf("  %-10s %10.2f %10.1f\n", "map", (t3 - t2) * 1e3, mapped_ns);
+    ds_hm_free(&mapped);
+    remove(path);
+    for (int i = 0; i < IMAGE_KEYS; i++) free(keys[i]);
+    free(keys);
+}
+
+
+// ============================================================================
+// Bounded caches (ds_cache_declare)
+// ============================================================================
+
+#define CACHE_CAP (1 << 16)
+#define CACHE_KEYS (1 << 20)
+#define CACHE_OPS (1 << 23)
+
+/* the hand-rolled LRU: a map to heap nodes on a doubly linked recency list */
+typedef struct LruNode {
+    uint64_t key, value;
+    struct LruNode *prev, *next;
+} LruNode;
+ds_hm_declare(BenchLruMap, uint64_t, LruNode *);
+ds_cache_declare(BenchCache, uint64_t, uint64_t, CACHE_CAP);
+
+static void lru_unlink(LruNode **head, LruNode **tail, LruNode *n) {
+    if (n->prev) n->prev->next = n->next;
+    else *head = n->next;
+    if (n->next) n->next->prev = n->prev;
+    else *tail = n->prev;
+}
+
+static void lru_push(LruNode **head, LruNode **tail, LruNode *n) {
+    n->prev = NULL;
+    n->next = *head;
+    if (*head) (*head)->prev = n;
+    else *tail = n;
+    *head = n;
+}
+
+/* skewed keys: small ones are much more frequent */
+static uint64_t cache_key(uint64_t *s) {
+    uint64_t r = bench_rand(s) % CACHE_KEYS;
+    return r * r / CACHE_KEYS * r / CACHE_KEYS;
+}
+
+void bench_cache(void) {
+    printf("\n[cache] %d-entry cache, %d skewed keys, get-or-put, ns/op\n", CACHE_CAP, CACHE_KEYS);
+    uint64_t s = 0xCAC4Eull, hits = 0;
+    BenchLruMap lru = {0};
+    LruNode *head = NULL, *tail = NULL;
+    double t0 = now_sec();
+    for (int i = 0; i < CACHE_OPS; i++) {
+        uint64_t k = cache_key(&s);
+        LruNode **n = ds_hm_try(&lru, k);
+        if (n) {
+            hits++;
+            lru_unlink(&head, &tail, *n);
+            lru_push(&head, &tail, *n);
+            continue;
+        }
+        if (lru.length == CACHE_CAP) {
+            LruNode *old = tail;
+            lru_unlink(&head, &tail, old);
+            ds_hm_remove(&lru, old->key);
+            free(old);
+        }
+        LruNode *node = malloc(sizeof(*node));
+        *node = (LruNode){.key = k, .value = k};
+        lru_push(&head, &tail, node);
+        ds_hm_set(&lru, k, node);
+    }
+    double t1 = now_sec();
+    double lru_hit = (double)hits / CACHE_OPS;
+
+    s = 0xCAC4Eull;
+    BenchCache cache;
+    BenchCache_init(&cache, NULL, NULL);
+    double t2 = now_sec();
+    for (int i = 0; i < CACHE_OPS; i++) {
+        uint64_t k = cache_key(&s);
+        if (!BenchCache_get(&cache, k)) BenchCache_put(&cache, k, k);
+    }
+    double t3 = now_sec();
+    printf("  %-10s %10s %10s\n", "", "ns/op", "hit rate");
+    printf("  %-10s %10.1f %9.1f%%\n", "hm+list", (t1 - t0) * 1e9 / CACHE_OPS, lru_hit * 100);
+    printf("  %-10s %10.1f %9.1f%%\n", "ds_cache", (t3 - t2) * 1e9 / CACHE_OPS,
+           (double)cache.hits / CACHE_OPS * 100);
+    ds_hm_foreach(&lru, kv) free(kv->value);
+    ds_hm_free(&lru);
+    BenchCache_free(&cache);
+}
+
+
+// ============================================================================
+// Bloom filter front for sets (ds_hs_bloom)
+// ============================================================================
+
+#define BLOOM_KEYS (1 << 22)
+#define BLOOM_LOOKUPS (1 << 23)
+
+ds_hs_declare(BenchIntSet, uint64_t);
+
+/* lookups with `hit_pct`% of the keys present */
+static double bloom_lookup_ns(BenchIntSet *set, int hit_pct) {
+    uint64_t s = 0xB100Full;
+    size_t found = 0;
+    double t0 = now_sec();
+    for (int i = 0; i < BLOOM_LOOKUPS; i++) {
+        uint64_t r = bench_rand(&s);
+        uint64_t k = (int)(r % 100) < hit_pct ? (r >> 8) % BLOOM_KEYS : BLOOM_KEYS + (r >> 8);
+        found += ds_hs_has(set, k);
+    }
+    double t1 = now_sec();
+    bench_sink = found;
+    return (t1 - t0) * 1e9 / BLOOM_LOOKUPS;
+}
+
+void bench_bloom(void) {
+    printf("\n[bloom] ds_hs_has on a %d-key set, ns/lookup\n", BLOOM_KEYS);
+    BenchIntSet plain = {0}, front = {0};
+    ds_hs_bloom(&front, 0.01);
+    for (uint64_t i = 0; i < BLOOM_KEYS; i++) {
+        ds_hs_add(&plain, i);
+        ds_hs_add(&front, i);
+    }
+    int hit_pcts[] = {0, 10, 50, 100};
+    printf("  %-10s %10s %10s\n", "hits", "set", "bloom+set");
+    for (size_t i = 0; i < sizeof(hit_pcts) / sizeof(hit_pcts[0]); i++) {
+        double a = 1e9, b = 1e9;
+        for (int r = 0; r < 3; r++) { /* best of 3 */
+            double ta = bloom_lookup_ns(&plain, hit_pcts[i]), tb = bloom_lookup_ns(&front, hit_pcts[i]);
+            if (ta < a) a = ta;
+            if (tb < b) b = tb;
+        }
+        printf("  %9d%% %10.1f %10.1f\n", hit_pcts[i], a, b);
+    }
+    printf("  filter: %.1f bits/key\n",
+           (double)ds__ht_bloom(&front.table)->block_count * 256 / (double)front.length);
+    ds_hs_free(&plain);
+    ds_hs_free(&front);
+}
+
+
+// ============================================================================
+// Set algebra (ds_hs_cat, ds_hs_sub, ds_hs_intersect)
+// ============================================================================
+
+#define SETOPS_KEYS (1 << 22)
+
+static void setops_fill(BenchIntSet *a, BenchIntSet *b) {
+    /* a: [0, N), b: [N/2, 3N/2) in another order */
+    for (uint64_t i = 0; i < SETOPS_KEYS; i++) ds_hs_add(a, i);
+    for (uint64_t i = 0; i < SETOPS_KEYS; i++) ds_hs_add(b, SETOPS_KEYS / 2 + ((i * 2654435761u) % SETOPS_KEYS));
+}
+
+void bench_setops(void) {
+    printf("\n[setops] two %d-value sets overlapping by half, ms\n", SETOPS_KEYS);
+    BenchIntSet a = {0}, b = {0};
+    setops_fill(&a, &b);
+    printf("  %-16s %10s %10s\n", "", "per value", "bulk");
+
+    BenchIntSet u = {0};
+    double t0 = now_sec();
+    ds_hs_foreach(&a, v) ds_hs_add(&u, *v);
+    ds_hs_foreach(&b, v) ds_hs_add(&u, *v);
+    double t1 = now_sec();
+    ds_hs_free(&u);
+    double t2 = now_sec();
+    ds_hs_cat(&u, &a);
+    ds_hs_cat(&u, &b);
+    double t3 = now_sec();
+    printf("  %-16s %10.1f %10.1f\n", "union", (t1 - t0) * 1e3, (t3 - t2) * 1e3);
+
+    size_t n = 0;
+    t0 = now_sec();
+    ds_hs_foreach(&a, v) n += ds_hs_has(&b, *v);
+    t1 = now_sec();
+    t2 = now_sec();
+    size_t m = ds_hs_intersect_count(&a, &b);
+    t3 = now_sec();
+    printf("  %-16s %10.1f %10.1f\n", "intersect_count", (t1 - t0) * 1e3, (t3 - t2) * 1e3);
+    if (n != m) printf("  count mismatch: %zu != %zu\n", n, m);
+
+    BenchIntSet d = {0};
+    ds_hs_cat(&d, &a);
+    t0 = now_sec();
+    ds_hs_foreach(&b, v) ds_hs_remove(&d, *v);
+    t1 = now_sec();
+    ds_hs_free(&d);
+    ds_hs_cat(&d, &a);
+    t2 = now_sec();
+    ds_hs_sub(&d, &b);
+    t3 = now_sec();
+    printf("  %-16s %10.1f %10.1f\n", "difference", (t1 - t0) * 1e3, (t3 - t2) * 1e3);
+
+    BenchIntSet x = {0};
+    ds_hs_cat(&x, &a);
+    t0 = now_sec();
+    for (size_t i = x.length; i-- > 0;) {
+        if (!ds_hs_has(&b, x.data[i])) ds_hs_remove(&x, x.data[i]);
+    }
+    t1 = now_sec();
+    ds_hs_free(&x);
+    ds_hs_cat(&x, &a);
+    t2 = now_sec();
+    ds_hs_intersect(&x, &b);
+    t3 = now_sec();
+    printf("  %-16s %10.1f %10.1f\n", "intersect", (t1 - t0) * 1e3, (t3 - t2) * 1e3);
+
+    bench_sink = u.length + d.length + x.length + n;
+    ds_hs_free(&a);
+    ds_hs_free(&b);
+    ds_hs_free(&u);
+    ds_hs_free(&d);
+    ds_hs_free(&x);
+}
+
+
+// ============================================================================
+// Ordered map (ds_btree_declare)
+// ============================================================================
+
+#define BTREE_KEYS (1 << 20)
+#define BTREE_RANGES (1 << 16)
+#define BTREE_RANGE_LEN 64
+
+ds_btree_declare(BenchTree, uint64_t, uint64_t);
+
+static int btree_cmp_entry(const void *a, const void *b) {
+    uint64_t x = ((const BenchTree_Entry *)a)->key, y = ((const BenchTree_Entry *)b)->key;
+    return (x > y) - (x < y);
+}
+
+void bench_btree(void) {
+    printf("\n[btree] %d random keys\n", BTREE_KEYS);
+    BenchIntMap map = {0};
+    BenchTree tree = {0};
+    uint64_t s = 0xB7EEull;
+    double t0 = now_sec();
+    for (int i = 0; i < BTREE_KEYS; i++) {
+        uint64_t k = bench_rand(&s);
+        ds_hm_set(&map, k, k);
+    }
+    double t1 = now_sec();
+    s = 0xB7EEull;
+    for (int i = 0; i < BTREE_KEYS; i++) {
+        uint64_t k = bench_rand(&s);
+        BenchTree_set(&tree, k, k);
+    }
+    double t2 = now_sec();
+    printf("  %-24s %10s %10s\n", "", "ds_hm", "ds_btree");
+    printf("  %-24s %10.1f %10.1f\n", "insert, ns/key", (t1 - t0) * 1e9 / BTREE_KEYS,
+           (t2 - t1) * 1e9 / BTREE_KEYS);
+
+    size_t found = 0;
+    s = 0xB7EEull;
+    t0 = now_sec();
+    for (int i = 0; i < BTREE_KEYS; i++) found += ds_hm_try(&map, bench_rand(&s)) != NULL;
+    t1 = now_sec();
+    s = 0xB7EEull;
+    for (int i = 0; i < BTREE_KEYS; i++) found += BenchTree_get(&tree, bench_rand(&s)) != NULL;
+    t2 = now_sec();
+    printf("  %-24s %10.1f %10.1f\n", "lookup, ns/key", (t1 - t0) * 1e9 / BTREE_KEYS,
+           (t2 - t1) * 1e9 / BTREE_KEYS);
+
+    /* ordered walk: copy the map's entries out and sort them, or follow the leaves */
+    uint64_t sum = 0;
+    t0 = now_sec();
+    BenchTree_Entry *sorted = malloc(map.length * sizeof(*sorted));
+    for (size_t i = 0; i < map.length; i++) sorted[i] = (BenchTree_Entry){map.data[i].key, map.data[i].value};
+    qsort(sorted, map.length, sizeof(*sorted), btree_cmp_entry);
+    for (size_t i = 0; i < map.length; i++) sum += sorted[i].value;
+    t1 = now_sec();
+    for (BenchTree_Iter it = BenchTree_first(&tree); it.key; BenchTree_next(&it)) sum += *it.value;
+    t2 = now_sec();
+    printf("  %-24s %10.1f %10.1f\n", "ordered walk, ms", (t1 - t0) * 1e3, (t2 - t1) * 1e3);
+
+    /* range queries on the sorted copy (binary search) and on the tree */
+    s = 0x5CA4ull;
+    t0 = now_sec();
+    for (int i = 0; i < BTREE_RANGES; i++) {
+        uint64_t lo = bench_rand(&s);
+        size_t a = 0, b = map.length;
+        while (a < b) {
+            size_t m = a + (b - a) / 2;
+            if (sorted[m].key < lo) a = m + 1;
+            else b = m;
+        }
+        for (size_t j = a; j < map.length && j < a + BTREE_RANGE_LEN; j++) sum += sorted[j].value;
+    }
+    t1 = now_sec();
+    s = 0x5CA4ull;
+    for (int i = 0; i < BTREE_RANGES; i++) {
+        BenchTree_Iter it = BenchTree_lower_bound(&tree, bench_rand(&s));
+        for (int j = 0; it.key && j < BTREE_RANGE_LEN; j++, BenchTree_next(&it)) sum += *it.value;
+    }
+    t2 = now_sec();
+    printf("  %-24s %10.1f %10.1f   (sorted copy)\n", "range of 64, ns", (t1 - t0) * 1e9 / BTREE_RANGES,
+           (t2 - t1) * 1e9 / BTREE_RANGES);
+
+    BenchTree bulk = {0};
+    t0 = now_sec();
+    BenchTree_load(&bulk, sorted, map.length);
+    t1 = now_sec();
+    printf("  %-24s %10s %10.1f\n", "bulk load, ms", "", (t1 - t0) * 1e3);
+
+    bench_sink = found + sum + bulk.length;
+    free(sorted);
+    ds_hm_free(&map);
+    BenchTree_free(&tree);
+    BenchTree_free(&bulk);
+}
+
+
+// ============================================================================
+// Flat maps for small key sets (ds_fm_declare)
+// ============================================================================
+
+#define FM_MAPS 20000
+#define FM_LOOKUPS (1 << 23)
+
+ds_fm_declare(BenchFlat, uint64_t, uint64_t);
+
+static size_t heap_in_use(void) {
+#ifdef __GLIBC__
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+void bench_flatmap(void) {
+    printf("\n[flatmap] %d maps of n keys\n", FM_MAPS);
+    printf("  %-6s %12s %12s %12s %12s\n", "n", "hm B/map", "fm B/map", "hm ns/get", "fm ns/get");
+    int sizes[] = {4, 8, 16, 32, 64};
+    for (size_t si = 0; si < sizeof(sizes) / sizeof(sizes[0]); si++) {
+        int n = sizes[si];
+        BenchIntMap *hms = calloc(FM_MAPS, sizeof(*hms));
+        BenchFlat *fms = calloc(FM_MAPS, sizeof(*fms));
+        size_t h0 = heap_in_use();
+        for (int m = 0; m < FM_MAPS; m++) {
+            for (int k = 0; k < n; k++) ds_hm_set(&hms[m], (uint64_t)k * 7919, (uint64_t)k);
+        }
+        size_t h1 = heap_in_use();
+        for (int m = 0; m < FM_MAPS; m++) {
+            for (int k = 0; k < n; k++) BenchFlat_set(&fms[m], (uint64_t)k * 7919, (uint64_t)k);
+        }
+        size_t h2 = heap_in_use();
+
+        uint64_t s = 0xF1A7ull, sum = 0;
+        double t0 = now_sec();
+        for (int i = 0; i < FM_LOOKUPS; i++) {
+            uint64_t r = bench_rand(&s);
+            uint64_t *v = ds_hm_try(&hms[r % FM_MAPS], ((r >> 32) % (uint64_t)n) * 7919);
+            sum += v ? *v : 0;
+        }
+        double t1 = now_sec();
+        s = 0xF1A7ull;
+        for (int i = 0; i < FM_LOOKUPS; i++) {
+            uint64_t r = bench_rand(&s);
+            uint64_t *v = BenchFlat_get(&fms[r % FM_MAPS], ((r >> 32) % (uint64_t)n) * 7919);
+            sum += v ? *v : 0;
+        }
+        double t2 = now_sec();
+        printf("  %-6d %12.0f %12.0f %12.1f %12.1f\n", n, (double)(h1 - h0) / FM_MAPS,
+               (double)(h2 - h1) / FM_MAPS, (t1 - t0) * 1e9 / FM_LOOKUPS, (t2 - t1) * 1e9 / FM_LOOKUPS);
+        bench_sink = sum;
+        for (int m = 0; m < FM_MAPS; m++) {
+            ds_hm_free(&hms[m]);
+            BenchFlat_free(&fms[m]);
+        }
+        free(hms);
+        free(fms);
+    }
+}
+
+// ============================================================================
+// Map statistics (ds_hm_stats)
+// ============================================================================
+
+#define STATS_KEYS (1 << 20)
+
+static void stats_print(const char *name, const DsHmStats *st, double ms) {
+    printf("  %-14s %6.3f %8.2f %8zu %8zu %10zu %10zu %10zu %8.1f  [", name, st->load_factor,
+           st->mean_displacement, st->max_displacement, st->resizes, st->index_bytes >> 10,
+           st->entry_bytes >> 10, st->key_bytes >> 10, ms);
+    for (size_t i = 0; i < DS_HM_STATS_HIST; i++) printf(i ? " %zu" : "%zu", st->probe_hist[i]);
+    printf("]\n");
+}
+
+void bench_stats(void) {
+    printf("\n[stats] ds_hm_stats on %d-key maps (bytes in KiB, walk in ms)\n", STATS_KEYS);
+    printf("  %-14s %6s %8s %8s %8s %10s %10s %10s %8s  %s\n", "", "load", "mean", "max", "resizes",
+           "index", "entries", "keys", "walk", "probe groups");
+    BenchIntMap im = {0};
+    BenchStrMap sm = {0};
+    char buf[32];
+    for (uint64_t i = 0; i < STATS_KEYS; i++) {
+        ds_hm_set(&im, i << 12, i);
+        snprintf(buf, sizeof(buf), "user:%llu", (unsigned long long)i);
+        ds_hm_set(&sm, buf, i);
+    }
+    DsHmStats st;
+    double t0 = now_sec();
+    ds_hm_stats(&im, &st);
+    double t1 = now_sec();
+    stats_print("u64 stride", &st, (t1 - t0) * 1e3);
+    t0 = now_sec();
+    ds_hm_stats(&sm, &st);
+    t1 = now_sec();
+    stats_print("strings", &st, (t1 - t0) * 1e3);
+    for (uint64_t i = 0; i < STATS_KEYS - STATS_KEYS / 16; i++) ds_hm_remove(&im, i << 12);
+    ds_hm_stats(&im, &st);
+    stats_print("after removes", &st, 0);
+    ds_hm_shrink(&im);
+    ds_hm_stats(&im, &st);
+    stats_print("after shrink", &st, 0);
+    ds_hm_free(&im);
+    ds_hm_free(&sm);
+}
+
+
+// ============================================================================
+// Sorting (ds_sort_declare, ds_da_radix_sort)
+// ============================================================================
+
+#define SORT_N 10000000
+
+ds_da_declare(BenchU64Array, uint64_t);
+ds_sort_declare(BenchU64Sort, uint64_t);
+
+typedef struct {
+    uint64_t key;
+    uint64_t payload;
+} BenchRecord;
+ds_da_declare(BenchRecords, BenchRecord);
+#define bench_record_less(a, b) ((a).key < (b).key)
+ds_sort_declare_ex(BenchRecordSort, BenchRecord, bench_record_less);
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_record(const void *a, const void *b) {
+    return cmp_u64(&((const BenchRecord *)a)->key, &((const BenchRecord *)b)->key);
+}
+
+void bench_sort(void) {
+    printf("\n[sort] %d items, ms\n", SORT_N);
+    printf("  %-22s %10s %10s %10s %10s\n", "", "qsort", "pdqsort", "stable", "radix");
+    BenchU64Array src = {0}, a = {0};
+    uint64_t s = 0x5027ull;
+    for (size_t i = 0; i < SORT_N; i++) ds_da_append(&src, bench_rand(&s));
+    ds_da_reserve(&a, SORT_N);
+    a.length = SORT_N;
+    const char *inputs[] = {"u64 random", "u64 sorted", "u64 256 distinct"};
+    for (int in = 0; in < 3; in++) {
+        if (in == 1) ds_da_sort(&src, BenchU64Sort);
+        if (in == 2) ds_da_foreach(&src, x) *x = bench_rand(&s) & 0xff;
+        double ms[4];
+        for (int alg = 0; alg < 4; alg++) {
+            memcpy(a.data, src.data, SORT_N * sizeof(uint64_t));
+            double t0 = now_sec();
+            switch (alg) {
+            case 0: qsort(a.data, a.length, sizeof(uint64_t), cmp_u64); break;
+            case 1: ds_da_sort(&a, BenchU64Sort); break;
+            case 2: ds_da_stable_sort(&a, BenchU64Sort); break;
+            default: ds_da_radix_sort(&a); break;
+            }
+            ms[alg] = (now_sec() - t0) * 1e3;
+            if (!BenchU64Sort_is_sorted(a.data, a.length)) printf("  not sorted!\n");
+        }
+        printf("  %-22s %10.0f %10.0f %10.0f %10.0f\n", inputs[in], ms[0], ms[1], ms[2], ms[3]);
+    }
+    ds_da_free(&a);
+    ds_da_free(&src);
+
+    BenchRecords rsrc = {0}, r = {0};
+    for (size_t i = 0; i < SORT_N; i++) ds_da_append(&rsrc, ((BenchRecord){bench_rand(&s), i}));
+    ds_da_reserve(&r, SORT_N);
+    r.length = SORT_N;
+    double ms[4];
+    for (int alg = 0; alg < 4; alg++) {
+        memcpy(r.data, rsrc.data, SORT_N * sizeof(BenchRecord));
+        double t0 = now_sec();
+        switch (alg) {
+        case 0: qsort(r.data, r.length, sizeof(BenchRecord), cmp_record); break;
+        case 1: ds_da_sort(&r, BenchRecordSort); break;
+        case 2: ds_da_stable_sort(&r, BenchRecordSort); break;
+        default: ds_da_radix_sort_by(&r, key); break;
+        }
+        ms[alg] = (now_sec() - t0) * 1e3;
+    }
+    printf("  %-22s %10.0f %10.0f %10.0f %10.0f\n", "16-byte records by key", ms[0], ms[1], ms[2], ms[3]);
+    ds_da_free(&r);
+    ds_da_free(&rsrc);
+}
+
+// ============================================================================
+// Small-buffer arrays (ds_sda_declare)
+// ============================================================================
+
+#define SDA_OBJECTS 1000000
+
+ds_da_declare(BenchTinyDa, uint32_t);
+ds_sda_declare(BenchTinySda, uint32_t, 4);
+
+typedef struct {
+    uint64_t id;
+    BenchTinyDa tags;
+} BenchObjDa;
+
+typedef struct {
+    uint64_t id;
+    BenchTinySda tags;
+} BenchObjSda;
+
+void bench_sda(void) {
+    printf("\n[sda] %d objects with a list of n tags: build, sum, free\n", SDA_OBJECTS);
+    printf("  %-4s %12s %12s %12s %12s\n", "n", "da ms", "sda ms", "da B/obj", "sda B/obj");
+    int sizes[] = {1, 3, 4, 8};
+    for (size_t si = 0; si < sizeof(sizes) / sizeof(sizes[0]); si++) {
+        int n = sizes[si];
+        uint64_t sum = 0;
+        BenchObjDa *da = malloc(SDA_OBJECTS * sizeof(*da));
+        size_t h0 = heap_in_use();
+        double t0 = now_sec();
+        for (size_t i = 0; i < SDA_OBJECTS; i++) {
+            da[i] = (BenchObjDa){.id = i};
+            for (int k = 0; k < n; k++) ds_da_append(&da[i].tags, (uint32_t)(i + k));
+        }
+        size_t h1 = heap_in_use();
+        for (size_t i = 0; i < SDA_OBJECTS; i++) ds_da_foreach(&da[i].tags, t) sum += *t;
+        for (size_t i = 0; i < SDA_OBJECTS; i++) ds_da_free(&da[i].tags);
+        double t1 = now_sec();
+        free(da);
+
+        BenchObjSda *sda = malloc(SDA_OBJECTS * sizeof(*sda));
+        size_t h2 = heap_in_use();
+        double t2 = now_sec();
+        for (size_t i = 0; i < SDA_OBJECTS; i++) {
+            sda[i] = (BenchObjSda){.id = i};
+            ds_sda_reset(&sda[i].tags);
+            for (int k = 0; k < n; k++) ds_da_append(&sda[i].tags, (uint32_t)(i + k));
+        }
+        size_t h3 = heap_in_use();
+        for (size_t i = 0; i < SDA_OBJECTS; i++) ds_da_foreach(&sda[i].tags, t) sum += *t;
+        for (size_t i = 0; i < SDA_OBJECTS; i++) ds_da_free(&sda[i].tags);
+        double t3 = now_sec();
+        free(sda);
+        bench_sink = sum;
+        printf("  %-4d %12.1f %12.1f %12.0f %12.0f\n", n, (t1 - t0) * 1e3, (t3 - t2) * 1e3,
+               sizeof(BenchObjDa) + (double)(h1 - h0) / SDA_OBJECTS,
+               sizeof(BenchObjSda) + (double)(h3 - h2) / SDA_OBJECTS);
+    }
+}
+
+// ============================================================================
+// Segmented arrays (ds_seg_declare)
+// ============================================================================
+
+#define SEG_N 50000000
+#define SEG_LOOKUPS 10000000
+
+ds_seg_declare(BenchU64Seg, uint64_t);
+
+void bench_seg(void) {
+    printf("\n[seg] %d u64 items, ds_da vs ds_seg\n", SEG_N);
+    printf("  %-8s %12s %12s %14s\n", "", "append ms", "sum ms", "random ns/get");
+    uint64_t sum = 0, s = 0x5E6ull;
+
+    BenchU64Array da = {0};
+    double t0 = now_sec();
+    for (uint64_t i = 0; i < SEG_N; i++) ds_da_append(&da, i);
+    double t1 = now_sec();
+    ds_da_foreach(&da, x) sum += *x;
+    double t2 = now_sec();
+    for (int i = 0; i < SEG_LOOKUPS; i++) sum += da.data[bench_rand(&s) % SEG_N];
+    double t3 = now_sec();
+    printf("  %-8s %12.0f %12.0f %14.1f\n", "da", (t1 - t0) * 1e3, (t2 - t1) * 1e3, (t3 - t2) * 1e9 / SEG_LOOKUPS);
+    ds_da_free(&da);
+
+    BenchU64Seg seg = {0};
+    t0 = now_sec();
+    for (uint64_t i = 0; i < SEG_N; i++) ds_seg_append(&seg, i);
+    t1 = now_sec();
+    ds_seg_foreach(&seg, x) sum += *x;
+    t2 = now_sec();
+    s = 0x5E6ull;
+    for (int i = 0; i < SEG_LOOKUPS; i++) sum += *ds_seg_at(&seg, bench_rand(&s) % SEG_N);
+    t3 = now_sec();
+    printf("  %-8s %12.0f %12.0f %14.1f\n", "seg", (t1 - t0) * 1e3, (t2 - t1) * 1e3, (t3 - t2) * 1e9 / SEG_LOOKUPS);
+    ds_seg_free(&seg);
+    bench_sink = sum;
+}
+
+// ============================================================================
+// Large arrays (DS_DA_LARGE_THRESHOLD)
+// ============================================================================
+
+#define LARGE_N (128u << 20)
+
+// peak resident set since the last reset, in MB (Linux only)
+static double peak_rss_mb(bool reset) {
+    FILE *f = fopen(reset ? "/proc/self/clear_refs" : "/proc/self/status", reset ? "w" : "r");
+    if (!f) return 0;
+    double mb = 0;
+    if (reset) {
+        fputs("5", f);
+    } else {
+        char line[256];
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "VmHWM:", 6) == 0) mb = atof(line + 6) / 1024;
+        }
+    }
+    fclose(f);
+    return mb;
+}
+
+void bench_large(void) {
+#ifdef DS_DA_LARGE_THRESHOLD
+    const char *mode = "mapped";
+#else
+    const char *mode = "heap";
+#endif
+    printf("\n[large] %u u64 appends (%u MB), %s blocks\n", LARGE_N, LARGE_N >> 17, mode);
+    printf("  %-10s %12s %12s %12s\n", "", "grow ms", "peak MB", "shrink ms");
+    BenchU64Array a = {0};
+    peak_rss_mb(true);
+    double base = peak_rss_mb(false);
+    double t0 = now_sec();
+    for (uint64_t i = 0; i < LARGE_N; i++) ds_da_append(&a, i);
+    double t1 = now_sec();
+    double peak = peak_rss_mb(false) - base;
+    a.length /= 4;
+    ds_da_shrink(&a);
+    double t2 = now_sec();
+    printf("  %-10s %12.0f %12.0f %12.2f\n", mode, (t1 - t0) * 1e3, peak, (t2 - t1) * 1e3);
+    bench_sink = a.data[a.length - 1];
+    ds_da_free(&a);
+}
+
+// ============================================================================
+// Ring buffers (ds_rb_declare)
+// ============================================================================
+
+#define RB_OPS 20000000
+#define RB_BATCH 64
+
+ds_ll_declare(BenchU64List, uint64_t);
+ds_rb_declare(BenchU64Ring, uint64_t);
+
+// keeps `depth` items queued and cycles RB_OPS items through
+void bench_rb(void) {
+    printf("\n[rb] work queue, %d items through, ds_ll vs ds_rb\n", RB_OPS);
+    printf("  %-8s %12s %12s %16s\n", "depth", "ll ms", "rb ms", "rb bulk ms");
+    uint64_t sum = 0;
+    int depths[] = {16, 1024, 65536};
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        int depth = depths[d];
+
+        BenchU64List ll = {0};
+        double t0 = now_sec();
+        for (int i = 0; i < depth; i++) ds_ll_append(&ll, (uint64_t)i);
+        for (int i = 0; i < RB_OPS; i++) {
+            BenchU64List_Node *n = ds_ll_pop(&ll);
+            sum += n->val;
+            DS_FREE(n);
+            ds_ll_append(&ll, (uint64_t)i);
+        }
+        ds_ll_free(&ll);
+        double t1 = now_sec();
+
+        BenchU64Ring rb = {0};
+        double t2 = now_sec();
+        for (int i = 0; i < depth; i++) ds_rb_push_back(&rb, (uint64_t)i);
+        for (int i = 0; i < RB_OPS; i++) {
+            sum += ds_rb_pop_front(&rb);
+            ds_rb_push_back(&rb, (uint64_t)i);
+        }
+        ds_rb_free(&rb);
+        double t3 = now_sec();
+
+        uint64_t batch[RB_BATCH];
+        rb = (BenchU64Ring){0};
+        double t4 = now_sec();
+        for (int i = 0; i < depth; i++) ds_rb_push_back(&rb, (uint64_t)i);
+        for (int i = 0; i < RB_OPS; i += RB_BATCH) {
+            size_t got = ds_rb_pop_front_many(&rb, batch, RB_BATCH);
+            for (size_t k = 0; k < got; k++) sum += batch[k];
+            for (int k = 0; k < RB_BATCH; k++) batch[k] = (uint64_t)(i + k);
+            ds_rb_push_back_many(&rb, batch, RB_BATCH);
+        }
+        ds_rb_free(&rb);
+        double t5 = now_sec();
+        printf("  %-8d %12.0f %12.0f %16.0f\n", depth, (t1 - t0) * 1e3, (t3 - t2) * 1e3, (t5 - t4) * 1e3);
+    }
+    bench_sink = sum;
+}
+
+// ============================================================================
+// Lock-free queues (ds_spsc_declare, ds_mpmc_declare)
+// ============================================================================
+
+#define QUEUE_ITEMS 4000000
+#define QUEUE_ROUNDTRIPS 200000
+#define QUEUE_CAPACITY 1024
+#define QUEUE_BATCH 32
+
+ds_spsc_declare(BenchU64Spsc, uint64_t);
+ds_mpmc_declare(BenchU64Mpmc, uint64_t);
+
+// the previous handoff: a ds_ll behind a mutex
+typedef struct {
+    pthread_mutex_t lock;
+    BenchU64List list;
+} BenchLockedList;
+
+typedef struct {
+    int kind; // 0 locked list, 1 spsc, 2 spsc batched, 3 mpmc
+    void *q;
+    uint64_t items, sum;
+    int *done;
+} QueueWorker;
+
+static void *queue_producer(void *arg) {
+    QueueWorker *w = arg;
+    uint64_t batch[QUEUE_BATCH];
+    for (uint64_t i = 0; i < w->items;) {
+        switch (w->kind) {
+        case 0: {
+            BenchLockedList *l = w->q;
+            pthread_mutex_lock(&l->lock);
+            ds_ll_append(&l->list, i);
+            pthread_mutex_unlock(&l->lock);
+            i++;
+        } break;
+        case 1:
+            if (ds_spsc_push((BenchU64Spsc *)w->q, i)) i++;
+            else sched_yield();
+            break;
+        case 2: {
+            size_t n = w->items - i < QUEUE_BATCH ? w->items - i : QUEUE_BATCH;
+            for (size_t k = 0; k < n; k++) batch[k] = i + k;
+            size_t sent = ds_spsc_push_many((BenchU64Spsc *)w->q, batch, n);
+            if (!sent) sched_yield();
+            i += sent;
+            // the items not sent are rebuilt on the next round
+        } break;
+        default:
+            if (ds_mpmc_push((BenchU64Mpmc *)w->q, i)) i++;
+            else sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *queue_consumer(void *arg) {
+    QueueWorker *w = arg;
+    uint64_t batch[QUEUE_BATCH], v;
+    for (uint64_t got = 0; w->done ? __atomic_load_n(w->done, __ATOMIC_RELAXED) < (int)w->items : got < w->items;) {
+        size_t n = 0;
+        switch (w->kind) {
+        case 0: {
+            BenchLockedList *l = w->q;
+            pthread_mutex_lock(&l->lock);
+            if (l->list.head) {
+                BenchU64List_Node *node = ds_ll_pop(&l->list);
+                w->sum += node->val;
+                DS_FREE(node);
+                n = 1;
+            }
+            pthread_mutex_unlock(&l->lock);
+        } break;
+        case 1:
+            if (ds_spsc_pop((BenchU64Spsc *)w->q, &v)) w->sum += v, n = 1;
+            break;
+        case 2:
+            n = ds_spsc_pop_many((BenchU64Spsc *)w->q, batch, QUEUE_BATCH);
+            for (size_t k = 0; k < n; k++) w->sum += batch[k];
+            break;
+        default:
+            if (ds_mpmc_pop((BenchU64Mpmc *)w->q, &v)) w->sum += v, n = 1;
+        }
+        if (!n) sched_yield();
+        got += n;
+        if (w->done && n) __atomic_fetch_add(w->done, (int)n, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+// one producer and one consumer thread; ns per item
+static double queue_pair(int kind, void *q) {
+    QueueWorker p = {.kind = kind, .q = q, .items = QUEUE_ITEMS};
+    QueueWorker c = p;
+    pthread_t tp, tc;
+    double t0 = now_sec();
+    pthread_create(&tc, NULL, queue_consumer, &c);
+    pthread_create(&tp, NULL, queue_producer, &p);
+    pthread_join(tp, NULL);
+    pthread_join(tc, NULL);
+    double t1 = now_sec();
+    bench_sink += c.sum;
+    return (t1 - t0) * 1e9 / QUEUE_ITEMS;
+}
+
+typedef struct {
+    BenchU64Spsc *ping, *pong;
+} QueuePingPong;
+
+static void *queue_echo(void *arg) {
+    QueuePingPong *pp = arg;
+    uint64_t v;
+    for (int i = 0; i < QUEUE_ROUNDTRIPS; i++) {
+        while (!ds_spsc_pop(pp->ping, &v)) sched_yield();
+        while (!ds_spsc_push(pp->pong, v)) sched_yield();
+    }
+    return NULL;
+}
+
+void bench_queue(void) {
+    printf("\n[queue] %d u64 items from one thread to another, ns/item\n", QUEUE_ITEMS);
+    printf("  %-24s %10s\n", "", "ns/item");
+    BenchLockedList l = {0};
+    pthread_mutex_init(&l.lock, NULL);
+    printf("  %-24s %10.1f\n", "mutex + ds_ll", queue_pair(0, &l));
+    pthread_mutex_destroy(&l.lock);
+    BenchU64Spsc s;
+    ds_spsc_init(&s, QUEUE_CAPACITY);
+    printf("  %-24s %10.1f\n", "spsc", queue_pair(1, &s));
+    printf("  %-24s %10.1f\n", "spsc batch x32", queue_pair(2, &s));
+    BenchU64Mpmc m;
+    ds_mpmc_init(&m, QUEUE_CAPACITY);
+    printf("  %-24s %10.1f\n", "mpmc", queue_pair(3, &m));
+
+    BenchU64Spsc pong;
+    ds_spsc_init(&pong, QUEUE_CAPACITY);
+    QueuePingPong pp = {&s, &pong};
+    pthread_t echo;
+    uint64_t v;
+    double t0 = now_sec();
+    pthread_create(&echo, NULL, queue_echo, &pp);
+    for (int i = 0; i < QUEUE_ROUNDTRIPS; i++) {
+        while (!ds_spsc_push(&s, (uint64_t)i)) sched_yield();
+        while (!ds_spsc_pop(&pong, &v)) sched_yield();
+    }
+    pthread_join(echo, NULL);
+    double t1 = now_sec();
+    printf("  %-24s %10.1f\n", "spsc round trip latency", (t1 - t0) * 1e9 / QUEUE_ROUNDTRIPS);
+    ds_spsc_free(&pong);
+    ds_spsc_free(&s);
+
+    printf("  mpmc, N producers and N consumers:\n");
+    printf("  %-24s %10s\n", "threads", "ns/item");
+    for (int n = 1; n <= 4; n *= 2) {
+        QueueWorker workers[8];
+        pthread_t threads[8];
+        int done = 0;
+        double t2 = now_sec();
+        for (int t = 0; t < 2 * n; t++) {
+            workers[t] = (QueueWorker){.kind = 3, .q = &m, .items = QUEUE_ITEMS / n};
+            if (t >= n) workers[t].done = &done, workers[t].items = QUEUE_ITEMS / n * n;
+            pthread_create(&threads[t], NULL, t < n ? queue_producer : queue_consumer, &workers[t]);
+        }
+        for (int t = 0; t < 2 * n; t++) {
+            pthread_join(threads[t], NULL);
+            bench_sink += workers[t].sum;
+        }
+        double t3 = now_sec();
+        printf("  %-24d %10.1f\n", 2 * n, (t3 - t2) * 1e9 / QUEUE_ITEMS);
+    }
+    ds_mpmc_free(&m);
+}
+
+int main(int argc, char **argv) {
+    setbuf(stdout, NULL);
+    printf("=== ds.h Benchmarks ===\n");
+    if (section_enabled(argc, argv, "hash")) bench_hash();
+    if (section_enabled(argc, argv, "resize")) bench_resize();
+    if (section_enabled(argc, argv, "chm")) bench_chm();
+    if (section_enabled(argc, argv, "keys")) bench_keys();
+    if (section_enabled(argc, argv, "batch")) bench_batch();
+    if (section_enabled(argc, argv, "freeze")) bench_freeze();
+    if (section_enabled(argc, argv, "probe")) bench_probe();
+    if (section_enabled(argc, argv, "typed")) bench_typed();
+    if (section_enabled(argc, argv, "views")) bench_views();
+    if (section_enabled(argc, argv, "image")) bench_image();
+    if (section_enabled(argc, argv, "cache")) bench_cache();
+    if (section_enabled(argc, argv, "bloom")) bench_bloom();
+    if (section_enabled(argc, argv, "setops")) bench_setops();
+    if (section_enabled(argc, argv, "btree")) bench_btree();
+    if (section_enabled(argc, argv, "flatmap")) bench_flatmap();
+    if (section_enabled(argc, argv, "stats")) bench_stats();
+    if (section_enabled(argc, argv, "sort")) bench_sort();
+    if (section_enabled(argc, argv, "sda")) bench_sda();
+    if (section_enabled(argc, argv, "seg")) bench_seg();
+    if (section_enabled(argc, argv, "large")) bench_large();
+    if (section_enabled(argc, argv, "rb")) bench_rb();
+    if (section_enabled(argc, argv, "queue")) bench_queue();
+    return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/bash
+set -e
+mkdir -p tests/build
+cc -O2 -pthread tests/bench_ds.c -o tests/build/bench_ds
+cc -O2 -pthread -DBENCH_LEGACY_HASH tests/bench_ds.c -o tests/build/bench_ds_legacy_hash
+
+echo "Running benchmarks..."
+./tests/build/bench_ds "$@"
+./tests/build/bench_ds_legacy_hash hash
@@ -1,10 +1,17 @@
 #define DS_IMPLEMENTATION
+#define DS_CHM
 #include "../ds.h"
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <assert.h>
 #include <unistd.h>
 
+#ifndef TEST_DS_CONFIG
+#define TEST_DS_CONFIG "" // set by the suites that rerun this one with other options
+#endif
+
 static int tests_run = 0;
 static int tests_passed = 0;
 static int tests_failed = 0;
@@ -865,6 +872,82 @@ void test_hs_sub(void) {
     PASS();
 }
 
+void test_hs_intersect(void) {
+    TEST("hs: intersect keeps common elements, either set smaller");
+    for (int big = 0; big < 2; big++) {
+        IntSet a = {0}, b = {0};
+        for (int i = 0; i < 3000; i++) ds_hs_add(&a, i * 2);
+        for (int i = 0; i < (big ? 20000 : 1000); i++) ds_hs_add(&b, i * 3);
+        size_t expected = 0;
+        ds_hs_foreach(&a, v) expected += *v % 3 == 0 && *v < (big ? 60000 : 3000);
+        ASSERT_EQ(ds_hs_intersect_count(&a, &b), expected, "count");
+        ASSERT_EQ(ds_hs_intersect_count(&b, &a), expected, "count is symmetric");
+        int first = -1;
+        ds_hs_foreach(&a, v) if (first < 0 && *v % 3 == 0) first = *v;
+        ds_hs_intersect(&a, &b);
+        ASSERT_EQ(a.length, expected, "length");
+        ASSERT_EQ(a.data[0], first, "order kept");
+        for (int i = 0; i < 6000; i++)
+            ASSERT_EQ(ds_hs_has(&a, i), i % 6 == 0 && i < (big ? 60000 : 3000), "membership");
+        ds_hs_add(&a, 1);
+        ASSERT(ds_hs_has(&a, 1), "usable after");
+        ds_hs_free(&a);
+        ds_hs_free(&b);
+    }
+    PASS();
+}
+
+void test_hs_set_ops_large(void) {
+    TEST("hs: cat, sub and intersect on threaded sizes");
+    IntSet a = {0}, b = {0}, u = {0};
+    ds_hs_store_hash(&b);
+    for (int i = 0; i < 50000; i++) ds_hs_add(&a, i);
+    for (int i = 25000; i < 100000; i++) ds_hs_add(&b, i);
+    ASSERT_EQ(ds_hs_intersect_count(&a, &b), 25000, "overlap");
+    ds_hs_cat(&u, &a);
+    ds_hs_cat(&u, &b);
+    ASSERT_EQ(u.length, 100000, "union");
+    ds_hs_sub(&u, &a);
+    ASSERT_EQ(u.length, 50000, "difference");
+    for (int i = 0; i < 100000; i += 7) ASSERT_EQ(ds_hs_has(&u, i), i >= 50000, "difference membership");
+    ds_hs_intersect(&b, &u);
+    ASSERT_EQ(b.length, 50000, "intersection");
+    IntSet few = {0};
+    for (int i = 0; i < 10; i++) ds_hs_add(&few, 50000 + i * 5000);
+    ds_hs_sub(&b, &few);
+    ASSERT_EQ(b.length, 50000 - 10, "few removals");
+    ASSERT(!ds_hs_has(&b, 50000) && ds_hs_has(&b, 50001), "few removals membership");
+    ds_hs_free(&a);
+    ds_hs_free(&b);
+    ds_hs_free(&u);
+    ds_hs_free(&few);
+    PASS();
+}
+
+void test_hs_set_ops_strings(void) {
+    TEST("hs: set operations on string sets");
+    StrSet a = {0}, b = {0};
+    const char *words[] = {"alpha", "beta", "gamma", "delta", "epsilon"};
+    char copy[4][16];
+    for (int i = 0; i < 5; i++) ds_hs_add(&a, words[i]);
+    for (int i = 0; i < 4; i++) {
+        strcpy(copy[i], words[i + 1]); /* equal strings at other addresses */
+        ds_hs_add(&b, copy[i]);
+    }
+    ASSERT_EQ(ds_hs_intersect_count(&a, &b), 4, "count by content");
+    ds_hs_sub(&a, &b);
+    ASSERT_EQ(a.length, 1, "difference");
+    ASSERT(ds_hs_has(&a, "alpha"), "kept");
+    ds_hs_cat(&a, &b);
+    ASSERT_EQ(a.length, 5, "union");
+    ds_hs_intersect(&a, &b);
+    ASSERT_EQ(a.length, 4, "intersection");
+    ASSERT(!ds_hs_has(&a, "alpha"), "dropped");
+    ds_hs_free(&a);
+    ds_hs_free(&b);
+    PASS();
+}
+
 void test_hs_remove_stress(void) {
     TEST("hs: stress remove and verify consistency");
     IntSet s = {0};
@@ -1001,6 +1084,227 @@ void test_ll_free_empties(void) {
     PASS();
 }
 
+ds_rb_declare(IntRing, int);
+
+void test_rb_deque(void) {
+    TEST("rb: push and pop at both ends, growth across the wrap");
+    IntRing q = {0};
+    ASSERT(ds_rb_front(&q) == NULL && ds_rb_back(&q) == NULL, "empty");
+    for (int i = 0; i < 10; i++) ds_rb_push_back(&q, i);
+    for (int i = 0; i < 6; i++) ASSERT_EQ(ds_rb_pop_front(&q), i, "fifo order");
+    for (int i = 10; i < 20; i++) ds_rb_push_back(&q, i); // wraps in 16 slots
+    ASSERT(q.capacity == 16 && q.head + q.length > q.capacity, "items wrap");
+    ds_rb_push_front(&q, 5);
+    ds_rb_push_back(&q, 20);
+    ASSERT(q.length == 16 && q.capacity == 16, "full");
+    ds_rb_push_back(&q, 21); // grows while wrapped
+    ASSERT_EQ(q.capacity, 32, "doubled");
+    int expect = 5, ordered = 1;
+    ds_rb_foreach(&q, x) ordered &= *x == expect++;
+    ASSERT(ordered && expect == 22, "order kept across the growth");
+    ASSERT(*ds_rb_front(&q) == 5 && *ds_rb_back(&q) == 21 && *ds_rb_at(&q, 3) == 8, "front, back, at");
+    ASSERT(ds_rb_pop_back(&q) == 21 && ds_rb_pop_front(&q) == 5, "pop both ends");
+    int n = 0;
+    ds_rb_foreach(&q, x) {
+        if (*x == 9) break;
+        n++;
+    }
+    ASSERT_EQ(n, 3, "break leaves the loop");
+    IntRing s = {0};
+    for (int i = 0; i < 100; i++) ds_rb_push_front(&s, i);
+    for (int i = 0; i < 100; i++) ASSERT_EQ(ds_rb_pop_front(&s), 99 - i, "push_front as a stack");
+    ds_rb_free(&q);
+    ds_rb_free(&s);
+    ASSERT(q.data == NULL && q.capacity == 0, "freed");
+    PASS();
+}
+
+void test_rb_bulk(void) {
+    TEST("rb: bulk push and pop across the wrap");
+    IntRing q = {0};
+    int in[40], out[40];
+    for (int i = 0; i < 40; i++) in[i] = i;
+    ASSERT(ds_rb_push_back_many(&q, in, 12), "push 12");
+    ASSERT_EQ(ds_rb_pop_front_many(&q, out, 10), 10, "pop 10");
+    ASSERT(out[0] == 0 && out[9] == 9, "popped in order");
+    ASSERT(ds_rb_push_back_many(&q, in + 12, 10), "push across the end");
+    ASSERT(q.capacity == 16 && q.head == 10, "no growth");
+    ASSERT_EQ(ds_rb_pop_front_many(&q, out, 40), 12, "pop what is there");
+    int ok = 1;
+    for (int i = 0; i < 12; i++) ok &= out[i] == 10 + i;
+    ASSERT(ok, "wrapped items in order");
+    ds_rb_push_back_many(&q, in, 3);
+    ds_rb_push_front_many(&q, in + 30, 4);
+    ASSERT(q.length == 7 && *ds_rb_front(&q) == 30 && *ds_rb_at(&q, 3) == 33 && *ds_rb_at(&q, 4) == 0,
+           "push_front_many keeps the order");
+    ASSERT(ds_rb_pop_back_many(&q, out, 2) == 2 && out[0] == 1 && out[1] == 2, "pop_back_many");
+    ASSERT(ds_rb_pop_front_many(&q, NULL, 100) == 5 && q.length == 0, "drop the rest");
+    ds_rb_free(&q);
+    PASS();
+}
+
+void test_rb_fixed(void) {
+    TEST("rb: fixed buffer never allocates");
+    int slots[4];
+    IntRing q = {0};
+    ds_rb_init_fixed(&q, slots, 4);
+    for (int i = 0; i < 4; i++) ASSERT(ds_rb_push_back(&q, i), "push into room");
+    ASSERT(!ds_rb_push_back(&q, 4) && !ds_rb_push_front(&q, -1), "full");
+    ASSERT(!ds_rb_push_back_many(&q, slots, 1) && !ds_rb_reserve(&q, 5), "no growth");
+    ASSERT(ds_rb_pop_front(&q) == 0 && ds_rb_push_back(&q, 4), "room after a pop");
+    ASSERT(q.data == slots && q.length == 4 && *ds_rb_back(&q) == 4, "still the caller's buffer");
+    ds_rb_clear(&q);
+    ASSERT(q.length == 0 && q.capacity == 4, "clear keeps the storage");
+    ds_rb_free(&q); // does not free `slots`
+    PASS();
+}
+
+// ============================================================================
+// Lock-free Queue Tests
+// ============================================================================
+
+ds_spsc_declare(IntSpsc, int);
+ds_mpmc_declare(IntMpmc, int);
+
+void test_spsc_basic(void) {
+    TEST("spsc: push, pop and batches across the wrap");
+    IntSpsc q;
+    ds_spsc_init(&q, 6);
+    ASSERT_EQ(q.capacity, 8, "rounded up to a power of two");
+    int v = -1, in[16], out[16];
+    ASSERT(!ds_spsc_pop(&q, &v) && v == -1, "empty");
+    for (int i = 0; i < 8; i++) ASSERT(ds_spsc_push(&q, i), "push into room");
+    ASSERT(!ds_spsc_push(&q, 8), "full");
+    ASSERT(ds_spsc_pop(&q, &v) && v == 0 && ds_spsc_pop(&q, NULL), "pop in order");
+    for (int i = 0; i < 16; i++) in[i] = 100 + i;
+    ASSERT_EQ(ds_spsc_push_many(&q, in, 16), 2, "batch push fills the room left");
+    ASSERT_EQ(ds_spsc_length(&q), 8, "length");
+    ASSERT_EQ(ds_spsc_pop_many(&q, out, 16), 8, "batch pop drains");
+    ASSERT(out[0] == 2 && out[5] == 7 && out[6] == 100 && out[7] == 101, "batch order across the wrap");
+    ASSERT_EQ(ds_spsc_pop_many(&q, out, 16), 0, "empty again");
+    ds_spsc_free(&q);
+    PASS();
+}
+
+#define QUEUE_ITEMS 200000
+#define MPMC_THREADS 3
+
+static void *spsc_producer(void *arg) {
+    IntSpsc *q = arg;
+    int batch[7];
+    for (int i = 0; i < QUEUE_ITEMS;) {
+        if (i % 3 == 0) {
+            while (!ds_spsc_push(q, i)) sched_yield();
+            i++;
+        } else {
+            int n = QUEUE_ITEMS - i < 7 ? QUEUE_ITEMS - i : 7;
+            for (int k = 0; k < n; k++) batch[k] = i + k;
+            for (int sent = 0; sent < n;) {
+                size_t s = ds_spsc_push_many(q, batch + sent, n - sent);
+                if (!s) sched_yield();
+                sent += s;
+            }
+            i += n;
+        }
+    }
+    return NULL;
+}
+
+void test_spsc_threads(void) {
+    TEST("spsc: producer and consumer threads");
+    IntSpsc q;
+    ds_spsc_init(&q, 64);
+    pthread_t producer;
+    pthread_create(&producer, NULL, spsc_producer, &q);
+    int expect = 0, ordered = 1, out[5];
+    while (expect < QUEUE_ITEMS) {
+        size_t n = ds_spsc_pop_many(&q, out, 5);
+        if (!n) sched_yield();
+        for (size_t k = 0; k < n; k++) ordered &= out[k] == expect++;
+    }
+    pthread_join(producer, NULL);
+    ASSERT(ordered, "every item once, in order");
+    ASSERT_EQ(ds_spsc_length(&q), 0, "drained");
+    ds_spsc_free(&q);
+    PASS();
+}
+
+void test_mpmc_basic(void) {
+    TEST("mpmc: push and pop across laps");
+    IntMpmc q;
+    ds_mpmc_init(&q, 1);
+    ASSERT_EQ(q.capacity, 2, "at least two cells");
+    ds_mpmc_free(&q);
+    ds_mpmc_init(&q, 4);
+    int v = -1, ok = 1;
+    ASSERT(!ds_mpmc_pop(&q, &v) && v == -1, "empty");
+    for (int lap = 0; lap < 3; lap++) {
+        for (int i = 0; i < 4; i++) ok &= ds_mpmc_push(&q, lap * 4 + i);
+        ok &= !ds_mpmc_push(&q, -1);
+        for (int i = 0; i < 4; i++) ok &= ds_mpmc_pop(&q, &v) && v == lap * 4 + i;
+        ok &= !ds_mpmc_pop(&q, NULL);
+    }
+    ASSERT(ok, "full and empty on every lap, items in order");
+    ds_mpmc_free(&q);
+    PASS();
+}
+
+typedef struct {
+    IntMpmc *q;
+    int id;
+    long long sum;
+    int count;
+} MpmcWorker;
+
+static void *mpmc_producer(void *arg) {
+    MpmcWorker *w = arg;
+    for (int i = w->id; i < QUEUE_ITEMS; i += MPMC_THREADS) {
+        while (!ds_mpmc_push(w->q, i)) sched_yield();
+    }
+    return NULL;
+}
+
+static int mpmc_popped;
+
+static void *mpmc_consumer(void *arg) {
+    MpmcWorker *w = arg;
+    while (__atomic_load_n(&mpmc_popped, __ATOMIC_RELAXED) < QUEUE_ITEMS) {
+        int v;
+        if (ds_mpmc_pop(w->q, &v)) {
+            w->sum += v;
+            w->count++;
+            __atomic_fetch_add(&mpmc_popped, 1, __ATOMIC_RELAXED);
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+void test_mpmc_threads(void) {
+    TEST("mpmc: several producers and consumers");
+    IntMpmc q;
+    ds_mpmc_init(&q, 64);
+    pthread_t threads[2 * MPMC_THREADS];
+    MpmcWorker workers[2 * MPMC_THREADS];
+    for (int t = 0; t < 2 * MPMC_THREADS; t++) {
+        workers[t] = (MpmcWorker){.q = &q, .id = t % MPMC_THREADS};
+        pthread_create(&threads[t], NULL, t < MPMC_THREADS ? mpmc_producer : mpmc_consumer, &workers[t]);
+    }
+    long long sum = 0;
+    int count = 0;
+    for (int t = 0; t < 2 * MPMC_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        sum += workers[t].sum;
+        count += workers[t].count;
+    }
+    ASSERT_EQ(count, QUEUE_ITEMS, "every item popped once");
+    ASSERT(sum == (long long)QUEUE_ITEMS * (QUEUE_ITEMS - 1) / 2, "no item lost or duplicated");
+    ASSERT(!ds_mpmc_pop(&q, NULL), "drained");
+    ds_mpmc_free(&q);
+    PASS();
+}
+
 // ============================================================================
 // String Iterator Tests
 // ============================================================================
@@ -1206,6 +1510,25 @@ void test_arena_snapshot_restore_empty(void) {
     PASS();
 }
 
+void test_arena_reset(void) {
+    TEST("arena: reset reuses the existing regions");
+    DsArena arena = {0};
+    for (int i = 0; i < 100; i++) ds_a_malloc(&arena, 1024);
+    DsRegion *first = arena.start;
+    size_t regions = 0;
+    for (DsRegion *r = arena.start; r; r = r->next) regions++;
+    ASSERT(regions > 1, "spans several regions");
+    ds_a_reset(&arena);
+    ASSERT_EQ(arena.end, first, "back to the first region");
+    for (int i = 0; i < 100; i++) ds_a_malloc(&arena, 1024);
+    size_t after = 0;
+    for (DsRegion *r = arena.start; r; r = r->next) after++;
+    ASSERT_EQ(after, regions, "no new region allocated");
+    ASSERT_EQ(arena.start, first, "same regions");
+    ds_a_free(&arena);
+    PASS();
+}
+
 // ============================================================================
 // RArena Tests
 // ============================================================================
@@ -1631,6 +1954,135 @@ void test_da_shrink_on_zero_init(void) {
     PASS();
 }
 
+ds_sda_declare(SmallInts, int, 4);
+ds_sda_declare(SmallStrs, const char *, 2);
+
+void test_sda_inline_then_heap(void) {
+    TEST("sda: inline storage, then spills to the heap");
+    SmallInts a = ds_sda_init(a);
+    for (int i = 0; i < 4; i++) ds_da_append(&a, i);
+    ASSERT(a.data == a.storage && !ds_sda_on_heap(&a), "4 items inline");
+    IntArray plain = {0};
+    ASSERT(ds__da_has_inline(&a) && !ds__da_has_inline(&plain), "only small-buffer arrays are checked");
+    ASSERT_EQ(a.capacity, 4, "inline capacity");
+    ds_da_insert(&a, 0, -1);
+    ASSERT(ds_sda_on_heap(&a) && a.capacity == 8, "fifth item moves to the heap");
+    int sum = 0;
+    ds_da_foreach(&a, x) sum += *x;
+    ASSERT(a.length == 5 && a.data[0] == -1 && a.data[4] == 3 && sum == 5, "items moved in order");
+    ds_da_append_many(&a, ((int[]){7, 8, 9, 10}), 4);
+    ASSERT(a.length == 9 && *ds_da_last(&a) == 10, "heap growth");
+    ds_da_free(&a);
+    ASSERT(a.data == NULL && a.length == 0 && a.capacity == 0, "freed");
+    ds_sda_reset(&a);
+    ds_da_append(&a, 42);
+    ASSERT(a.data == a.storage && a.data[0] == 42, "inline again after reset");
+    ds_da_free(&a);
+    PASS();
+}
+
+void test_sda_da_macros(void) {
+    TEST("sda: ds_da macros keep inline items off the heap");
+    SmallStrs s = ds_sda_init(s);
+    ds_da_append(&s, "b");
+    ds_da_prepend(&s, "a");
+    ds_da_shrink(&s);
+    ASSERT(s.data == s.storage && s.capacity == 2, "shrink leaves inline items");
+    ASSERT(ds_da_index_of(&s, strcmp(*e, "b") == 0) == 1, "index_of");
+    ds_da_remove(&s, 0, 1);
+    ASSERT(s.length == 1 && strcmp(s.data[0], "b") == 0, "remove");
+    ASSERT(strcmp(ds_da_pop(&s), "b") == 0 && s.length == 0, "pop");
+    ds_da_free(&s); // must not free the inline storage
+    SmallInts z = {0};
+    ds_da_append(&z, 1);
+    ASSERT(ds_sda_on_heap(&z) && z.capacity == DS_DA_INIT_CAPACITY, "zero-initialized starts on the heap");
+    ds_sda_reset(&z);
+    ASSERT(z.length == 0 && !ds_sda_on_heap(&z), "reset frees the heap items");
+    PASS();
+}
+
+#ifdef DS_DA_LARGE_THRESHOLD // test_ds_large.c
+void test_da_large_mapping(void) {
+    TEST("da: large-array mode maps, grows and shrinks in place");
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    IntArray a = {0};
+    for (int i = 0; i < 1000000; i++) ds_da_append(&a, i);
+    ASSERT(a.capacity * sizeof(int) >= DS_DA_LARGE_THRESHOLD, "past the threshold");
+    ASSERT((uintptr_t)a.data % page == 0, "page-aligned mapping");
+    int ok = 1;
+    for (int i = 0; i < 1000000; i++) ok &= a.data[i] == i;
+    ASSERT(ok, "items kept across mremap growth");
+    a.length = 300000;
+    int *before = a.data;
+    ds_da_shrink(&a);
+    ASSERT(a.data == before && a.capacity == 300000, "shrink unmaps the tail in place");
+    ASSERT(a.data[299999] == 299999, "items before the new end kept");
+    a.length = 1000;
+    ds_da_shrink(&a);
+    ASSERT(a.capacity == 1000 && a.data[999] == 999, "shrink below the threshold moves to the heap");
+    ds_da_append(&a, 1000);
+    ASSERT(a.data[1000] == 1000, "heap block grows again");
+    ds_da_free(&a);
+    SmallInts s = ds_sda_init(s);
+    ds_da_append(&s, 7);
+    ds_da_reserve(&s, 1 << 20);
+    ASSERT(ds_sda_on_heap(&s) && (uintptr_t)s.data % page == 0 && s.data[0] == 7, "inline items spill to a mapping");
+    ds_da_free(&s);
+    PASS();
+}
+#endif
+
+ds_seg_declare(IntSeg, int);
+
+void test_seg_stable_addresses(void) {
+    TEST("seg: indexed access and stable addresses while growing");
+    IntSeg s = {0};
+    ASSERT(ds_seg_last(&s) == NULL, "empty");
+    ds_seg_append(&s, 0);
+    int *first = ds_seg_at(&s, 0);
+    ASSERT_EQ(s.capacity, DS_SEG_CHUNK, "first chunk");
+    for (int i = 1; i < 10000; i++) ds_seg_append(&s, i);
+    int *mid = ds_seg_at(&s, 5000);
+    for (int i = 10000; i < 50000; i++) ds_seg_append(&s, i);
+    ASSERT(first == ds_seg_at(&s, 0) && *first == 0, "first item did not move");
+    ASSERT(mid == ds_seg_at(&s, 5000) && *mid == 5000, "middle item did not move");
+    for (size_t i = 0; i < s.length; i++) ASSERT(*ds_seg_at(&s, i) == (int)i, "at");
+    ASSERT(s.capacity >= s.length && s.capacity < 2 * s.length + DS_SEG_CHUNK, "at most half unused");
+    ASSERT(*ds_seg_last(&s) == 49999 && ds_seg_pop(&s) == 49999 && s.length == 49999, "last and pop");
+    ds_seg_free(&s);
+    ASSERT(s.length == 0 && s.capacity == 0 && s.chunks[0] == NULL, "freed");
+    PASS();
+}
+
+void test_seg_bulk(void) {
+    TEST("seg: append_many across chunks, foreach and break");
+    IntSeg s = {0};
+    int items[1000];
+    for (int i = 0; i < 1000; i++) items[i] = i;
+    ds_seg_append_many(&s, items, 3);
+    ds_seg_append_many(&s, items + 3, 997); // spans several chunks
+    ds_seg_reserve(&s, 5000);
+    ASSERT(s.length == 1000 && s.capacity >= 5000, "reserve keeps the items");
+    long sum = 0;
+    int expect = 0, ordered = 1;
+    ds_seg_foreach(&s, x) {
+        ordered &= *x == expect++;
+        sum += *x;
+    }
+    ASSERT(ordered && sum == 999 * 1000 / 2, "foreach in order");
+    int n = 0;
+    ds_seg_foreach(&s, x) {
+        if (*x == 700) break;
+        n++;
+    }
+    ASSERT_EQ(n, 700, "break leaves the loop");
+    ds_seg_free(&s);
+    n = 0;
+    ds_seg_foreach(&s, x) n += *x;
+    ASSERT_EQ(n, 0, "foreach on an empty array");
+    PASS();
+}
+
 void test_hm_shrink_basic(void) {
     TEST("hm: shrink reduces table+data after many removes");
     IntIntMap hm = {0};
@@ -1705,6 +2157,432 @@ void test_hm_shrink_strings(void) {
     PASS();
 }
 
+void test_hm_key_arena(void) {
+    TEST("hm: string keys in an owned arena, reused after clear");
+    StrIntMap hm = {0};
+    ds_hm_key_arena(&hm, NULL);
+    char buf[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(buf, sizeof(buf), "key-%d", i);
+        ds_hm_set(&hm, buf, i);
+    }
+    ASSERT(ds__ht_keys(&hm.table) != NULL, "arena allocated on first insert");
+    ASSERT_EQ(ds_hm_get(&hm, "key-4321"), 4321, "lookup");
+    ASSERT_EQ(*ds_hm_remove(&hm, "key-7"), 7, "remove");
+    ASSERT(!ds_hm_has(&hm, "key-7"), "removed");
+    DsRegion *first = ds__ht_keys(&hm.table)->start;
+    size_t regions = 0;
+    for (DsRegion *r = first; r; r = r->next) regions++;
+    ds_hm_clear(&hm);
+    ASSERT_EQ(hm.length, 0, "cleared");
+    ASSERT(!ds_hm_has(&hm, "key-1"), "no stale keys after clear");
+    for (int i = 0; i < 5000; i++) {
+        snprintf(buf, sizeof(buf), "key-%d", i);
+        ds_hm_set(&hm, buf, -i);
+    }
+    size_t after = 0;
+    for (DsRegion *r = ds__ht_keys(&hm.table)->start; r; r = r->next) after++;
+    ASSERT_EQ(ds__ht_keys(&hm.table)->start, first, "same arena regions");
+    ASSERT_EQ(after, regions, "clear made the key memory reusable");
+    ASSERT_EQ(ds_hm_get(&hm, "key-4999"), -4999, "lookup after refill");
+    ds_hm_free(&hm);
+    ASSERT_EQ(ds__ht_keys(&hm.table), NULL, "owned arena released");
+    PASS();
+}
+
+void test_hm_key_arena_external(void) {
+    TEST("hm: string keys in a caller arena outlive the map");
+    DsArena arena = {0};
+    StrIntMap hm = {0};
+    ds_hm_key_arena(&hm, &arena);
+    ds_hm_set(&hm, "alpha", 1);
+    ds_hm_set(&hm, "beta", 2);
+    const char *key = hm.data[1].key;
+    ASSERT(arena.start != NULL, "keys allocated from the caller arena");
+    ds_hm_free(&hm);
+    ASSERT_STR(key, "beta", "key still owned by the arena");
+    ds_a_free(&arena);
+    PASS();
+}
+
+void test_hm_plain_table_state(void) {
+    TEST("hm: a plain map allocates no side state");
+    IntIntMap hm = {0};
+    for (int i = 0; i < 1000; i++) ds_hm_set(&hm, i, i);
+#ifdef DS_HM_STATS
+    ASSERT(hm.table.extra != NULL, "counters allocated with the table");
+#elif !defined(DS_HM_STORE_HASH) && !defined(DS_HM_ROBIN_HOOD) // both keep state there
+    ASSERT(hm.table.extra == NULL, "no stored hashes, migration, key arena, filter or counters");
+#endif
+    ds_hm_free(&hm);
+    ASSERT(hm.table.extra == NULL, "released by free");
+    PASS();
+}
+
+void test_hm_clear_keeps_capacity(void) {
+    TEST("hm: clear empties the map but keeps its memory");
+    IntIntMap hm = {0};
+    for (int i = 0; i < 300; i++) ds_hm_set(&hm, i, i);
+    size_t cap = hm.capacity, table_cap = hm.table.capacity;
+    ds_hm_clear(&hm);
+    ASSERT_EQ(hm.length, 0, "empty");
+    ASSERT_EQ(hm.capacity, cap, "data kept");
+    ASSERT_EQ(hm.table.capacity, table_cap, "table kept");
+    ASSERT(!ds_hm_has(&hm, 5), "entries gone");
+    ds_hm_set(&hm, 5, 50);
+    ASSERT_EQ(ds_hm_get(&hm, 5), 50, "usable after clear");
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hm_bulk_int(void) {
+    TEST("hm: set_many / try_many / get_many on int keys");
+    IntIntMap hm = {0};
+    enum { N = 5000 };
+    static int keys[N], vals[N], probe[2 * N], got[2 * N];
+    static int *ptrs[2 * N];
+    for (int i = 0; i < N; i++) keys[i] = i * 7, vals[i] = -i;
+    ds_hm_set(&hm, 0, 99); // overwritten by the batch
+    ds_hm_set_many(&hm, keys, vals, N);
+    ASSERT_EQ(hm.length, N, "all inserted once");
+    for (int i = 0; i < 2 * N; i++) probe[i] = i / 2 * 7 + i % 2; // odd i miss
+    ASSERT_EQ(ds_hm_try_many(&hm, probe, 2 * N, ptrs), N, "half the keys found");
+    ASSERT_EQ(ds_hm_get_many(&hm, probe, 2 * N, got), N, "same count by value");
+    for (int i = 0; i < 2 * N; i++) {
+        if (i % 2) {
+            ASSERT_EQ(ptrs[i], NULL, "missing key gives NULL");
+            ASSERT_EQ(got[i], 0, "missing key gives zero");
+        } else {
+            ASSERT_EQ(*ptrs[i], -(i / 2), "pointer to value");
+            ASSERT_EQ(got[i], -(i / 2), "copied value");
+        }
+    }
+    ASSERT_EQ(ds_hm_try_many(&hm, probe, 0, ptrs), 0, "empty batch");
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hm_bulk_strings(void) {
+    TEST("hm: bulk operations on string keys and an empty map");
+    StrIntMap hm = {0};
+    const char *keys[] = {"a", "bb", "ccc", "dddd"};
+    int vals[] = {1, 2, 3, 4};
+    int got[4];
+    ASSERT_EQ(ds_hm_get_many(&hm, keys, 4, got), 0, "nothing in an empty map");
+    ds_hm_set_many(&hm, keys, vals, 3);
+    ASSERT_EQ(ds_hm_get_many(&hm, keys, 4, got), 3, "three keys set");
+    ASSERT(got[0] == 1 && got[1] == 2 && got[2] == 3 && got[3] == 0, "values");
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hm_freeze(void) {
+    TEST("hm: frozen map finds every key with one probe");
+    IntIntMap hm = {0};
+    ASSERT(!ds_hm_freeze(&hm), "empty map is not frozen");
+    for (int i = 0; i < 10000; i++) ds_hm_set(&hm, i * 3, i);
+    ASSERT(ds_hm_freeze(&hm), "freeze");
+    ASSERT(hm.table.flags & DS__HT_FROZEN, "frozen flag");
+    ASSERT_EQ(hm.length, 10000, "no entry lost");
+    for (int i = 0; i < 10000; i++) ASSERT_EQ(ds_hm_get(&hm, i * 3), i, "value after freeze");
+    for (int i = 0; i < 10000; i++) ASSERT(!ds_hm_has(&hm, i * 3 + 1), "missing key");
+    long sum = 0;
+    ds_hm_foreach(&hm, kv) sum += kv->value;
+    ASSERT_EQ(sum, 10000L * 9999 / 2, "foreach sees every entry");
+    int keys[] = {0, 1, 29997}, got[3];
+    ASSERT_EQ(ds_hm_get_many(&hm, keys, 3, got), 2, "bulk lookup on frozen map");
+    ASSERT(got[0] == 0 && got[2] == 9999, "bulk values");
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hm_freeze_thaw(void) {
+    TEST("hm: writes thaw a frozen map");
+    StrIntMap hm = {0};
+    ds_hm_store_hash(&hm);
+    char buf[16];
+    for (int i = 0; i < 500; i++) {
+        snprintf(buf, sizeof(buf), "k%d", i);
+        ds_hm_set(&hm, buf, i);
+    }
+    ASSERT(ds_hm_freeze(&hm), "freeze");
+    ASSERT_EQ(ds_hm_get(&hm, "k123"), 123, "frozen lookup");
+    ASSERT_EQ(*ds_hm_remove(&hm, "k7"), 7, "remove thaws");
+    ASSERT(!(hm.table.flags & DS__HT_FROZEN), "thawed");
+    ASSERT(ds_hm_freeze(&hm), "freeze again");
+    ds_hm_set(&hm, "new", -1);
+    ASSERT(!(hm.table.flags & DS__HT_FROZEN), "set thaws");
+    for (int i = 0; i < 500; i++) {
+        snprintf(buf, sizeof(buf), "k%d", i);
+        ASSERT_EQ(ds_hm_has(&hm, buf), i != 7, "entries after thaw");
+    }
+    ASSERT_EQ(ds_hm_get(&hm, "new"), -1, "new entry");
+    ASSERT(ds_hm_freeze(&hm), "freeze once more");
+    ds_hm_clear(&hm);
+    ASSERT(!ds_hm_has(&hm, "k1"), "cleared");
+    ds_hm_set(&hm, "k1", 1);
+    ASSERT_EQ(ds_hm_get(&hm, "k1"), 1, "usable after clear");
+    ds_hm_free(&hm);
+    PASS();
+}
+
+typedef struct {
+    char tag;
+    int32_t id; /* padding between the members */
+} TaggedId;
+
+static inline size_t tagged_id_hash(const TaggedId *k, size_t seed) {
+    return ds_hash_u64(((uint64_t)(uint8_t)k->tag << 32) | (uint32_t)k->id, seed);
+}
+
+static inline bool tagged_id_eq(const TaggedId *a, const TaggedId *b) {
+    return a->tag == b->tag && a->id == b->id;
+}
+
+ds_hm_declare_ex(TaggedMap, TaggedId, int, tagged_id_hash, tagged_id_eq);
+
+static inline size_t u32_hash(const uint32_t *k, size_t seed) {
+    return ds_hash_u64(*k, seed);
+}
+
+static inline bool u32_eq(const uint32_t *a, const uint32_t *b) {
+    return *a == *b;
+}
+
+ds_hm_declare_ex(U32Map, uint32_t, uint32_t, u32_hash, u32_eq);
+
+static inline size_t ci_hash(const char *const *k, size_t seed) {
+    char lower[32];
+    size_t n = 0;
+    for (; (*k)[n] && n < sizeof(lower); n++) lower[n] = (char)tolower((unsigned char)(*k)[n]);
+    return ds_wyhash(lower, n, seed);
+}
+
+static inline bool ci_eq(const char *const *a, const char *const *b) {
+    return strcasecmp(*a, *b) == 0;
+}
+
+ds_hm_declare_ex(CiMap, const char *, int, ci_hash, ci_eq);
+
+void test_hm_declare_ex(void) {
+    TEST("hm: declare_ex struct keys ignore padding");
+    TaggedMap hm = {0};
+    for (int i = 0; i < 5000; i++) {
+        TaggedId k;
+        memset(&k, 0xAB, sizeof(k)); /* garbage in the padding */
+        k.tag = (char)('a' + i % 3);
+        k.id = i;
+        TaggedMap_set(&hm, k, i);
+    }
+    ASSERT_EQ(hm.length, 5000, "all inserted");
+    TaggedId probe = {'a' + 7 % 3, 7};
+    ASSERT(TaggedMap_has(&hm, probe), "found with clean padding");
+    ASSERT_EQ(*TaggedMap_try(&hm, probe), 7, "value");
+    TaggedMap_set(&hm, probe, 70);
+    ASSERT_EQ(hm.length, 5000, "overwrite does not insert");
+    ASSERT_EQ(*TaggedMap_try(&hm, probe), 70, "overwritten");
+    ASSERT(!TaggedMap_has(&hm, ((TaggedId){'c', 7})), "tag is part of the key");
+    ASSERT_EQ(*TaggedMap_remove(&hm, probe), 70, "remove returns value");
+    ASSERT(!TaggedMap_try(&hm, probe), "removed");
+    ASSERT(!TaggedMap_remove(&hm, probe), "remove missing");
+    int n = 0;
+    ds_hm_foreach(&hm, kv) n += kv->value == kv->key.id;
+    ASSERT_EQ(n, 4999, "foreach sees typed entries");
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hm_declare_ex_tables(void) {
+    TEST("hm: declare_ex works with every table mode");
+    for (int mode = 0; mode < 3; mode++) {
+        U32Map hm = {0};
+        if (mode == 1) ds_hm_robin_hood(&hm);
+        if (mode == 2) ds_hm_incremental_resize(&hm);
+        for (uint32_t i = 0; i < 20000; i++) U32Map_set(&hm, i * 11, i);
+        for (uint32_t i = 0; i < 20000; i += 2) ASSERT(U32Map_remove(&hm, i * 11), "remove");
+        for (uint32_t i = 0; i < 20000; i++) {
+            uint32_t *v = U32Map_try(&hm, i * 11);
+            ASSERT(i % 2 ? v && *v == i : !v, "lookup");
+        }
+        ASSERT(U32Map_freeze(&hm), "freeze");
+        ASSERT_EQ(*U32Map_try(&hm, 11), 1, "frozen lookup");
+        ASSERT(!U32Map_has(&hm, 12), "frozen miss");
+        ASSERT(U32Map_remove(&hm, 33), "remove thaws");
+        ASSERT(!U32Map_has(&hm, 33) && U32Map_has(&hm, 55), "after thaw");
+        ds_hm_free(&hm);
+    }
+    PASS();
+}
+
+void test_hm_declare_ex_string_keys(void) {
+    TEST("hm: declare_ex string keys stay with the caller");
+    char a[] = "Alpha", b[] = "beta";
+    CiMap hm = {0};
+    CiMap_set(&hm, a, 1);
+    CiMap_set(&hm, b, 2);
+    CiMap_set(&hm, "ALPHA", 10);
+    ASSERT_EQ(hm.length, 2, "keys equal under eq_fn share an entry");
+    ASSERT(hm.data[0].key == a, "key stored as given");
+    ASSERT_EQ(*CiMap_try(&hm, "BETA"), 2, "custom hash and equality");
+    ds_hm_clear(&hm);
+    ASSERT_EQ(hm.length, 0, "cleared without freeing the keys");
+    CiMap_set(&hm, b, 3);
+    ds_hm_free(&hm);
+    ASSERT_STR(b, "beta", "free leaves the keys alone");
+    PASS();
+}
+
+void test_hm_string_view(void) {
+    TEST("hm: string view lookups need no terminator");
+    StrIntMap hm = {0};
+    ds_hm_set(&hm, "alpha", 1);
+    ds_hm_set(&hm, "beta", 2);
+    ds_hm_set(&hm, "", 3);
+    char buf[] = {'b', 'e', 't', 'a', 'x', 'a', 'l', 'p', 'h'}; /* no NUL anywhere */
+    ASSERT_EQ(*ds_hm_try_sv(&hm, ((DsStringIterator){buf, 4})), 2, "prefix of a buffer");
+    ASSERT(!ds_hm_has_sv(&hm, ((DsStringIterator){buf, 3})), "shorter view misses");
+    ASSERT(!ds_hm_has_sv(&hm, ((DsStringIterator){buf + 5, 4})), "alph is not alpha");
+    ASSERT_EQ(*ds_hm_try_sv(&hm, ((DsStringIterator){buf, 0})), 3, "empty view finds empty key");
+    ASSERT(!ds_hm_has_sv(&hm, ds_str_iter_empty), "NULL view");
+
+    DsStringIterator it = ds_cstr_iter("to be or not to be");
+    while (it.length) {
+        DsStringIterator word = ds_s_split(&it, ' ');
+        int *n = ds_hm_try_sv(&hm, word);
+        ds_hm_set_sv(&hm, word, n ? *n + 1 : 1);
+    }
+    ASSERT_EQ(ds_hm_get(&hm, "to"), 2, "view inserts are found as C strings");
+    ASSERT_EQ(ds_hm_get(&hm, "be"), 2, "counted twice");
+    ASSERT_EQ(ds_hm_get(&hm, "not"), 1, "counted once");
+    ASSERT_EQ(hm.length, 7, "one entry per distinct word");
+    ASSERT(ds_hm_remove(&hm, "to"), "remove a view-inserted key");
+    ASSERT(!ds_hm_has_sv(&hm, ds_cstr_iter("to")), "removed");
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hm_string_view_arena(void) {
+    TEST("hm: string view keys in a key arena");
+    StrIntMap hm = {0};
+    ds_hm_key_arena(&hm, NULL);
+    char line[64];
+    for (int i = 0; i < 1000; i++) {
+        int n = snprintf(line, sizeof(line), "key-%d;", i);
+        ds_hm_set_sv(&hm, ((DsStringIterator){line, (size_t)n - 1}), i);
+    }
+    for (int i = 0; i < 1000; i += 7) {
+        snprintf(line, sizeof(line), "key-%d", i);
+        ASSERT_EQ(*ds_hm_try_sv(&hm, ds_cstr_iter(line)), i, "found by view");
+        ASSERT_EQ(ds_hm_get(&hm, line), i, "found by C string");
+    }
+    ASSERT_EQ(strlen(hm.data[5].key), 5, "stored key is terminated");
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hm_save_map(void) {
+    TEST("hm: save and map an image");
+    const char *path = "/tmp/test_ds_int.dshm";
+    IntIntMap hm = {0};
+    for (int i = 0; i < 5000; i++) ds_hm_set(&hm, i * 3, i);
+    for (int i = 0; i < 5000; i += 2) ds_hm_remove(&hm, i * 3);
+    ASSERT(ds_hm_save(&hm, path), "saved");
+    IntIntMap img = {0};
+    ASSERT(ds_hm_map(&img, path), "mapped");
+    ASSERT_EQ(img.length, hm.length, "same length");
+    for (int i = 0; i < 5000; i++) {
+        int *v = ds_hm_try(&img, i * 3);
+        if (i % 2) {
+            ASSERT(v != NULL && *v == i, "value found");
+        } else {
+            ASSERT(v == NULL, "removed key absent");
+        }
+        ASSERT(!ds_hm_has(&img, i * 3 + 1), "missing key absent");
+    }
+    int keys[4] = {3, 6, 9, 1}, out[4];
+    ASSERT_EQ(ds_hm_get_many(&img, keys, 4, out), 2, "bulk lookup");
+    ASSERT_EQ(out[0], 1, "bulk value");
+    ASSERT_EQ(out[3], 0, "bulk miss");
+    long sum = 0;
+    ds_hm_foreach(&img, kv) sum += kv->value;
+    long expected = 0;
+    ds_hm_foreach(&hm, kv) expected += kv->value;
+    ASSERT_EQ(sum, expected, "foreach over image");
+    ds_hm_free(&img);
+    ASSERT(img.data == NULL && img.length == 0, "free unmaps");
+    ds_hm_free(&hm);
+    remove(path);
+    PASS();
+}
+
+void test_hm_save_map_str(void) {
+    TEST("hm: save and map images with string keys");
+    const char *path = "/tmp/test_ds_str.dshm";
+    char key[32];
+    for (int mode = 0; mode < 3; mode++) {
+        StrIntMap hm = {0};
+        if (mode == 2) ds_hm_robin_hood(&hm);
+        ds_hm_key_arena(&hm, NULL);
+        for (int i = 0; i < 2000; i++) {
+            snprintf(key, sizeof(key), "word-%d", i);
+            ds_hm_set(&hm, key, i);
+        }
+        ds_hm_set(&hm, "", -1);
+        if (mode == 1) ds_hm_freeze(&hm);
+        ASSERT(ds_hm_save(&hm, path), "saved");
+        ds_hm_free(&hm);
+
+        StrIntMap img = {0};
+        ASSERT(ds_hm_map(&img, path), "mapped");
+        for (int i = 0; i < 2000; i++) {
+            snprintf(key, sizeof(key), "word-%d", i);
+            ASSERT_EQ(ds_hm_get(&img, key), i, "found by C string");
+        }
+        ASSERT_EQ(ds_hm_get(&img, ""), -1, "empty key");
+        ASSERT(!ds_hm_has(&img, "word-2000"), "missing key absent");
+        ASSERT_EQ(*ds_hm_try_sv(&img, ((DsStringIterator){"word-17;", 7})), 17, "found by view");
+        ASSERT(ds_hm_try_sv(&img, ((DsStringIterator){"word-17;", 8})) == NULL, "longer view not found");
+        size_t matched = 0;
+        ds_hm_foreach(&img, kv) {
+            const char *k = ds_hm_str_key(&img, kv);
+            if (kv->value >= 0) {
+                snprintf(key, sizeof(key), "word-%d", kv->value);
+                matched += strcmp(k, key) == 0;
+            }
+        }
+        ASSERT_EQ(matched, 2000, "keys readable");
+        ds_hm_free(&img);
+    }
+    remove(path);
+    PASS();
+}
+
+void test_hm_map_errors(void) {
+    TEST("hm: mapping a missing or mismatched image fails");
+    const char *path = "/tmp/test_ds_bad.dshm";
+    ds_set_log_level(DS_LOG_ERROR + 1);
+    IntIntMap hm = {0};
+    ASSERT(!ds_hm_map(&hm, "/tmp/test_ds_missing.dshm"), "missing file");
+    DsString junk = {0};
+    ds_str_append(&junk, "not an image, just some text to fill the header");
+    ASSERT(ds_write_entire_file(path, &junk), "wrote junk");
+    ds_da_free(&junk);
+    ASSERT(!ds_hm_map(&hm, path), "bad magic");
+    ds_hm_set(&hm, 1, 2);
+    ASSERT(ds_hm_save(&hm, path), "saved");
+    StrIntMap other = {0};
+    ASSERT(!ds_hm_map(&other, path), "other map type");
+    IntStrMap other_value = {0};
+    ASSERT(!ds_hm_map(&other_value, path), "other value type");
+    ds_hm_free(&hm);
+    ASSERT(ds_hm_map(&hm, path), "same map type");
+    ASSERT_EQ(ds_hm_get(&hm, 1), 2, "value");
+    ds_hm_free(&hm);
+    ds_set_log_level(DS_LOG_INFO);
+    remove(path);
+    PASS();
+}
+
 void test_hs_shrink_basic(void) {
     TEST("hs: shrink reduces table+data after many removes");
     IntSet s = {0};
@@ -1750,13 +2628,958 @@ void test_hs_shrink_then_add(void) {
     PASS();
 }
 
+void test_hs_clear(void) {
+    TEST("hs: clear empties the set but keeps its memory");
+    IntSet s = {0};
+    for (int i = 0; i < 300; i++) ds_hs_add(&s, i);
+    size_t table_cap = s.table.capacity;
+    ds_hs_clear(&s);
+    ASSERT_EQ(s.length, 0, "empty");
+    ASSERT_EQ(s.table.capacity, table_cap, "table kept");
+    ASSERT(!ds_hs_has(&s, 1), "values gone");
+    ds_hs_add(&s, 1);
+    ASSERT(ds_hs_has(&s, 1), "usable after clear");
+    ds_hs_free(&s);
+    PASS();
+}
+
+void test_hs_freeze(void) {
+    TEST("hs: frozen set");
+    IntSet s = {0};
+    for (int i = 0; i < 3000; i++) ds_hs_add(&s, i * i);
+    ASSERT(ds_hs_freeze(&s), "freeze");
+    for (int i = 0; i < 3000; i++) ASSERT(ds_hs_has(&s, i * i), "member");
+    ASSERT(!ds_hs_has(&s, 2), "non member");
+    ASSERT(ds_hs_remove(&s, 4), "remove thaws");
+    ASSERT(!ds_hs_has(&s, 4) && ds_hs_has(&s, 9), "after thaw");
+    ds_hs_free(&s);
+    PASS();
+}
+
 // ============================================================================
 // Main
 // ============================================================================
 
+// ============================================================================
+// Hash Table Internals
+// ============================================================================
+
+static size_t count_full_ctrl(const struct ds__ht_idxs *t) {
+    size_t n = 0;
+    for (size_t i = 0; i < t->capacity; i++) n += ds__table_ctrl(t)[i] != DS__CTRL_EMPTY;
+    // entries not yet migrated by an incremental resize
+    if (ds__ht_old(t)) n += count_full_ctrl(&t->extra->old->table);
+    return n;
+}
+
+void test_hm_ctrl_bytes_track_entries(void) {
+    TEST("hm: control bytes track live entries through removes");
+    StrIntMap hm = {0};
+    char buf[32];
+    for (int i = 0; i < 2000; i++) {
+        snprintf(buf, sizeof(buf), "key-%d", i);
+        ds_hm_set(&hm, buf, i);
+    }
+    ASSERT_EQ(count_full_ctrl(&hm.table), 2000, "one full ctrl byte per entry");
+    for (int i = 0; i < 2000; i += 2) {
+        snprintf(buf, sizeof(buf), "key-%d", i);
+        ASSERT_NEQ(ds_hm_remove(&hm, buf), NULL, "remove even key");
+    }
+    ASSERT_EQ(count_full_ctrl(&hm.table), 1000, "removed slots are empty again");
+    for (size_t i = 0; i < DS__GROUP_WIDTH && i < hm.table.capacity; i++) {
+        ASSERT_EQ(ds__table_ctrl(&hm.table)[hm.table.capacity + i], ds__table_ctrl(&hm.table)[i], "group tail mirrors head");
+    }
+    for (int i = 0; i < 2000; i++) {
+        snprintf(buf, sizeof(buf), "key-%d", i);
+        if (i % 2 == 0) {
+            ASSERT(!ds_hm_has(&hm, buf), "even key gone");
+        } else {
+            ASSERT_EQ(ds_hm_get(&hm, buf), i, "odd key intact");
+        }
+    }
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hs_probe_wraps_table_end(void) {
+    TEST("hs: probing wraps around a nearly full small table");
+    IntSet s = {0};
+    // Keep the table at its initial capacity and fill it up to the load factor
+    size_t n = (size_t)(DS_HM_INIT_CAPACITY * DS_HM_LOAD_FACTOR);
+    for (size_t i = 0; i < n; i++) ds_hs_add(&s, (int)(i * 7919));
+    ASSERT_EQ(s.table.capacity, DS_HM_INIT_CAPACITY, "no resize yet");
+    for (size_t i = 0; i < n; i++) ASSERT(ds_hs_has(&s, (int)(i * 7919)), "member found");
+    for (int i = 1; i < 1000; i++) {
+        if (i % 7919 == 0) continue;
+        ASSERT(!ds_hs_has(&s, i), "non-member missing");
+    }
+    ds_hs_free(&s);
+    PASS();
+}
+
+void test_hm_store_hash(void) {
+    TEST("hm: stored hashes match keys through resize and remove");
+    StrIntMap hm = {0};
+    ds_hm_store_hash(&hm);
+    char buf[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(buf, sizeof(buf), "key-%d", i);
+        ds_hm_set(&hm, buf, i);
+    }
+    ASSERT_NEQ(ds__ht_hashes(&hm.table), NULL, "hashes allocated");
+    for (int i = 0; i < 1000; i += 3) {
+        snprintf(buf, sizeof(buf), "key-%d", i);
+        ds_hm_remove(&hm, buf);
+    }
+    for (size_t i = 0; i < hm.length; i++) {
+        size_t h = ds__hash_string(&hm.data[i].key, sizeof(hm.data[i].key), hm.seed);
+        ASSERT_EQ(ds__ht_hashes(&hm.table)[i], h, "stored hash follows its entry");
+    }
+    for (int i = 0; i < 1000; i++) {
+        snprintf(buf, sizeof(buf), "key-%d", i);
+        ASSERT_EQ(ds_hm_has(&hm, buf), i % 3 != 0, "membership after removes");
+    }
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hs_store_hash_enable_later(void) {
+    TEST("hs: store_hash on a populated set keeps members");
+    IntSet s = {0};
+    for (int i = 0; i < 300; i++) ds_hs_add(&s, i);
+    ds_hs_store_hash(&s);
+    ASSERT_NEQ(ds__ht_hashes(&s.table), NULL, "hashes allocated");
+    for (int i = 0; i < 300; i += 2) ds_hs_remove(&s, i);
+    for (int i = 300; i < 600; i++) ds_hs_add(&s, i);
+    for (int i = 0; i < 600; i++) {
+        ASSERT_EQ(ds_hs_has(&s, i), i >= 300 || i % 2 == 1, "membership");
+    }
+    ds_hs_shrink(&s);
+    ASSERT_NEQ(ds__ht_hashes(&s.table), NULL, "shrink keeps stored hashes");
+    ds_hs_free(&s);
+    PASS();
+}
+
+void test_hash_family(void) {
+    TEST("hash: wyhash/u64 mix are seeded and key hashes dispatch");
+    const char *str = "hello world, this is longer than sixteen bytes";
+    size_t len = strlen(str);
+    ASSERT_EQ(ds_wyhash(str, len, 1), ds_wyhash(str, len, 1), "deterministic");
+    ASSERT_NEQ(ds_wyhash(str, len, 1), ds_wyhash(str, len, 2), "seed changes hash");
+    ASSERT_NEQ(ds_wyhash(str, len, 0), ds_wyhash(str, len - 1, 0), "length changes hash");
+    ASSERT_NEQ(ds_hash_u64(1, 0), ds_hash_u64(2, 0), "distinct ints");
+    ASSERT_NEQ(ds_hash_u64(1, 0), ds_hash_u64(1, 7), "seeded int mix");
+    ASSERT_EQ(ds__hash_string(&str, sizeof(str), 3), ds_hash(str, len, 3), "strings use DS_HASH_FN");
+    uint64_t k = 0xdeadbeef;
+    ASSERT_EQ(ds__hash_bytes(&k, sizeof(k), 3), DS_HASH_INT_FN(k, 3), "8 byte keys use int mix");
+    // high bits must vary for sequential keys: they feed the control bytes
+    uint64_t top = 0;
+    for (uint64_t i = 0; i < 64; i++) top |= (uint64_t)1 << (ds_hash_u64(i, 0) >> 58);
+    ASSERT(__builtin_popcountll(top) > 32, "sequential keys spread high bits");
+    PASS();
+}
+
+void test_hm_index_width_grows(void) {
+    TEST("hm: index slot width grows with table capacity");
+    IntIntMap hm = {0};
+    ds_hm_set(&hm, 0, 0);
+    ASSERT_EQ(hm.table.width, 1, "small map uses u8 slots");
+    uint8_t last = 1;
+    for (int i = 1; i < 100000; i++) {
+        ds_hm_set(&hm, i, i);
+        if (hm.table.width != last) {
+            ASSERT(hm.table.width > last, "width only grows");
+            ASSERT(hm.table.capacity > ((size_t)1 << (8 * last)), "width changes past its range");
+            last = hm.table.width;
+        }
+    }
+    ASSERT_EQ(hm.table.width, 4, "100k entries use u32 slots");
+    for (int i = 0; i < 100000; i += 7) ds_hm_remove(&hm, i);
+    for (int i = 0; i < 100000; i++) {
+        if (i % 7 == 0) {
+            ASSERT(!ds_hm_has(&hm, i), "removed key gone");
+        } else {
+            ASSERT_EQ(ds_hm_get(&hm, i), i, "key resolves");
+        }
+    }
+    for (int i = 100; i < 100000; i++) ds_hm_remove(&hm, i);
+    ds_hm_shrink(&hm);
+    ASSERT_EQ(hm.table.width, 1, "shrink narrows slots again");
+    for (int i = 1; i < 100; i++) ASSERT_EQ(ds_hm_get(&hm, i), i % 7 ? i : 0, "survivors resolve");
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hm_incremental_resize(void) {
+    TEST("hm: incremental resize keeps both tables consistent");
+    IntIntMap hm = {0};
+    ds_hm_incremental_resize(&hm);
+    bool saw_migration = false;
+    for (int i = 0; i < 20000; i++) {
+        ds_hm_set(&hm, i, i * 2);
+        if (ds__ht_old(&hm.table)) {
+            saw_migration = true;
+            // every key is reachable while the old table is draining
+            int k = i / 2 | 1; // odd keys are never removed
+            ASSERT_EQ(ds_hm_get(&hm, k), k * 2, "lookup during migration");
+            if (i % 2 == 0) ASSERT_NEQ(ds_hm_remove(&hm, i), NULL, "remove during migration");
+        }
+    }
+    ASSERT(saw_migration, "large map resized incrementally");
+    for (int i = 1; i < 20000; i += 2) ASSERT_EQ(ds_hm_get(&hm, i), i * 2, "value survives migration");
+    for (size_t i = 0; i < hm.table.capacity && ds__ht_old(&hm.table); i++) (void)ds_hm_try(&hm, -1);
+    ASSERT_EQ(ds__ht_old(&hm.table), NULL, "old table is drained by later operations");
+    ASSERT_EQ(count_full_ctrl(&hm.table), hm.length, "every entry indexed once");
+    ds_hm_free(&hm);
+    PASS();
+}
+
+void test_hs_robin_hood(void) {
+    TEST("hs: robin hood probing keeps lookups exact");
+    IntSet s = {0};
+    for (int i = 0; i < 10000; i++) ds_hs_add(&s, i * 5);
+    ds_hs_robin_hood(&s); /* reorders the existing clusters */
+    ASSERT(s.table.flags & DS__HT_ROBIN_HOOD, "flag set");
+    for (int i = 10000; i < 40000; i++) ds_hs_add(&s, i * 5);
+    ASSERT(ds__ht_max_probe(&s.table) > 0 && ds__ht_max_probe(&s.table) <= DS_HM_MAX_PROBE, "probe length tracked");
+    for (int i = 0; i < 40000; i += 3) ASSERT(ds_hs_remove(&s, i * 5), "remove");
+    for (int i = 0; i < 40000; i++) {
+        ASSERT_EQ(ds_hs_has(&s, i * 5), i % 3 != 0, "membership");
+        ASSERT(!ds_hs_has(&s, i * 5 + 1), "missing value");
+    }
+    ds_hs_free(&s);
+    PASS();
+}
+
+void test_hs_robin_hood_reseed(void) {
+    TEST("hs: colliding keys make a robin hood table reseed");
+    IntSet s = {0};
+    ds_hs_robin_hood(&s);
+    int keys[300];
+    int n = 0;
+    /* same home slot in every table up to 4096 slots under the initial seed */
+    for (int k = 0; n < 300; k++) {
+        if ((ds__ht_hash(&s, k) & 4095) == 0) keys[n++] = k;
+    }
+    for (int i = 0; i < n; i++) ds_hs_add(&s, keys[i]);
+    ASSERT(s.seed != 0, "seed changed");
+    ASSERT(ds__ht_max_probe(&s.table) <= DS_HM_MAX_PROBE, "probes short again");
+    ASSERT(s.table.capacity < 4096, "no runaway growth");
+    for (int i = 0; i < n; i++) ASSERT(ds_hs_has(&s, keys[i]), "key found after reseed");
+    ds_hs_free(&s);
+    PASS();
+}
+
+// ============================================================================
+// Concurrent Hash Map Tests
+// ============================================================================
+
+ds_chm_declare(IntIntCMap, int, int);
+ds_chm_declare(StrIntCMap, const char *, int);
+
+void test_chm_basic(void) {
+    TEST("chm: set, get, remove across shards");
+    IntIntCMap m;
+    ds_chm_init(&m);
+    for (int i = 0; i < 1000; i++) ds_chm_set(&m, i, i * 3);
+    ds_chm_set(&m, 7, 70);
+    ASSERT_EQ(ds_chm_length(&m), 1000, "length is summed over shards");
+    ASSERT_EQ(ds_chm_get(&m, 7), 70, "overwritten value");
+    ASSERT_EQ(ds_chm_get(&m, 999), 2997, "value in another shard");
+    ASSERT_EQ(ds_chm_get(&m, 5000), 0, "missing key gives zero");
+    int out = -1;
+    ASSERT(ds_chm_remove(&m, 10, &out), "remove existing key");
+    ASSERT_EQ(out, 30, "removed value copied out");
+    ASSERT(!ds_chm_remove(&m, 10, NULL), "second remove misses");
+    ASSERT(!ds_chm_has(&m, 10), "removed key is gone");
+    ASSERT(ds_chm_try_get(&m, 11, &out) && out == 33, "try_get copies the value");
+    ds_chm_free(&m);
+    PASS();
+}
+
+static int chm_init_calls = 0;
+static int chm_len_value(const char *key, void *ctx) {
+    chm_init_calls++;
+    return (int)strlen(key) + *(int *)ctx;
+}
+
+void test_chm_compute_if_absent(void) {
+    TEST("chm: compute_if_absent runs the initializer once");
+    StrIntCMap m;
+    ds_chm_init(&m);
+    int bonus = 100;
+    char key[] = "hello";
+    ASSERT_EQ(ds_chm_compute_if_absent(&m, key, chm_len_value, &bonus), 105, "computed");
+    key[0] = 'j'; // the map owns a copy of the key
+    ASSERT_EQ(ds_chm_compute_if_absent(&m, "hello", chm_len_value, &bonus), 105, "cached");
+    ASSERT_EQ(chm_init_calls, 1, "initializer ran once");
+    ASSERT_EQ(ds_chm_get(&m, "hello"), 105, "value is stored");
+    ds_chm_free(&m);
+    PASS();
+}
+
+#define CHM_THREADS 4
+#define CHM_KEYS_PER_THREAD 20000
+
+typedef struct {
+    IntIntCMap *map;
+    int id;
+    int errors;
+} ChmWorker;
+
+static void *chm_worker(void *arg) {
+    ChmWorker *w = arg;
+    int base = w->id * CHM_KEYS_PER_THREAD;
+    for (int i = 0; i < CHM_KEYS_PER_THREAD; i++) {
+        ds_chm_set(w->map, base + i, base + i);
+        // read back own keys and probe the keys of the other threads
+        int own = base + (i / 2 & ~3); // keys with i % 4 == 3 get removed
+        if (ds_chm_get(w->map, own) != own) w->errors++;
+        int other = ((w->id + 1) % CHM_THREADS) * CHM_KEYS_PER_THREAD + i;
+        int v;
+        if (ds_chm_try_get(w->map, other, &v) && v != other) w->errors++;
+        if (i % 4 == 3 && !ds_chm_remove(w->map, base + i, NULL)) w->errors++;
+    }
+    return NULL;
+}
+
+void test_chm_threads(void) {
+    TEST("chm: concurrent writers and readers");
+    IntIntCMap m;
+    ds_chm_init(&m);
+    pthread_t threads[CHM_THREADS];
+    ChmWorker workers[CHM_THREADS];
+    for (int t = 0; t < CHM_THREADS; t++) {
+        workers[t] = (ChmWorker){.map = &m, .id = t};
+        pthread_create(&threads[t], NULL, chm_worker, &workers[t]);
+    }
+    int errors = 0;
+    for (int t = 0; t < CHM_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        errors += workers[t].errors;
+    }
+    ASSERT_EQ(errors, 0, "every thread saw consistent values");
+    ASSERT_EQ(ds_chm_length(&m), CHM_THREADS * CHM_KEYS_PER_THREAD * 3 / 4, "final length");
+    for (int k = 0; k < CHM_THREADS * CHM_KEYS_PER_THREAD; k++)
+        ASSERT_EQ(ds_chm_has(&m, k), k % 4 != 3, "final contents");
+    ds_chm_free(&m);
+    PASS();
+}
+
+ds_cache_declare(IntCache, int, int, 100);
+ds_cache_declare(StrCache, char *, int, 8);
+
+static void count_evicted(int *key, int *value, void *ctx) {
+    DS_UNUSED(key);
+    DS_UNUSED(value);
+    (*(int *)ctx)++;
+}
+
+static void free_evicted_key(char **key, int *value, void *ctx) {
+    DS_UNUSED(value);
+    DS_UNUSED(ctx);
+    free(*key);
+}
+
+void test_cache_basic(void) {
+    TEST("cache: put, get, update and remove");
+    IntCache c;
+    int evicted = 0;
+    IntCache_init(&c, count_evicted, &evicted);
+    for (int i = 0; i < 50; i++) IntCache_put(&c, i, i * 10);
+    ASSERT_EQ(*IntCache_get(&c, 7), 70, "cached value");
+    ASSERT(IntCache_get(&c, 50) == NULL, "missing key");
+    ASSERT_EQ(c.hits, 1, "hit counted");
+    ASSERT_EQ(c.misses, 1, "miss counted");
+    ASSERT_EQ(*IntCache_put(&c, 7, 71), 71, "update");
+    ASSERT_EQ(c.map.length, 50, "update does not grow");
+    ASSERT(IntCache_remove(&c, 0), "removed");
+    ASSERT(!IntCache_remove(&c, 0), "removed twice");
+    ASSERT_EQ(evicted, 1, "callback on remove");
+    ASSERT(IntCache_get(&c, 0) == NULL, "removed key absent");
+    ASSERT_EQ(*IntCache_get(&c, 49), 490, "moved entry still found");
+    IntCache_free(&c);
+    ASSERT_EQ(evicted, 50, "callback on free");
+    PASS();
+}
+
+void test_cache_clock_eviction(void) {
+    TEST("cache: CLOCK keeps referenced entries, never reallocates");
+    IntCache c;
+    int evicted = 0;
+    IntCache_init(&c, count_evicted, &evicted);
+    void *data = c.map.data, *index = c.map.table.data;
+    for (int i = 0; i < 100; i++) IntCache_put(&c, i, i);
+    for (int i = 0; i < 10; i++) IntCache_get(&c, i); /* hot set */
+    for (int i = 100; i < 190; i++) {
+        IntCache_put(&c, i, i);
+        for (int k = 0; k < 10; k++) ASSERT(IntCache_get(&c, k) != NULL, "hot key survives the scan");
+    }
+    ASSERT_EQ(c.map.length, 100, "bounded");
+    ASSERT_EQ(c.evictions, 90, "one eviction per insert when full");
+    ASSERT_EQ(evicted, 90, "callback on eviction");
+    for (int i = 10; i < 100; i++) ASSERT(IntCache_get(&c, i) == NULL, "cold key evicted");
+    for (int i = 100; i < 190; i++) ASSERT_EQ(*IntCache_get(&c, i), i, "new key cached");
+    for (int i = 0; i < 5000; i++) {
+        IntCache_put(&c, i % 731, i);
+        if (i % 3 == 0) IntCache_remove(&c, (i * 7) % 731);
+    }
+    ASSERT(c.map.data == data && c.map.table.data == index, "no reallocation");
+    size_t found = 0;
+    for (int i = 0; i < 731; i++) found += IntCache_get(&c, i) != NULL;
+    ASSERT_EQ(found, c.map.length, "every entry reachable");
+    IntCache_free(&c);
+    PASS();
+}
+
+void test_cache_string_keys(void) {
+    TEST("cache: string keys released by the eviction callback");
+    StrCache c;
+    StrCache_init(&c, free_evicted_key, NULL);
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        if (!StrCache_get(&c, key)) StrCache_put(&c, strdup(key), i);
+    }
+    ASSERT_EQ(c.map.length, 8, "bounded");
+    ASSERT_EQ(*StrCache_get(&c, "k99"), 99, "latest cached");
+    ASSERT(StrCache_get(&c, "k0") == NULL, "oldest evicted");
+    StrCache_free(&c);
+    PASS();
+}
+
+void test_bloom_basic(void) {
+    TEST("bloom: no false negatives, false positives near the target");
+    DsBloom bf;
+    ds_bloom_init(&bf, 10000, 0.01);
+    for (int i = 0; i < 10000; i++) ds_bloom_add(&bf, i);
+    for (int i = 0; i < 10000; i++) ASSERT(ds_bloom_has(&bf, i), "added key found");
+    int fp = 0;
+    for (int i = 10000; i < 110000; i++) fp += ds_bloom_has(&bf, i);
+    ASSERT(fp < 2000, "false positive rate under 2%");
+    ds_bloom_add(&bf, "hello");
+    char key[] = "hello";
+    ASSERT(ds_bloom_has(&bf, (const char *)key), "strings hashed by content");
+    ds_bloom_clear(&bf);
+    ASSERT(!ds_bloom_has(&bf, 1), "cleared");
+    ds_bloom_free(&bf);
+    PASS();
+}
+
+void test_hs_bloom(void) {
+    TEST("hs: Bloom filter front through growth, removes and clear");
+    IntSet s = {0};
+    ds_hs_add(&s, -1);
+    ds_hs_bloom(&s, 0.01);
+    for (int i = 0; i < 20000; i += 2) ds_hs_add(&s, i);
+    ASSERT(ds__ht_bloom(&s.table) != NULL && ds__ht_bloom(&s.table)->capacity >= s.length, "filter grew with the set");
+    for (int i = 0; i < 20000; i++) ASSERT_EQ(ds_hs_has(&s, i), i % 2 == 0, "lookups through the filter");
+    ASSERT(ds_hs_has(&s, -1), "value added before the filter");
+    for (int i = 0; i < 20000; i += 4) ds_hs_remove(&s, i);
+    for (int i = 0; i < 20000; i++) ASSERT_EQ(ds_hs_has(&s, i), i % 4 == 2, "removed values absent");
+    ds_hs_clear(&s);
+    ASSERT(!ds_hs_has(&s, 2), "cleared");
+    ds_hs_add(&s, 2);
+    ASSERT(ds_hs_has(&s, 2), "added after clear");
+    ds_hs_free(&s);
+    ASSERT(ds__ht_bloom(&s.table) == NULL, "free releases the filter");
+    PASS();
+}
+
+ds_btree_declare(IntTree, int, int);
+ds_btree_declare(StrTree, const char *, int);
+ds_da_declare(IntTreeEntries, IntTree_Entry);
+
+#define BTREE_KEYS 2000
+
+/* walk the leaves and compare with `vals` (-1 = absent) */
+static bool btree_matches(IntTree *t, const int *vals) {
+    size_t n = 0, present = 0;
+    int prev = -1;
+    for (IntTree_Iter it = IntTree_first(t); it.key; IntTree_next(&it)) {
+        if (*it.key <= prev || *it.key >= BTREE_KEYS || vals[*it.key] != *it.value) return false;
+        prev = *it.key;
+        n++;
+    }
+    for (int k = 0; k < BTREE_KEYS; k++) present += vals[k] >= 0;
+    return n == present && t->length == present;
+}
+
+void test_btree_basic(void) {
+    TEST("btree: random sets and removes stay ordered");
+    IntTree t = {0};
+    static int vals[BTREE_KEYS];
+    for (int k = 0; k < BTREE_KEYS; k++) vals[k] = -1;
+    ASSERT(IntTree_get(&t, 1) == NULL && !IntTree_remove(&t, 1), "empty tree");
+    ASSERT(IntTree_first(&t).key == NULL, "empty iteration");
+    uint64_t s = 42;
+    size_t length = 0;
+    for (int i = 0; i < 20000; i++) {
+        s ^= s << 13, s ^= s >> 7, s ^= s << 17;
+        int k = (int)(s % BTREE_KEYS);
+        if ((s >> 32) % 3 == 0) {
+            ASSERT_EQ(IntTree_remove(&t, k), vals[k] >= 0, "remove finds present keys");
+            length -= vals[k] >= 0;
+            vals[k] = -1;
+        } else {
+            length += vals[k] < 0;
+            IntTree_set(&t, k, i);
+            vals[k] = i;
+        }
+        ASSERT_EQ(t.length, length, "length");
+    }
+    ASSERT(t.height >= (DS_BTREE_NODE_SIZE <= 64 ? 2 : 1), "several levels"); // 2 in test_ds_small
+    ASSERT(btree_matches(&t, vals), "in order with the latest values");
+    for (int k = 0; k < BTREE_KEYS; k++) {
+        int *v = IntTree_get(&t, k);
+        ASSERT(vals[k] >= 0 ? v && *v == vals[k] : !v, "get");
+    }
+    for (int k = 0; k < BTREE_KEYS; k += 2) {
+        IntTree_remove(&t, k);
+        vals[k] = -1;
+    }
+    ASSERT(btree_matches(&t, vals), "after removing the even keys");
+    for (int k = 1; k < BTREE_KEYS; k += 2) IntTree_remove(&t, k);
+    ASSERT(t.root == NULL && t.height == 0 && t.length == 0, "emptied");
+    IntTree_set(&t, 7, 7);
+    ASSERT(*IntTree_get(&t, 7) == 7, "reusable");
+    IntTree_free(&t);
+    PASS();
+}
+
+void test_btree_bounds(void) {
+    TEST("btree: lower/upper bound and range iteration");
+    IntTree t = {0};
+    for (int k = 0; k < 1000; k += 10) IntTree_set(&t, k, k / 10);
+    IntTree_Iter it = IntTree_lower_bound(&t, 250);
+    ASSERT(it.key && *it.key == 250 && *it.value == 25, "lower bound on a key");
+    it = IntTree_upper_bound(&t, 250);
+    ASSERT(it.key && *it.key == 260, "upper bound on a key");
+    it = IntTree_lower_bound(&t, 251);
+    ASSERT(it.key && *it.key == 260, "lower bound between keys");
+    it = IntTree_lower_bound(&t, -5);
+    ASSERT(it.key && *it.key == 0, "lower bound before the first key");
+    ASSERT(IntTree_lower_bound(&t, 991).key == NULL, "past the end");
+    ASSERT(IntTree_upper_bound(&t, 990).key == NULL, "upper bound of the last key");
+    int n = 0, sum = 0;
+    for (it = IntTree_lower_bound(&t, 95); it.key && *it.key < 505; IntTree_next(&it)) {
+        n++;
+        sum += *it.key;
+    }
+    ASSERT_EQ(n, 41, "keys in [95, 505)");
+    ASSERT_EQ(sum, 41 * 300, "range contents");
+    IntTree_free(&t);
+    PASS();
+}
+
+void test_btree_load(void) {
+    TEST("btree: bulk load from a sorted array, arena nodes");
+    IntTreeEntries entries = {0};
+    for (int k = 0; k < 5000; k++) ds_da_append(&entries, ((IntTree_Entry){.key = k * 2, .value = k}));
+    DsArena arena = {0};
+    IntTree t = {.arena = &arena};
+    IntTree_load(&t, entries.data, entries.length);
+    ASSERT_EQ(t.length, 5000, "length");
+    int expect = 0;
+    for (IntTree_Iter it = IntTree_first(&t); it.key; IntTree_next(&it), expect++) {
+        if (*it.key != expect * 2 || *it.value != expect) break;
+    }
+    ASSERT_EQ(expect, 5000, "loaded in order");
+    for (int k = 0; k < 10000; k++) ASSERT_EQ(IntTree_has(&t, k), k % 2 == 0, "lookups");
+    /* full nodes split on the first inserts */
+    for (int k = 1; k < 10000; k += 2) IntTree_set(&t, k, -k);
+    for (int k = 0; k < 10000; k += 4) IntTree_remove(&t, k);
+    ASSERT_EQ(t.length, 7500, "length after changes");
+    expect = 0;
+    int prev = -1;
+    for (IntTree_Iter it = IntTree_first(&t); it.key; IntTree_next(&it), expect++) {
+        if (*it.key <= prev || *it.key % 4 == 0) break;
+        prev = *it.key;
+    }
+    ASSERT_EQ(expect, 7500, "ordered after changes");
+    IntTree_free(&t);
+    ds_a_free(&arena);
+
+    IntTree small = {0};
+    IntTree_load(&small, entries.data, 3);
+    ASSERT(small.height == 0 && *IntTree_get(&small, 4) == 2, "single leaf");
+    IntTree_free(&small);
+    ds_da_free(&entries);
+    PASS();
+}
+
+void test_btree_string_keys(void) {
+    TEST("btree: string keys ordered by content");
+    StrTree t = {0};
+    const char *words[] = {"pear", "apple", "fig", "banana", "cherry", "date", "grape", "kiwi", "lemon", "mango"};
+    for (int i = 0; i < 10; i++) StrTree_set(&t, words[i], i);
+    char key[] = "fig";
+    ASSERT(StrTree_get(&t, key) && *StrTree_get(&t, key) == 2, "lookup with another pointer");
+    const char *prev = "";
+    int n = 0;
+    for (StrTree_Iter it = StrTree_first(&t); it.key; StrTree_next(&it), n++) {
+        ASSERT(strcmp(prev, *it.key) < 0, "ascending");
+        prev = *it.key;
+    }
+    ASSERT_EQ(n, 10, "all keys");
+    StrTree_Iter it = StrTree_lower_bound(&t, "c");
+    ASSERT(it.key && strcmp(*it.key, "cherry") == 0, "lower bound by prefix");
+    ASSERT(StrTree_remove(&t, "apple") && !StrTree_has(&t, "apple"), "remove");
+    StrTree_free(&t);
+    PASS();
+}
+
+ds_fm_declare(IntFlat, int, int);
+ds_fm_declare(StrFlat, const char *, int);
+#define ci_less(a, b) (strcasecmp((a), (b)) < 0)
+ds_fm_declare_ex(CiFlat, const char *, int, ci_less, ci_hash);
+
+void test_fm_basic(void) {
+    TEST("fm: sorted set, get and remove");
+    IntFlat m = {0};
+    ASSERT(IntFlat_get(&m, 1) == NULL && !IntFlat_remove(&m, 1), "empty map");
+    int keys[] = {42, 7, 19, 3, 88, 7, 64, 1};
+    for (int i = 0; i < 8; i++) IntFlat_set(&m, keys[i], i);
+    ASSERT_EQ(IntFlat_length(&m), 7, "duplicate updated in place");
+    ASSERT(*IntFlat_get(&m, 7) == 5, "latest value");
+    ASSERT(m.keys.capacity <= 8 && m.map == NULL, "small arrays, no hash map");
+    int prev = -1, n = 0;
+    ds_fm_foreach(&m, k, v) {
+        ASSERT(*k > prev, "ascending keys");
+        ASSERT(*IntFlat_get(&m, *k) == *v, "value next to its key");
+        prev = *k;
+        n++;
+    }
+    ASSERT_EQ(n, 7, "foreach visits every entry");
+    ASSERT(IntFlat_remove(&m, 19) && !IntFlat_has(&m, 19), "removed");
+    ASSERT(IntFlat_has(&m, 1) && IntFlat_has(&m, 88), "ends kept");
+    n = 0;
+    ds_fm_foreach(&m, k, v) {
+        DS_UNUSED(v);
+        if (*k == 42) break;
+        n++;
+    }
+    ASSERT_EQ(n, 3, "break leaves the loop");
+    IntFlat_free(&m);
+    PASS();
+}
+
+void test_fm_promote(void) {
+    TEST("fm: promotes to a hash map past DS_FM_MAX");
+    IntFlat m = {0};
+    for (int i = 0; i < DS_FM_MAX; i++) IntFlat_set(&m, i * 3, i);
+    ASSERT(m.map == NULL && IntFlat_length(&m) == DS_FM_MAX, "flat while at the limit");
+    IntFlat_set(&m, 0, -1);
+    ASSERT(m.map == NULL, "updates do not promote");
+    for (int i = DS_FM_MAX; i < 500; i++) IntFlat_set(&m, i * 3, i);
+    ASSERT(m.map != NULL && m.keys.data == NULL, "promoted");
+    ASSERT_EQ(IntFlat_length(&m), 500, "length after promotion");
+    for (int k = 0; k < 1500; k++) {
+        int *v = IntFlat_get(&m, k);
+        ASSERT(k % 3 == 0 ? v && *v == (k == 0 ? -1 : k / 3) : !v, "lookups after promotion");
+    }
+    for (int k = 0; k < 1500; k += 6) ASSERT(IntFlat_remove(&m, k), "remove after promotion");
+    size_t n = 0;
+    ds_fm_foreach(&m, k, v) n += *k % 6 == 3 && *v == *k / 3;
+    ASSERT_EQ(n, 250, "foreach after promotion");
+    IntFlat_free(&m);
+    ASSERT(m.map == NULL && IntFlat_length(&m) == 0, "freed");
+    PASS();
+}
+
+void test_fm_string_keys(void) {
+    TEST("fm: string keys by content, flat and promoted");
+    StrFlat m = {0};
+    char buf[DS_FM_MAX + 8][16];
+    for (int i = 0; i < DS_FM_MAX + 8; i++) {
+        snprintf(buf[i], sizeof(buf[i]), "k%03d", i);
+        StrFlat_set(&m, buf[i], i);
+        if (i == 0) ASSERT(m.keys.data[0] == buf[0], "flat keys are not copied");
+        char probe[16];
+        snprintf(probe, sizeof(probe), "k%03d", i / 2);
+        ASSERT(StrFlat_get(&m, probe) && *StrFlat_get(&m, probe) == i / 2, "lookup with another pointer");
+    }
+    ASSERT(m.map != NULL, "promoted");
+    ds_fm_foreach(&m, k, v) ASSERT(*k == buf[*v], "promoted keys are still the caller's");
+    ASSERT(StrFlat_remove(&m, "k010") && !StrFlat_has(&m, "k010"), "remove by content");
+    StrFlat_free(&m);
+    PASS();
+}
+
+void test_fm_custom_order(void) {
+    TEST("fm: custom order and hash survive promotion");
+    CiFlat m = {0};
+    char buf[DS_FM_MAX + 8][16];
+    for (int i = 0; i < DS_FM_MAX + 8; i++) {
+        snprintf(buf[i], sizeof(buf[i]), "Key%03d", i);
+        CiFlat_set(&m, buf[i], i);
+        ASSERT(CiFlat_get(&m, "KEY000") && *CiFlat_get(&m, "key000") == 0, "case-insensitive lookup");
+    }
+    ASSERT(m.map != NULL, "promoted");
+    CiFlat_set(&m, "KEY005", 50);
+    ASSERT_EQ(CiFlat_length(&m), DS_FM_MAX + 8, "equal keys share an entry");
+    ASSERT_EQ(*CiFlat_get(&m, "key005"), 50, "updated through another case");
+    ASSERT(CiFlat_remove(&m, "kEy010") && !CiFlat_has(&m, "Key010"), "remove");
+    CiFlat_free(&m);
+    PASS();
+}
+
+ds_sort_declare(IntSort, int);
+ds_sort_declare(StrSort, const char *);
+
+typedef struct {
+    int key;
+    int seq;
+} SortPair;
+#define sort_pair_less(a, b) ((a).key < (b).key)
+ds_sort_declare_ex(PairSort, SortPair, sort_pair_less);
+ds_da_declare(PairArray, SortPair);
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+void test_sort_patterns(void) {
+    TEST("sort: matches qsort on random and patterned input");
+    size_t sizes[] = {0, 1, 2, 3, 24, 25, 129, 1000, 50000};
+    int *a = malloc(50000 * sizeof(int)), *b = malloc(50000 * sizeof(int));
+    uint64_t seed = 1;
+    for (int pattern = 0; pattern < 7; pattern++) {
+        for (size_t s = 0; s < DS_ARRAY_LEN(sizes); s++) {
+            size_t n = sizes[s];
+            for (size_t i = 0; i < n; i++) {
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+                int r = (int)(seed >> 33);
+                switch (pattern) {
+                case 0: a[i] = r; break;                              // random
+                case 1: a[i] = (int)i; break;                         // sorted
+                case 2: a[i] = (int)(n - i); break;                   // reversed
+                case 3: a[i] = 7; break;                              // all equal
+                case 4: a[i] = r % 4; break;                          // few distinct
+                case 5: a[i] = (int)(i < n / 2 ? i : n - i); break;   // organ pipe
+                default: a[i] = i % 100 == 0 ? r : (int)i; break;     // nearly sorted
+                }
+            }
+            memcpy(b, a, n * sizeof(int));
+            qsort(b, n, sizeof(int), cmp_int);
+            IntSort_sort(a, n);
+            ASSERT(IntSort_is_sorted(a, n), "sorted");
+            ASSERT(n == 0 || memcmp(a, b, n * sizeof(int)) == 0, "same items as qsort");
+        }
+    }
+    IntArray da = {0};
+    ds_da_append_many(&da, ((int[]){5, -3, 9, 0, -3}), 5);
+    ds_da_sort(&da, IntSort);
+    ASSERT(da.data[0] == -3 && da.data[1] == -3 && da.data[4] == 9, "ds_da_sort");
+    ds_da_free(&da);
+    const char *words[] = {"pear", "apple", "fig", "banana", "apple"};
+    StrSort_sort(words, 5);
+    ASSERT(strcmp(words[0], "apple") == 0 && strcmp(words[2], "banana") == 0 && strcmp(words[4], "pear") == 0,
+           "strings by content");
+    free(a);
+    free(b);
+    PASS();
+}
+
+void test_sort_stable(void) {
+    TEST("sort: stable merge sort keeps ties in order");
+    PairArray da = {0};
+    uint64_t seed = 7;
+    for (int i = 0; i < 10000; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        ds_da_append(&da, ((SortPair){(int)(seed >> 33) % 50, i}));
+    }
+    ds_da_stable_sort(&da, PairSort);
+    for (size_t i = 1; i < da.length; i++) {
+        ASSERT(da.data[i - 1].key <= da.data[i].key, "sorted by key");
+        ASSERT(da.data[i - 1].key < da.data[i].key || da.data[i - 1].seq < da.data[i].seq, "ties in input order");
+    }
+    SortPair few[] = {{2, 0}, {1, 1}, {2, 2}, {1, 3}};
+    PairSort_stable_sort(few, 4);
+    ASSERT(few[0].seq == 1 && few[1].seq == 3 && few[2].seq == 0 && few[3].seq == 2, "short input");
+    ds_da_free(&da);
+    PASS();
+}
+
+void test_sort_search_merge(void) {
+    TEST("sort: bsearch, bounds and merge");
+    IntArray a = {0}, b = {0}, out = {0};
+    ds_da_append_many(&a, ((int[]){1, 3, 3, 3, 7, 9}), 6);
+    ds_da_append_many(&b, ((int[]){0, 3, 8, 10}), 4);
+    ASSERT_EQ(ds_da_lower_bound(&a, IntSort, 3), 1, "lower bound");
+    ASSERT_EQ(ds_da_upper_bound(&a, IntSort, 3), 4, "upper bound");
+    ASSERT_EQ(ds_da_lower_bound(&a, IntSort, 10), 6, "past the end");
+    ASSERT_EQ(ds_da_upper_bound(&a, IntSort, -1), 0, "before the start");
+    int *x = ds_da_bsearch(&a, IntSort, 7);
+    ASSERT(x && x == &a.data[4], "bsearch hit");
+    ASSERT(ds_da_bsearch(&a, IntSort, 4) == NULL && ds_da_bsearch(&out, IntSort, 4) == NULL, "bsearch miss");
+    ds_da_merge(&out, &a, &b, IntSort);
+    int want[] = {0, 1, 3, 3, 3, 3, 7, 8, 9, 10};
+    ASSERT(out.length == 10 && memcmp(out.data, want, sizeof(want)) == 0, "merged");
+    ds_da_merge(&out, &b, &b, IntSort);
+    ASSERT(out.length == 8 && IntSort_is_sorted(out.data, out.length), "merge replaces the contents");
+    SortPair l[] = {{1, 0}, {2, 1}}, r[] = {{1, 2}, {2, 3}}, m[4];
+    PairSort_merge(m, l, 2, r, 2);
+    ASSERT(m[0].seq == 0 && m[1].seq == 2 && m[2].seq == 1 && m[3].seq == 3, "ties take the left side first");
+    ds_da_free(&a);
+    ds_da_free(&b);
+    ds_da_free(&out);
+    PASS();
+}
+
+ds_da_declare(U64Array, uint64_t);
+ds_da_declare(DoubleArray, double);
+ds_da_declare(I8Array, int8_t);
+
+void test_radix_sort(void) {
+    TEST("sort: radix sort of integers, floats and struct fields");
+    IntArray ints = {0};
+    U64Array u = {0};
+    DoubleArray d = {0};
+    uint64_t seed = 3;
+    for (int i = 0; i < 5000; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        ds_da_append(&ints, (int)(seed >> 32));
+        ds_da_append(&u, seed);
+        ds_da_append(&d, ((double)(int64_t)seed) / 1e9);
+    }
+    ds_da_append(&d, -0.0);
+    ds_da_append(&d, 0.0);
+    ds_da_radix_sort(&ints);
+    ds_da_radix_sort(&u);
+    ds_da_radix_sort(&d);
+    ASSERT(IntSort_is_sorted(ints.data, ints.length) && ints.data[0] < 0, "signed ints");
+    for (size_t i = 1; i < u.length; i++) ASSERT(u.data[i - 1] <= u.data[i], "unsigned 64-bit");
+    for (size_t i = 1; i < d.length; i++) ASSERT(d.data[i - 1] <= d.data[i], "doubles");
+    I8Array small = {0};
+    ds_da_append_many(&small, ((int8_t[]){5, -128, 127, 0, -1}), 5);
+    ds_da_radix_sort(&small);
+    ASSERT(small.data[0] == -128 && small.data[1] == -1 && small.data[4] == 127, "one-byte keys");
+    PairArray p = {0};
+    for (int i = 0; i < 1000; i++) ds_da_append(&p, ((SortPair){(i * 37) % 11 - 5, i}));
+    ds_da_radix_sort_by(&p, key);
+    for (size_t i = 1; i < p.length; i++) {
+        ASSERT(p.data[i - 1].key < p.data[i].key ||
+                   (p.data[i - 1].key == p.data[i].key && p.data[i - 1].seq < p.data[i].seq),
+               "by field, stable");
+    }
+    ds_da_free(&ints);
+    ds_da_free(&u);
+    ds_da_free(&d);
+    ds_da_free(&small);
+    ds_da_free(&p);
+    PASS();
+}
+
+static inline size_t u32_weak_hash(const uint32_t *k, size_t seed) {
+    DS_UNUSED(seed);
+    return (size_t)*k << 10; /* the low bits never change */
+}
+
+ds_hm_declare_ex(WeakU32Map, uint32_t, uint32_t, u32_weak_hash, u32_eq);
+
+void test_hm_stats(void) {
+    TEST("hm: stats report load, probes, memory and counters");
+    IntIntMap hm = {0};
+    DsHmStats st;
+    ds_hm_stats(&hm, &st);
+    ASSERT(st.length == 0 && st.slots == 0 && st.index_bytes == 0 && st.resizes == 0, "empty map");
+    for (int i = 0; i < 1000; i++) ds_hm_set(&hm, i, i);
+    int found = 0;
+    for (int i = 0; i < 500; i++) found += ds_hm_try(&hm, i * 4) != NULL;
+    ASSERT_EQ(found, 250, "lookups");
+    ds_hm_stats(&hm, &st);
+    ASSERT_EQ(st.length, 1000, "length");
+    ASSERT_EQ(st.slots, hm.table.capacity, "slots");
+    ASSERT(st.load_factor > 0.25 && st.load_factor <= DS_HM_LOAD_FACTOR, "load factor");
+    size_t sum = 0;
+    for (size_t i = 0; i < DS_HM_STATS_HIST; i++) sum += st.probe_hist[i];
+    ASSERT_EQ(sum, 1000, "every entry in the histogram");
+    ASSERT(st.probe_hist[0] > 900, "good hash: almost all in the first group");
+    ASSERT(st.mean_displacement <= (double)st.max_displacement, "mean below max");
+    ASSERT_EQ(st.resizes, 7, "first index, then 64 to 2048 slots");
+    ASSERT_EQ(st.entry_bytes, hm.capacity * sizeof(*hm.data), "entry bytes");
+    ASSERT(st.index_bytes >= st.slots * 3, "index bytes: 2-byte indices and control bytes");
+    ASSERT_EQ(st.key_bytes, 0, "no copied keys");
+#ifdef DS_HM_STATS
+    ASSERT_EQ(st.lookups, 1500, "a search per set and get");
+    ASSERT_EQ(st.misses, 1000 + 250, "new keys and absent keys missed");
+    ASSERT(st.probes >= st.lookups, "at least a group per search");
+#endif
+    for (int i = 0; i < 950; i++) ds_hm_remove(&hm, i);
+    ds_hm_shrink(&hm);
+    DsHmStats small;
+    ds_hm_stats(&hm, &small);
+    ASSERT(small.slots < st.slots && small.index_bytes < st.index_bytes, "shrink drops index bytes");
+    ASSERT_EQ(small.resizes, 8, "shrink is a resize");
+    ds_hm_free(&hm);
+    ds_hm_stats(&hm, &st);
+    ASSERT(st.resizes == 0 && st.lookups == 0, "free resets the counts");
+    PASS();
+}
+
+void test_hm_stats_shapes(void) {
+    TEST("hm: stats see clustering, string keys and frozen maps");
+    WeakU32Map weak = {0};
+    U32Map good = {0};
+    for (uint32_t i = 0; i < 1000; i++) {
+        WeakU32Map_set(&weak, i, i);
+        U32Map_set(&good, i, i);
+    }
+    DsHmStats ws, gs;
+    WeakU32Map_stats(&weak, &ws);
+    U32Map_stats(&good, &gs);
+    ASSERT(gs.max_displacement < 100, "good hash: short probes");
+    if (weak.table.flags & DS__HT_ROBIN_HOOD) {
+        /* long probes make Robin Hood tables grow, to little avail */
+        ASSERT(ws.load_factor < 0.25 && ws.max_displacement > DS_HM_MAX_PROBE, "clustered hash shows");
+    } else {
+        ASSERT(ws.max_displacement >= 400, "clustered hash shows");
+        ASSERT(ws.probe_hist[DS_HM_STATS_HIST - 1] > 500, "long probes in the last bucket");
+    }
+    ds_hm_free(&weak);
+    ds_hm_free(&good);
+
+    StrIntMap hm = {0};
+    ds_hm_set(&hm, "alpha", 1);
+    ds_hm_set(&hm, "be", 2);
+    DsHmStats st;
+    ds_hm_stats(&hm, &st);
+    ASSERT_EQ(st.key_bytes, 2 * (sizeof(size_t) + 1) + 5 + 2, "copied key bytes");
+    ASSERT(ds_hm_freeze(&hm), "freeze");
+    ds_hm_stats(&hm, &st);
+    ASSERT(st.frozen && st.probe_hist[0] == 2 && st.max_displacement == 0, "frozen: one probe each");
+    ds_hm_free(&hm);
+
+    IntSet s = {0};
+    for (int i = 0; i < 100; i++) ds_hs_add(&s, i);
+    ds_hs_stats(&s, &st);
+    ASSERT(st.length == 100 && st.entry_bytes == s.capacity * sizeof(int), "sets");
+    ds_hs_free(&s);
+    PASS();
+}
+
+void test_hm_stats_json(void) {
+    TEST("hm: stats as JSON");
+    IntIntMap hm = {0};
+    for (int i = 0; i < 3; i++) ds_hm_set(&hm, i, i);
+    DsHmStats st;
+    ds_hm_stats(&hm, &st);
+    DsString json = {0};
+    ds_hm_stats_json(&json, &st);
+    ASSERT(json.length > 0 && json.data[0] == '{' && json.data[json.length - 1] == '}', "one object");
+    ASSERT(strstr(json.data, "{\"length\":3,\"slots\":32,") != NULL, "counts");
+    ASSERT(strstr(json.data, "\"load_factor\":0.094") != NULL, "load factor");
+    ASSERT(strstr(json.data, "\"frozen\":false,\"probe_hist\":[3,0,0,0,0,0,0,0]}") != NULL, "histogram");
+    ds_da_free(&json);
+    ds_hm_free(&hm);
+    PASS();
+}
+
 int main(void) {
     setbuf(stdout, NULL); // disable buffering for test output
-    printf("=== ds.h Test Suite ===\n");
+    printf("=== ds.h Test Suite%s ===\n", TEST_DS_CONFIG);
 
     // Dynamic Array
     SECTION("Dynamic Array");
@@ -1789,6 +3612,13 @@ int main(void) {
     test_da_shrink_empty();
     test_da_shrink_noop_when_fitted();
     test_da_shrink_on_zero_init();
+    test_sda_inline_then_heap();
+    test_sda_da_macros();
+#ifdef DS_DA_LARGE_THRESHOLD
+    test_da_large_mapping();
+#endif
+    test_seg_stable_addresses();
+    test_seg_bulk();
 
     // String Builder
     SECTION("String Builder");
@@ -1838,6 +3668,22 @@ int main(void) {
     test_hm_shrink_empty_frees();
     test_hm_shrink_then_insert();
     test_hm_shrink_strings();
+    test_hm_key_arena();
+    test_hm_key_arena_external();
+    test_hm_plain_table_state();
+    test_hm_clear_keeps_capacity();
+    test_hm_bulk_int();
+    test_hm_bulk_strings();
+    test_hm_freeze();
+    test_hm_freeze_thaw();
+    test_hm_declare_ex();
+    test_hm_declare_ex_tables();
+    test_hm_declare_ex_string_keys();
+    test_hm_string_view();
+    test_hm_string_view_arena();
+    test_hm_save_map();
+    test_hm_save_map_str();
+    test_hm_map_errors();
 
     // Hash Set
     SECTION("Hash Set");
@@ -1848,6 +3694,9 @@ int main(void) {
     test_hs_string_values();
     test_hs_cat();
     test_hs_sub();
+    test_hs_intersect();
+    test_hs_set_ops_large();
+    test_hs_set_ops_strings();
     test_hs_remove_stress();
     test_hs_has_empty();
     test_hs_to_da_and_back();
@@ -1856,6 +3705,54 @@ int main(void) {
     test_hs_shrink_basic();
     test_hs_shrink_empty_frees();
     test_hs_shrink_then_add();
+    test_hs_clear();
+    test_hs_freeze();
+
+    // Hash Table Internals
+    SECTION("Hash Table Internals");
+    test_hm_ctrl_bytes_track_entries();
+    test_hs_probe_wraps_table_end();
+    test_hm_store_hash();
+    test_hs_store_hash_enable_later();
+    test_hash_family();
+    test_hm_index_width_grows();
+    test_hm_incremental_resize();
+    test_hs_robin_hood();
+    test_hs_robin_hood_reseed();
+    test_hm_stats();
+    test_hm_stats_shapes();
+    test_hm_stats_json();
+
+    SECTION("Concurrent Hash Map");
+    test_chm_basic();
+    test_chm_compute_if_absent();
+    test_chm_threads();
+
+    SECTION("Cache");
+    test_cache_basic();
+    test_cache_clock_eviction();
+    test_cache_string_keys();
+
+    SECTION("Bloom Filter");
+    test_bloom_basic();
+    test_hs_bloom();
+
+    SECTION("B+Tree");
+    test_btree_basic();
+    test_btree_bounds();
+    test_btree_load();
+    test_btree_string_keys();
+
+    SECTION("Flat Map");
+    test_fm_basic();
+    test_fm_promote();
+    test_fm_string_keys();
+    test_fm_custom_order();
+    SECTION("Sorting");
+    test_sort_patterns();
+    test_sort_stable();
+    test_sort_search_merge();
+    test_radix_sort();
 
     // Linked List
     SECTION("Linked List");
@@ -1866,6 +3763,19 @@ int main(void) {
     test_ll_mixed_push_append();
     test_ll_free_empties();
 
+    // Ring Buffer
+    SECTION("Ring Buffer");
+    test_rb_deque();
+    test_rb_bulk();
+    test_rb_fixed();
+
+    // Lock-free Queues
+    SECTION("Lock-free Queues");
+    test_spsc_basic();
+    test_spsc_threads();
+    test_mpmc_basic();
+    test_mpmc_threads();
+
     // String Iterator
     SECTION("String Iterator");
     test_s_split_basic();
@@ -1891,6 +3801,7 @@ int main(void) {
     test_arena_realloc_shrink();
     test_arena_snapshot_restore();
     test_arena_snapshot_restore_empty();
+    test_arena_reset();
     test_arena_alignment();
 
     // RArena
@@ -0,0 +1,6 @@
+// The ds.h suite again in large-array mode: arrays from 1 MB are memory
+// mappings, so the mapped grow, shrink and free paths run alongside the heap
+// ones, and test_da_large_mapping checks them directly.
+#define DS_DA_LARGE_THRESHOLD (1 << 20)
+#define TEST_DS_CONFIG " (DS_DA_LARGE_THRESHOLD)"
+#include "test_ds.c"
@@ -0,0 +1,8 @@
+// The ds.h suite again with small size thresholds, so the test-sized
+// inputs reach the code paths that the defaults keep for big ones:
+// - set operations on 4096+ values split their lookups over threads
+// - 64-byte B+tree nodes give thousand-key trees several levels
+#define DS_HS_PARALLEL_MIN 4096
+#define DS_BTREE_NODE_SIZE 64
+#define TEST_DS_CONFIG " (small thresholds)"
+#include "test_ds.c"
@@ -0,0 +1,6 @@
+// The ds.h suite again with DS_HM_STATS: every map keeps lookup counters,
+// which changes the table header and the lookup paths, and test_hm_stats
+// checks the counts.
+#define DS_HM_STATS
+#define TEST_DS_CONFIG " (DS_HM_STATS)"
+#include "test_ds.c"